@@ -22,9 +22,10 @@
 /*
  * 68K.cpp
  * 
- * 68K CPU interface. This is presently just a wrapper for the Musashi 68K core
- * and therefore, only a single CPU is supported. In the future, we may want to
- * add in another 68K core (eg., Turbo68K, A68K, or a recompiler). 
+ * 68K CPU interface. This is presently just a wrapper for the Musashi 68K core.
+ * Each thread has its own active context, so CPUs on different boards can be
+ * run concurrently from different threads. In the future, we may want to add
+ * in another 68K core (eg., Turbo68K, A68K, or a recompiler). 
  *
  * To-Do List
  * ----------
@@ -40,24 +41,19 @@
 /******************************************************************************
  Internal Context
  
- An active context must be mapped before calling M68K interface functions. Only
- the bus and IRQ handlers are copied here; the CPU context is passed directly
- to Musashi.
+ An active context must be mapped before calling M68K interface functions. The
+ context is used in place (Musashi is pointed at its CPU state) rather than
+ copied, and the mapping is per thread.
 ******************************************************************************/
 
-// Bus
-static IBus	*s_Bus = NULL;
+// Context used by threads that haven't mapped one
+static M68KCtx s_defaultCtx;
 
-#ifdef SUPERMODEL_DEBUGGER
-// Debugger
-static Debugger::CMusashi68KDebug *s_Debug = NULL;
-#endif
-
-// IRQ callback
-static int	(*IRQAck)(int nIRQ) = NULL;
+// Active context of this thread (bus, IRQ callback, debugger, Musashi state)
+static thread_local M68KCtx *s_ctx = &s_defaultCtx;
 
 // Cycles remaining in timeslice
-static int s_lastCycles;
+static thread_local int s_lastCycles;
 
 
 /******************************************************************************
@@ -230,17 +226,17 @@ void M68KSetIRQ(int irqLevel)
 int M68KRun(int numCycles)
 {
 #ifdef SUPERMODEL_DEBUGGER
-	if (s_Debug != NULL)
+	if (s_ctx->Debug != NULL)
 	{
-		s_Debug->CPUActive();
+		s_ctx->Debug->CPUActive();
 		s_lastCycles += numCycles;
 	}
 #endif // SUPERMODEL_DEBUGGER
 	int doneCycles = m68k_execute(numCycles);
 #ifdef SUPERMODEL_DEBUGGER
-	if (s_Debug != NULL)
+	if (s_ctx->Debug != NULL)
 	{
-		s_Debug->CPUInactive();
+		s_ctx->Debug->CPUInactive();
 		s_lastCycles -= m68k_cycles_remaining();
 	}
 #endif // SUPERMODEL_DEBUGGER
@@ -260,12 +256,12 @@ void M68KReset(void)
 
 void M68KSetIRQCallback(int (*F)(int nIRQ))
 {
-	IRQAck = F;
+	s_ctx->IRQAck = F;
 }
 
 void M68KAttachBus(IBus *BusPtr)
 {
-	s_Bus = BusPtr;
+	s_ctx->Bus = BusPtr;
 	DebugLog("Attached bus to 68K\n");
 }
 
@@ -273,22 +269,19 @@ void M68KAttachBus(IBus *BusPtr)
 
 void M68KGetContext(M68KCtx *Dest)
 {
-	Dest->IRQAck = IRQAck;
-	Dest->Bus = s_Bus;
-#ifdef SUPERMODEL_DEBUGGER
-	Dest->Debug = s_Debug;
-#endif // SUPERMODEL_DEBUGGER
-	m68k_get_context(&(Dest->musashiCtx));
+	if (Dest != s_ctx)	// the active context is already up to date
+		*Dest = *s_ctx;
 }
 
 void M68KSetContext(M68KCtx *Src)
 {
-	IRQAck = Src->IRQAck;
-	s_Bus = Src->Bus;
-#ifdef SUPERMODEL_DEBUGGER
-	s_Debug = Src->Debug;
-#endif // SUPERMODEL_DEBUGGER
-	m68k_set_context(&(Src->musashiCtx));
+	s_ctx = (Src != NULL) ? Src : &s_defaultCtx;
+	m68k_use_context(&(s_ctx->musashiCtx));
+}
+
+M68KCtx *M68KGetActiveContext(void)
+{
+	return s_ctx;
 }
 
 // One-time initialization
@@ -298,9 +291,9 @@ bool M68KInit(void)
 	m68k_init();
 	m68k_set_cpu_type(M68K_CPU_TYPE_68000);
 	m68k_set_int_ack_callback(M68KIRQCallback);
-	s_Bus = NULL;
+	s_ctx->Bus = NULL;
 #ifdef SUPERMODEL_DEBUGGER
-	s_Debug = NULL;
+	s_ctx->Debug = NULL;
 #endif // SUPERMODEL_DEBUGGER
 	DebugLog("Initialized 68K\n");
 	return OKAY;
@@ -373,11 +366,11 @@ extern "C" {
 #ifdef SUPERMODEL_DEBUGGER
 void M68KDebugCallback()
 {
-	if (s_Debug != NULL)
+	if (s_ctx->Debug != NULL)
 	{
 		UINT32 pc = m68k_get_reg(NULL, M68K_REG_PC);
-		UINT32 opcode = s_Bus->Read16(pc);
-		s_Debug->CPUExecute(pc, opcode, s_lastCycles - m68k_cycles_remaining());
+		UINT32 opcode = s_ctx->Bus->Read16(pc);
+		s_ctx->Debug->CPUExecute(pc, opcode, s_lastCycles - m68k_cycles_remaining());
 		s_lastCycles = m68k_cycles_remaining();
 	}
 }
@@ -386,64 +379,64 @@ void M68KDebugCallback()
 int M68KIRQCallback(int nIRQ)
 {
 #ifdef SUPERMODEL_DEBUGGER
-	if (s_Debug != NULL)
+	if (s_ctx->Debug != NULL)
 	{
-		s_Debug->CPUException(25);
-		s_Debug->CPUInterrupt(nIRQ - 1);
+		s_ctx->Debug->CPUException(25);
+		s_ctx->Debug->CPUInterrupt(nIRQ - 1);
 	}
 #endif // SUPERMODEL_DEBUGGER
-	if (NULL == IRQAck)	// no handler, use default behavior
+	if (NULL == s_ctx->IRQAck)	// no handler, use default behavior
 	{
 		m68k_set_irq(0);	// clear line
 		return M68K_IRQ_AUTOVECTOR;
 	}
 	else
-		return IRQAck(nIRQ);
+		return s_ctx->IRQAck(nIRQ);
 }
 
 unsigned int FASTCALL M68KFetch8(unsigned int a)
 {
-	return s_Bus->Read8(a);
+	return s_ctx->Bus->Read8(a);
 }
 
 unsigned int FASTCALL M68KFetch16(unsigned int a)
 {
-	return s_Bus->Read16(a);
+	return s_ctx->Bus->Read16(a);
 }
 
 unsigned int FASTCALL M68KFetch32(unsigned int a)
 {
-	return s_Bus->Read32(a);
+	return s_ctx->Bus->Read32(a);
 }
 
 unsigned int FASTCALL M68KRead8(unsigned int a)
 {
-	return s_Bus->Read8(a);
+	return s_ctx->Bus->Read8(a);
 }
 
 unsigned int FASTCALL M68KRead16(unsigned int a)
 {
-	return s_Bus->Read16(a);
+	return s_ctx->Bus->Read16(a);
 }
 
 unsigned int FASTCALL M68KRead32(unsigned int a)
 {
-	return s_Bus->Read32(a);
+	return s_ctx->Bus->Read32(a);
 }
 
 void FASTCALL M68KWrite8(unsigned int a, unsigned int d)
 {
-	s_Bus->Write8(a, d);
+	s_ctx->Bus->Write8(a, d);
 }
 
 void FASTCALL M68KWrite16(unsigned int a, unsigned int d)
 {
-	s_Bus->Write16(a, d);
+	s_ctx->Bus->Write16(a, d);
 }
 
 void FASTCALL M68KWrite32(unsigned int a, unsigned int d)
 {
-	s_Bus->Write32(a, d);
+	s_ctx->Bus->Write32(a, d);
 }
 
 }	// extern "C"
@@ -244,7 +244,8 @@ extern bool M68KInit(void);
 /*
  * M68KGetContext(M68KCtx *Dest):
  *
- * Copies the internal (active) 68K context back to the destination.
+ * Copies the active 68K context to the destination. Nothing is done if the
+ * destination is the active context, which is always up to date.
  *
  * Parameters:
  *		Dest	Location to which to copy 68K context.
@@ -254,13 +255,24 @@ extern void M68KGetContext(M68KCtx *Dest);
 /*
  * M68KSetContext(M68KCtx *Src):
  *
- * Sets the specified 68K context by copying it to the internal context.
+ * Makes the specified 68K context active for the calling thread. It is used
+ * in place, not copied, so it must remain valid while active. Each thread has
+ * its own active context, so different CPUs may run concurrently as long as
+ * each is only run by one thread at a time.
  *
  * Parameters:
- *		Src		Location from which to copy 68K context.
+ *		Src		68K context to activate. NULL selects a default context.
  */
 extern void M68KSetContext(M68KCtx *Src);
 
+/*
+ * M68KGetActiveContext():
+ *
+ * Returns:
+ *		The calling thread's active 68K context.
+ */
+extern M68KCtx *M68KGetActiveContext(void);
+
 #ifdef SUPERMODEL_DEBUGGER
 #define DBG68K_REG_PC 0
 #define DBG68K_REG_SR 1
@@ -354,6 +354,15 @@ unsigned int m68k_get_context(void* dst);
 /* set the current cpu context */
 void m68k_set_context(void* dst);
 
+/* Run the given context on the calling thread from now on, in place rather
+ * than copied.  It must stay valid until another context is selected.  NULL
+ * selects the thread's default context.
+ */
+void m68k_use_context(void* ctx);
+
+/* Get the context currently run by the calling thread */
+void* m68k_active_context(void);
+
 /* Register the CPU state information */
 void m68k_state_register(const char *type);
 
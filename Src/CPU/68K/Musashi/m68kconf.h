@@ -203,6 +203,18 @@
 #define INLINE static __inline__	// defined for GCC; if using MSVC, pass INLINE as "static __inline" from Makefile
 #endif /* INLINE */
 
+
+/* Storage class for per-thread CPU state, which lets each thread run its own
+ * CPU context (see m68k_use_context()).
+ */
+#ifndef M68K_THREAD_LOCAL
+#if defined(_MSC_VER)
+#define M68K_THREAD_LOCAL __declspec(thread)
+#else
+#define M68K_THREAD_LOCAL __thread
+#endif
+#endif /* M68K_THREAD_LOCAL */
+
 /******************************************************************************
  Supermodel Interface
 ******************************************************************************/
@@ -73,10 +73,10 @@ static const char* copyright_notice =
 /* ================================= DATA ================================= */
 /* ======================================================================== */
 
-int  m68ki_initial_cycles;
-int  m68ki_remaining_cycles = 0;                     /* Number of clocks remaining */
-uint m68ki_tracing = 0;
-uint m68ki_address_space;
+M68K_THREAD_LOCAL sint m68ki_initial_cycles;
+M68K_THREAD_LOCAL sint m68ki_remaining_cycles = 0;   /* Number of clocks remaining */
+M68K_THREAD_LOCAL uint m68ki_tracing = 0;
+M68K_THREAD_LOCAL uint m68ki_address_space;
 
 #ifdef M68K_LOG_ENABLE
 const char* m68ki_cpu_names[] =
@@ -101,16 +101,19 @@ const char* m68ki_cpu_names[] =
 };
 #endif /* M68K_LOG_ENABLE */
 
-/* The CPU core */
-m68ki_cpu_core m68ki_cpu = {0};
+/* The CPU core used by threads that haven't selected one of their own */
+static m68ki_cpu_core m68ki_cpu_default = {0};
+
+/* The CPU core being run by this thread */
+M68K_THREAD_LOCAL m68ki_cpu_core *m68ki_cpu_active = &m68ki_cpu_default;
 
 #if M68K_EMULATE_ADDRESS_ERROR
-jmp_buf m68ki_aerr_trap;
+M68K_THREAD_LOCAL jmp_buf m68ki_aerr_trap;
 #endif /* M68K_EMULATE_ADDRESS_ERROR */
 
-uint    m68ki_aerr_address;
-uint    m68ki_aerr_write_mode;
-uint    m68ki_aerr_fc;
+M68K_THREAD_LOCAL uint m68ki_aerr_address;
+M68K_THREAD_LOCAL uint m68ki_aerr_write_mode;
+M68K_THREAD_LOCAL uint m68ki_aerr_fc;
 
 /* Used by shift & rotate instructions */
 uint8 m68ki_shift_8_table[65] =
@@ -456,12 +459,6 @@ static void default_instr_hook_callback(void)
 }
 
 
-#if M68K_EMULATE_ADDRESS_ERROR
-	#include <setjmp.h>
-	jmp_buf m68ki_aerr_trap;
-#endif /* M68K_EMULATE_ADDRESS_ERROR */
-
-
 /* ======================================================================== */
 /* ================================= API ================================== */
 /* ======================================================================== */
@@ -892,6 +889,16 @@ void m68k_set_context(void* src)
 	if(src) m68ki_cpu = *(m68ki_cpu_core*)src;
 }
 
+void m68k_use_context(void* ctx)
+{
+	m68ki_cpu_active = ctx ? (m68ki_cpu_core*)ctx : &m68ki_cpu_default;
+}
+
+void* m68k_active_context(void)
+{
+	return m68ki_cpu_active;
+}
+
 
 
 /* ======================================================================== */
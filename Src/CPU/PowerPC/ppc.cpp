@@ -29,6 +29,7 @@
 /* IBM/Motorola PowerPC 4xx/6xx Emulator */
 
 #include <cstring>	// memset()
+#include <cstddef>	// offsetof()
 #include "Supermodel.h"
 #include "ppc.h"
 
@@ -48,6 +49,14 @@ static class Debugger::CPPCDebug *PPCDebug = NULL;
 
 void ppc603_exception(int exception);
 static void ppc603_check_interrupts(void);
+static bool ppc_jit_enabled(void);
+static void ppc_jit_run(void);
+static void ppc_jit_flush(void);
+static bool ppc_threaded_enabled(void);
+static void ppc_threaded_run(void);
+static void ppc_flush_code(void);
+static inline void ppc_idle_branch(void);
+static inline void ppc_code_written(UINT32 addr);
 
 #define RD				((op >> 21) & 0x1F)
 #define RT				((op >> 21) & 0x1f)
@@ -267,6 +276,10 @@ typedef struct {
 	int bus_freq_multiplier;
 	int cycles_per_second;
 
+	// Execution engine
+	PPC_ENGINE engine;
+	bool block_break;	// set when cached code is overwritten or the time slice is ended, forces exit from current block
+
 #if HAS_PPC603
 	int is603;
 #endif
@@ -288,6 +301,12 @@ typedef struct {
 static PPC_REGS ppc;
 static UINT32 ppc_rotate_mask[32][32];
 
+#define PPC_MEM_PAGES	(1 << (32 - PPC_MEM_PAGE_SHIFT))
+
+// Fetch region containing each page, built by ppc_set_fetch() (NULL if none)
+static PPC_FETCH_REGION	*fetch_map[PPC_MEM_PAGES];
+static UINT64			fetch_misses = 0;	// number of times cur_fetch had to be changed
+
 static void ppc_change_pc(UINT32 newpc)
 {
 	UINT i;
@@ -295,67 +314,145 @@ static void ppc_change_pc(UINT32 newpc)
 	if (ppc.cur_fetch.start <= newpc && newpc <= ppc.cur_fetch.end)
 	{
 		ppc.op = &ppc.cur_fetch.ptr[(newpc-ppc.cur_fetch.start)/4];
-//		ppc.op = (UINT32 *)((void *)ppc.cur_fetch.ptr + (UINT32)(newpc - ppc.cur_fetch.start));
 		return;
 	}
 
-	for(i = 0; ppc.fetch[i].ptr != NULL; i++)
+	++fetch_misses;
+
+	// A page may be shared by more than one region, in which case the map
+	// holds only the first and the others must be searched for
+	PPC_FETCH_REGION *region = fetch_map[newpc >> PPC_MEM_PAGE_SHIFT];
+	if (region == NULL || newpc < region->start || newpc > region->end)
 	{
-		if (ppc.fetch[i].start <= newpc && newpc <= ppc.fetch[i].end)
+		region = NULL;
+		for(i = 0; ppc.fetch[i].ptr != NULL; i++)
 		{
-			ppc.cur_fetch.start = ppc.fetch[i].start;
-			ppc.cur_fetch.end = ppc.fetch[i].end;
-			ppc.cur_fetch.ptr = ppc.fetch[i].ptr;
-
-//			ppc.op = (UINT32 *)((UINT32)ppc.cur_fetch.ptr + (UINT32)(newpc - ppc.cur_fetch.start));
-			ppc.op = &ppc.cur_fetch.ptr[(newpc-ppc.cur_fetch.start)/4];			
-			return;
+			if (ppc.fetch[i].start <= newpc && newpc <= ppc.fetch[i].end)
+			{
+				region = &ppc.fetch[i];
+				break;
+			}
 		}
 	}
 
+	if (region != NULL)
+	{
+		ppc.cur_fetch.start = region->start;
+		ppc.cur_fetch.end = region->end;
+		ppc.cur_fetch.ptr = region->ptr;
+		ppc.op = &ppc.cur_fetch.ptr[(newpc-ppc.cur_fetch.start)/4];
+		return;
+	}
+
 	DebugLog("Invalid PC %08X, previous PC %08X\n", newpc, ppc.pc);
 	ErrorLog("PowerPC is out of bounds. Halting emulation until reset.");
 	ppc.fatalError = true;
 }
 
+/*
+ * Memory access
+ *
+ * Pages mapped with ppc_map_memory() are accessed directly. Memory is stored
+ * as native 32-bit words, as in the fetch regions, so bytes and half words are
+ * located by flipping the low address bits. Misaligned accesses and accesses
+ * to unmapped (I/O) pages go through the bus, as do all accesses while the
+ * debugger is attached so that it can monitor them.
+ */
+
+static UINT8	*mem_read_map[PPC_MEM_PAGES];	// host pointer for each page (NULL if not mapped)
+static UINT8	*mem_write_map[PPC_MEM_PAGES];
+
+#ifdef SUPERMODEL_DEBUGGER
+#define MEM_PAGE(map, address)	((PPCDebug == NULL) ? map[(address) >> PPC_MEM_PAGE_SHIFT] : NULL)
+#else
+#define MEM_PAGE(map, address)	map[(address) >> PPC_MEM_PAGE_SHIFT]
+#endif
+#define MEM_OFFSET(address)		((address) & (PPC_MEM_PAGE_SIZE - 1))
+
 INLINE UINT8 READ8(UINT32 address)
 {
+	UINT8 *page = MEM_PAGE(mem_read_map, address);
+	if (page != NULL)
+		return page[MEM_OFFSET(address) ^ 3];
 	return Bus->Read8(address);
 }
 
 INLINE UINT16 READ16(UINT32 address)
 {
+	UINT8 *page = MEM_PAGE(mem_read_map, address);
+	if (page != NULL && !(address & 1))
+		return *(UINT16 *) &page[MEM_OFFSET(address) ^ 2];
 	return Bus->Read16(address);
 }
 
 INLINE UINT32 READ32(UINT32 address)
 {
+	UINT8 *page = MEM_PAGE(mem_read_map, address);
+	if (page != NULL && !(address & 3))
+		return *(UINT32 *) &page[MEM_OFFSET(address)];
 	return Bus->Read32(address);
 }
 
 INLINE UINT64 READ64(UINT32 address)
 {
+	UINT8 *page = MEM_PAGE(mem_read_map, address);
+	if (page != NULL && !(address & 7))
+	{
+		UINT32 *p = (UINT32 *) &page[MEM_OFFSET(address)];
+		return ((UINT64) p[0] << 32) | p[1];
+	}
 	return Bus->Read64(address);
 }
 
 INLINE void WRITE8(UINT32 address, UINT8 data)
 {
-	Bus->Write8(address,data);
+	UINT8 *page = MEM_PAGE(mem_write_map, address);
+	if (page != NULL)
+	{
+		page[MEM_OFFSET(address) ^ 3] = data;
+		ppc_code_written(address);
+	}
+	else
+		Bus->Write8(address,data);
 }
 
 INLINE void WRITE16(UINT32 address, UINT16 data)
 {
-	Bus->Write16(address,data);
+	UINT8 *page = MEM_PAGE(mem_write_map, address);
+	if (page != NULL && !(address & 1))
+	{
+		*(UINT16 *) &page[MEM_OFFSET(address) ^ 2] = data;
+		ppc_code_written(address);
+	}
+	else
+		Bus->Write16(address,data);
 }
 
 INLINE void WRITE32(UINT32 address, UINT32 data)
 {
-	Bus->Write32(address,data);
+	UINT8 *page = MEM_PAGE(mem_write_map, address);
+	if (page != NULL && !(address & 3))
+	{
+		*(UINT32 *) &page[MEM_OFFSET(address)] = data;
+		ppc_code_written(address);
+	}
+	else
+		Bus->Write32(address,data);
 }
 
 INLINE void WRITE64(UINT32 address, UINT64 data)
 {
-	Bus->Write64(address,data);
+	UINT8 *page = MEM_PAGE(mem_write_map, address);
+	if (page != NULL && !(address & 7))
+	{
+		UINT32 *p = (UINT32 *) &page[MEM_OFFSET(address)];
+		p[0] = (UINT32) (data >> 32);
+		ppc_code_written(address);
+		p[1] = (UINT32) data;
+		ppc_code_written(address + 4);
+	}
+	else
+		Bus->Write64(address,data);
 }
 
 
@@ -675,6 +772,20 @@ static void (* optable[64])(UINT32);
 #include "ppc_ops.c"
 #include "ppc_ops.h"
 
+/********************************************************************/
+
+#include "ppc_jit.c"
+#include "ppc_threaded.c"
+#include "ppc_idle.c"
+
+// Discards all translated and predecoded blocks
+static void ppc_flush_code(void)
+{
+	ppc_jit_flush();
+	ppc_threaded_flush();
+	ppc_code_clear_map();
+}
+
 /* Initialization and shutdown */
 
 void ppc_base_init(void)
@@ -860,11 +971,20 @@ void ppc_init(const PPC_CONFIG *config)
 	}
 
 	ppc.hid1 = pll_config << 28;
+
+	ppc.engine = config->engine;
+	if (ppc.engine == PPC_ENGINE_RECOMPILER && OKAY != ppc_jit_init())
+		ppc.engine = PPC_ENGINE_INTERPRETER;
+	if (ppc.engine == PPC_ENGINE_THREADED && OKAY != ppc_threaded_init())
+		ppc.engine = PPC_ENGINE_INTERPRETER;
 }
 
 void ppc_shutdown(void)
 {
-
+	ppc_jit_shutdown();
+	ppc_threaded_shutdown();
+	ppc_code_untrack();
+	ppc_unmap_memory(0, 0xFFFFFFFF);
 }
 
 void ppc_set_irq_line(int irqline)
@@ -882,6 +1002,58 @@ UINT32 ppc_get_pc(void)
 void ppc_set_fetch(PPC_FETCH_REGION * fetch)
 {
 	ppc.fetch = fetch;
+
+	memset(fetch_map, 0, sizeof(fetch_map));
+	for (int i = 0; fetch[i].ptr != NULL; i++)
+	{
+		for (UINT32 page = fetch[i].start >> PPC_MEM_PAGE_SHIFT; page <= (fetch[i].end >> PPC_MEM_PAGE_SHIFT); page++)
+		{
+			if (fetch_map[page] == NULL)
+				fetch_map[page] = &fetch[i];
+		}
+	}
+
+	if (ppc.engine != PPC_ENGINE_INTERPRETER)
+	{
+		ppc_code_track(fetch);
+		ppc_flush_code();
+	}
+}
+
+/*
+ * ppc_map_memory(start, end, ptr, writeable):
+ *
+ * Maps host memory at ptr to the address range start-end so that it can be
+ * accessed without calling the bus handlers. Memory must be stored as native
+ * 32-bit words. start and end + 1 must be multiples of PPC_MEM_PAGE_SIZE. If
+ * writeable is false, only reads are mapped and writes still go through the
+ * bus.
+ */
+void ppc_map_memory(UINT32 start, UINT32 end, UINT8 *ptr, bool writeable)
+{
+	UINT32 first = start >> PPC_MEM_PAGE_SHIFT;
+	UINT32 last = end >> PPC_MEM_PAGE_SHIFT;
+	for (UINT32 page = first; page <= last; page++)
+	{
+		UINT8 *p = ptr + ((page - first) << PPC_MEM_PAGE_SHIFT);
+		mem_read_map[page] = p;
+		mem_write_map[page] = writeable ? p : NULL;
+	}
+}
+
+void ppc_unmap_memory(UINT32 start, UINT32 end)
+{
+	for (UINT32 page = start >> PPC_MEM_PAGE_SHIFT; page <= (end >> PPC_MEM_PAGE_SHIFT); page++)
+	{
+		mem_read_map[page] = NULL;
+		mem_write_map[page] = NULL;
+	}
+}
+
+// Returns the number of times execution has moved to a different fetch region
+UINT64 ppc_get_fetch_misses(void)
+{
+	return fetch_misses;
 }
 
 UINT64 ppc_total_cycles(void)
@@ -889,6 +1061,33 @@ UINT64 ppc_total_cycles(void)
 	return ppc.total_cycles + (UINT64)(ppc.cur_cycles - ppc.icount);
 }
 
+/*
+ * ppc_end_slice():
+ *
+ * Called by a device from within ppc_execute() (i.e. from a memory handler)
+ * when it has made an event due sooner than the end of the time slice. The
+ * slice is shortened to end after the current instruction, with the remaining
+ * cycles neither executed nor counted, so that ppc_execute() returns to its
+ * caller and the event can be handled. Does nothing outside ppc_execute().
+ */
+void ppc_end_slice(void)
+{
+	int remaining = ppc.icount;
+	if (remaining <= 0)
+		return;
+
+	// Everything that is measured relative to ppc.icount moves with it
+	ppc.cur_cycles -= remaining;
+	ppc.tb_base_icount -= remaining;
+	ppc.dec_base_icount -= remaining;
+	ppc.dec_trigger_cycle -= remaining;
+	thr_icount_base -= remaining;
+	ppc.icount = 0;
+
+	// Leave the current block immediately
+	ppc.block_break = true;
+}
+
 int ppc_get_cycles_per_sec()
 {
 	return ppc.cycles_per_second;
@@ -909,6 +1108,11 @@ int ppc_get_timer_ratio()
 	return ppc.timer_ratio;
 }
 
+PPC_ENGINE ppc_get_engine(void)
+{
+	return ppc.engine;
+}
+
 /******************************************************************************
  Supermodel Interface
 ******************************************************************************/
@@ -1070,6 +1274,9 @@ void ppc_load_state(CBlockFile *SaveState)
 	
 	SaveState->Read(ppc.fpr, sizeof(ppc.fpr));
 	SaveState->Read(ppc.sr, sizeof(ppc.sr));
+
+	// Cached code may no longer match memory
+	ppc_flush_code();
 }
 
 UINT32 ppc_get_gpr(unsigned num)
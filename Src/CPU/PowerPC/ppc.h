@@ -326,10 +326,17 @@ static const int mpc603r_pll_config[12][9] =
  Configuration Data Structures
 ******************************************************************************/
 
+typedef enum {
+	PPC_ENGINE_INTERPRETER = 0,		// one instruction at a time (default)
+	PPC_ENGINE_THREADED,			// interpreter operating on cached, predecoded blocks
+	PPC_ENGINE_RECOMPILER			// basic block recompiler (x86-64 hosts only)
+} PPC_ENGINE;
+
 typedef struct {
 	PPC_MODEL pvr;
 	int bus_frequency_multiplier;
 	PPC_BUS_FREQUENCY bus_frequency;
+	PPC_ENGINE engine;
 } PPC_CONFIG;
 
 typedef struct
@@ -340,6 +347,15 @@ typedef struct
 
 } PPC_FETCH_REGION;
 
+// Address range that idle loops may poll (reads have no side effects and
+// values change only at interrupts or scheduled events)
+typedef struct
+{
+	UINT32	start;
+	UINT32	end;
+
+} PPC_IDLE_REGION;
+
 
 /******************************************************************************
  Functions
@@ -352,11 +368,41 @@ extern void ppc_reset(void);
 extern void ppc_shutdown(void);
 extern void ppc_init(const PPC_CONFIG *config);		// must be called second!
 extern void ppc_set_fetch(PPC_FETCH_REGION * fetch);
+extern UINT64 ppc_get_fetch_misses(void);
 extern UINT64 ppc_total_cycles(void);
+extern void ppc_end_slice(void);
 extern int ppc_get_cycles_per_sec(void);
 extern int ppc_get_bus_freq_multipler(void);
 extern int ppc_get_timer_ratio(void);
 extern void ppc_set_timer_ratio(int ratio);
+extern PPC_ENGINE ppc_get_engine(void);
+
+// Direct memory mapping (unmapped pages are accessed through the bus)
+#define PPC_MEM_PAGE_SHIFT	16
+#define PPC_MEM_PAGE_SIZE	(1 << PPC_MEM_PAGE_SHIFT)
+extern void ppc_map_memory(UINT32 start, UINT32 end, UINT8 *ptr, bool writeable);
+extern void ppc_unmap_memory(UINT32 start, UINT32 end);
+
+// Idle loop skipping
+extern void ppc_set_idle_skip(bool detect, const UINT32 *loops, unsigned numLoops);
+extern void ppc_set_idle_regions(const PPC_IDLE_REGION *regions, unsigned numRegions);
+extern UINT64 ppc_get_idle_cycles(void);
+
+// Cached code tracking (only allocated when a block-based engine is in use)
+extern UINT32 *ppc_code_map;
+extern void ppc_invalidate_code(UINT32 addr);
+
+/*
+ * ppc_code_write(addr):
+ *
+ * Must be called whenever the fetch region at address 0 (RAM) is written.
+ * Discards any cached blocks containing the word at addr.
+ */
+static inline void ppc_code_write(UINT32 addr)
+{
+	if ((ppc_code_map != NULL) && (ppc_code_map[addr >> 7] & (1 << ((addr >> 2) & 31))))
+		ppc_invalidate_code(addr);
+}
 
 // These have been added to support the new Supermodel
 extern void ppc_attach_bus(class IBus *BusPtr);		// must be called first!
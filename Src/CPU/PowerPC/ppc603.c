@@ -254,6 +254,20 @@ void ppc_reset(void)
 	ppc.total_cycles = 0;
 	ppc.cur_cycles = 0;
 	ppc.icount = 0;
+
+	ppc_flush_code();
+}
+
+INLINE void ppc_dispatch(UINT32 opcode)
+{
+	switch(opcode >> 26)
+	{
+		case 19:	optable19[(opcode >> 1) & 0x3ff](opcode); break;
+		case 31:	optable31[(opcode >> 1) & 0x3ff](opcode); break;
+		case 59:	optable59[(opcode >> 1) & 0x3ff](opcode); break;
+		case 63:	optable63[(opcode >> 1) & 0x3ff](opcode); break;
+		default:	optable[opcode >> 26](opcode); break;
+	}
 }
 
 int ppc_execute(int cycles)
@@ -289,6 +303,13 @@ int ppc_execute(int cycles)
 		PPCDebug->CPUActive();
 #endif // SUPERMODEL_DEBUGGER
 
+	// Block-based engines run until the time slice is exhausted, leaving
+	// nothing for the interpreter loop below
+	if (ppc_jit_enabled())
+		ppc_jit_run();
+	else if (ppc_threaded_enabled())
+		ppc_threaded_run();
+
 	while( ppc.icount > 0 && !ppc.fatalError)
 	{
 		ppc.pc = ppc.npc;
@@ -313,14 +334,7 @@ int ppc_execute(int cycles)
 		}
 #endif // SUPERMODEL_DEBUGGER
 
-		switch(opcode >> 26)
-		{
-			case 19:	optable19[(opcode >> 1) & 0x3ff](opcode); break;
-			case 31:	optable31[(opcode >> 1) & 0x3ff](opcode); break;
-			case 59:	optable59[(opcode >> 1) & 0x3ff](opcode); break;
-			case 63:	optable63[(opcode >> 1) & 0x3ff](opcode); break;
-			default:	optable[opcode >> 26](opcode); break;
-		}
+		ppc_dispatch(opcode);
 
 		ppc.icount--;
 		
@@ -330,6 +344,8 @@ int ppc_execute(int cycles)
 			ppc603_check_interrupts();
 		}
 
+		ppc_idle_branch();
+
 		//ppc603_check_interrupts();
 	}
 
@@ -353,7 +369,7 @@ int ppc_execute(int cycles)
 	}
 	*/
 
-	int executed = cycles - ppc.icount;
+	int executed = ppc.cur_cycles - ppc.icount;	// slice may have been shortened by ppc_end_slice()
 	ppc.total_cycles += executed;
 	ppc.cur_cycles = 0;
 	ppc.icount = 0;
@@ -0,0 +1,361 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * ppc_idle.c
+ *
+ * Idle loop detection and skipping. Included from ppc.cpp; do not compile
+ * separately.
+ *
+ * Games spend much of each frame spinning in short loops that poll a RAM
+ * flag (set by an interrupt handler) or the Real3D status register. Once
+ * such a loop has branched back to its start, it will keep doing so until an
+ * interrupt occurs or the polled value changes, and neither can happen before
+ * the next scheduled event: the end of the time slice (external interrupts
+ * are only raised between calls to ppc_execute(), and the main board ends
+ * each slice at the next event in its queue, such as the Real3D status bit
+ * changing) or the decrementer exception. The remaining cycles up to that
+ * point are therefore skipped by decrementing ppc.icount directly. The
+ * timebase, decrementer and ppc_total_cycles() are all derived from
+ * ppc.icount and advance as if the loop had actually executed.
+ *
+ * A loop is considered idle if it is no longer than PPC_IDLE_MAX_LOOP
+ * instructions, consists only of loads, compares, simple logical operations
+ * and conditional branches that exit it, carries no state from one iteration
+ * to the next (every register and CR field it reads is either loop-invariant
+ * or written earlier in the same iteration), and all of its loads fall within
+ * one of the regions given to ppc_set_idle_regions(). Loops given explicitly
+ * (per-game overrides) are skipped without analysis.
+ *
+ * The check is made whenever a branch back to an address at most
+ * PPC_IDLE_MAX_SPAN bytes behind it is taken, at the same point in all
+ * execution engines, so they remain cycle-for-cycle identical.
+ */
+
+#define PPC_IDLE_MAX_LOOP		8						// longest loop (instructions) that is detected automatically
+#define PPC_IDLE_MAX_SPAN		256						// longest explicitly specified loop (bytes)
+#define PPC_IDLE_CACHE_SIZE		256						// analyzed loop cache entries (must be power of 2)
+#define PPC_IDLE_MAX_LOOPS		16
+#define PPC_IDLE_MAX_REGIONS	8
+
+typedef struct
+{
+	UINT32	pc;							// first instruction of loop
+	UINT32	length;						// 0 if entry is empty
+	UINT32	ops[PPC_IDLE_MAX_LOOP];		// code at time of analysis
+	UINT32	loads;						// bit n set if ops[n] is a load
+	bool	idle;
+} PPC_IDLE_LOOP;
+
+static PPC_IDLE_LOOP	idle_cache[PPC_IDLE_CACHE_SIZE];
+static UINT32			idle_loops[PPC_IDLE_MAX_LOOPS];
+static unsigned			idle_num_loops = 0;
+static PPC_IDLE_REGION	idle_regions[PPC_IDLE_MAX_REGIONS];
+static unsigned			idle_num_regions = 0;
+static bool				idle_detect = false;
+static bool				idle_enabled = false;
+static UINT64			idle_cycles = 0;		// total cycles skipped
+
+
+/******************************************************************************
+ Loop Analysis
+******************************************************************************/
+
+// Returns true if op is a load without update (EA = (rA|0) + d or (rA|0) + rB)
+static bool ppc_idle_is_load(UINT32 op)
+{
+	switch (op >> 26)
+	{
+	case 32:	// lwz
+	case 34:	// lbz
+	case 40:	// lhz
+	case 42:	// lha
+		return true;
+	case 31:
+		switch ((op >> 1) & 0x3ff)
+		{
+		case 23:	// lwzx
+		case 87:	// lbzx
+		case 279:	// lhzx
+		case 343:	// lhax
+			return true;
+		}
+		break;
+	}
+	return false;
+}
+
+static UINT32 ppc_idle_load_address(UINT32 op)
+{
+	UINT32 ea = (RA == 0) ? 0 : REG(RA);
+	if ((op >> 26) == 31)
+		return ea + REG(RB);
+	return ea + SIMM16;
+}
+
+/*
+ * Determines whether the loop at code[0..length-1], beginning at address pc,
+ * is idle. On return, loads has a bit set for each load instruction.
+ */
+static bool ppc_idle_analyze(const UINT32 *code, UINT32 pc, UINT32 length, UINT32 *loads)
+{
+	UINT32 gprRead = 0, gprWritten = 0, gprBase = 0;	// registers read before being written, written, and used for addressing
+	UINT32 crRead = 0, crWritten = 0;					// CR fields
+	UINT32 end = pc + length * 4;
+
+	*loads = 0;
+	for (UINT32 i = 0; i < length; i++)
+	{
+		UINT32 op = code[i];
+		UINT32 reads = 0, writes = 0;
+		UINT32 crReads = 0, crWrites = 0;
+		bool last = (i == length - 1);
+
+		if (ppc_idle_is_load(op))
+		{
+			UINT32 base = (RA == 0) ? 0 : (1U << RA);
+			if ((op >> 26) == 31)
+				base |= 1U << RB;
+			reads = base;
+			gprBase |= base;
+			writes = 1U << RT;
+			*loads |= 1U << i;
+		}
+		else
+		{
+			switch (op >> 26)
+			{
+			case 10:	// cmpli
+			case 11:	// cmpi
+				reads = 1U << RA;
+				crWrites = 1U << CRFD;
+				break;
+			case 14:	// addi
+			case 15:	// addis
+				reads = (RA == 0) ? 0 : (1U << RA);
+				writes = 1U << RT;
+				break;
+			case 21:	// rlwinm
+				reads = 1U << RS;
+				writes = 1U << RA;
+				crWrites = RCBIT ? 1 : 0;
+				break;
+			case 24:	// ori
+			case 25:	// oris
+			case 26:	// xori
+			case 27:	// xoris
+				reads = 1U << RS;
+				writes = 1U << RA;
+				break;
+			case 28:	// andi.
+			case 29:	// andis.
+				reads = 1U << RS;
+				writes = 1U << RA;
+				crWrites = 1;
+				break;
+			case 31:
+				switch ((op >> 1) & 0x3ff)
+				{
+				case 0:		// cmp
+				case 32:	// cmpl
+					reads = (1U << RA) | (1U << RB);
+					crWrites = 1U << CRFD;
+					break;
+				case 28:	// and
+				case 316:	// xor
+				case 444:	// or
+					reads = (1U << RS) | (1U << RB);
+					writes = 1U << RA;
+					crWrites = RCBIT ? 1 : 0;
+					break;
+				case 598:	// sync
+				case 854:	// eieio
+					break;
+				default:
+					return false;
+				}
+				break;
+			case 16:	// bc
+			{
+				if (LKBIT || AABIT || !(BO & 4))	// must not link or decrement CTR
+					return false;
+				UINT32 target = pc + i * 4 + (SIMM16 & ~3);
+				if (last ? (target != pc) : (target >= pc && target < end))
+					return false;
+				if (!(BO & 0x10))
+					crReads = 1U << (BI >> 2);
+				break;
+			}
+			case 18:	// b
+			{
+				if (!last || LKBIT || AABIT)
+					return false;
+				INT32 li = op & 0x3fffffc;
+				if (li & 0x2000000)
+					li |= 0xfc000000;
+				if (pc + i * 4 + li != pc)
+					return false;
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+
+		// The loop must end with the branch back to its start
+		if (last && (op >> 26) != 16 && (op >> 26) != 18)
+			return false;
+
+		gprRead |= reads & ~gprWritten;
+		gprWritten |= writes;
+		crRead |= crReads & ~crWritten;
+		crWritten |= crWrites;
+	}
+
+	// No state may be carried from one iteration to the next
+	return ((gprRead | gprBase) & gprWritten) == 0 && (crRead & crWritten) == 0;
+}
+
+// Returns true if all loads in the loop read from idle regions
+static bool ppc_idle_check_loads(const PPC_IDLE_LOOP *loop)
+{
+	for (UINT32 i = 0; i < loop->length; i++)
+	{
+		if (!(loop->loads & (1U << i)))
+			continue;
+		UINT32 ea = ppc_idle_load_address(loop->ops[i]);
+		unsigned r;
+		for (r = 0; r < idle_num_regions; r++)
+		{
+			if (ea >= idle_regions[r].start && ea <= idle_regions[r].end)
+				break;
+		}
+		if (r == idle_num_regions)
+			return false;
+	}
+	return true;
+}
+
+
+/******************************************************************************
+ Skipping
+******************************************************************************/
+
+// Fast-forwards to the next event
+static void ppc_idle_skip(void)
+{
+	int stop = 0;
+
+	// Decrementer exception occurs when ppc.icount reaches dec_trigger_cycle
+	if (ppc.dec_trigger_cycle < ppc.icount)
+		stop = ppc.dec_trigger_cycle + 1;
+
+	if (stop < ppc.icount)
+	{
+		idle_cycles += ppc.icount - stop;
+		ppc.icount = stop;
+	}
+}
+
+// Called when the branch at ppc.pc has just been taken backwards to ppc.npc
+static void ppc_idle_check(void)
+{
+	UINT32 pc = ppc.npc;
+
+	for (unsigned i = 0; i < idle_num_loops; i++)
+	{
+		if (idle_loops[i] == pc)
+		{
+			ppc_idle_skip();
+			return;
+		}
+	}
+
+	UINT32 length = ((ppc.pc - pc) >> 2) + 1;
+	if (!idle_detect || length > PPC_IDLE_MAX_LOOP)
+		return;
+	if (pc < ppc.cur_fetch.start || ppc.pc > ppc.cur_fetch.end)
+		return;
+	const UINT32 *code = &ppc.cur_fetch.ptr[(pc - ppc.cur_fetch.start) / 4];
+
+	// Look up the loop, analyzing it again if it is new or has been modified
+	PPC_IDLE_LOOP *loop = &idle_cache[(pc >> 2) & (PPC_IDLE_CACHE_SIZE - 1)];
+	if (loop->pc != pc || loop->length != length || memcmp(loop->ops, code, length * sizeof(UINT32)) != 0)
+	{
+		loop->pc = pc;
+		loop->length = length;
+		memcpy(loop->ops, code, length * sizeof(UINT32));
+		loop->idle = ppc_idle_analyze(code, pc, length, &loop->loads);
+	}
+
+	// Addresses depend on loop-invariant registers, which may differ each time
+	// the loop is entered
+	if (loop->idle && ppc_idle_check_loads(loop))
+		ppc_idle_skip();
+}
+
+static inline void ppc_idle_branch(void)
+{
+	if (idle_enabled && (UINT32) (ppc.pc - ppc.npc) < PPC_IDLE_MAX_SPAN)
+		ppc_idle_check();
+}
+
+
+/******************************************************************************
+ Configuration
+******************************************************************************/
+
+/*
+ * ppc_set_idle_skip(detect, loops, numLoops):
+ *
+ * Enables automatic detection of idle loops and sets the start addresses of
+ * loops that are known to be idle (taken from the game's configuration). Up
+ * to PPC_IDLE_MAX_LOOPS addresses are used.
+ */
+void ppc_set_idle_skip(bool detect, const UINT32 *loops, unsigned numLoops)
+{
+	if (numLoops > PPC_IDLE_MAX_LOOPS)
+	{
+		ErrorLog("Too many idle loops specified. Only the first %d will be used.", PPC_IDLE_MAX_LOOPS);
+		numLoops = PPC_IDLE_MAX_LOOPS;
+	}
+	for (unsigned i = 0; i < numLoops; i++)
+		idle_loops[i] = loops[i];
+	idle_num_loops = numLoops;
+	idle_detect = detect;
+	idle_enabled = detect || numLoops > 0;
+	memset(idle_cache, 0, sizeof(idle_cache));
+}
+
+void ppc_set_idle_regions(const PPC_IDLE_REGION *regions, unsigned numRegions)
+{
+	if (numRegions > PPC_IDLE_MAX_REGIONS)
+		numRegions = PPC_IDLE_MAX_REGIONS;
+	for (unsigned i = 0; i < numRegions; i++)
+		idle_regions[i] = regions[i];
+	idle_num_regions = numRegions;
+}
+
+// Returns the total number of cycles skipped in idle loops
+UINT64 ppc_get_idle_cycles(void)
+{
+	return idle_cycles;
+}
@@ -0,0 +1,608 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * ppc_jit.c
+ *
+ * Basic block recompiler for the PowerPC 603e. Included from ppc.cpp; do not
+ * compile separately.
+ *
+ * Guest code is translated one basic block at a time into x86-64 host code.
+ * Blocks end at the first branch, trap, rfi, isync, mtmsr or mtspr, at a 4 KB
+ * page boundary, or after PPC_JIT_MAX_BLOCK instructions. Each instruction is
+ * translated into a call to its interpreter handler (a handful of simple
+ * integer operations are emitted inline instead), so the emulated behavior is
+ * identical to that of ppc_execute().
+ *
+ * Timing
+ * ------
+ * ppc.icount is decremented after every handler call exactly as the
+ * interpreter does, so ppc_total_cycles(), the timebase and the decrementer
+ * read back the same values from within handlers. Decrements for inlined
+ * instructions are batched and flushed before the next handler call or when
+ * the block exits. A block is only entered if it cannot run past the end of
+ * the time slice or across dec_trigger_cycle; otherwise the dispatcher falls
+ * back to interpreting single instructions until the event has passed.
+ *
+ * Self-Modifying Code
+ * -------------------
+ * Blocks from the fetch region at address 0 (RAM) are tagged with the
+ * generation count of their 4 KB page, and every RAM word belonging to a
+ * block is marked in ppc_code_map. CModel3's RAM write handlers call
+ * ppc_code_write(), which bumps the page generation when a marked word is
+ * written, discarding all blocks from that page. A write to the block that is
+ * currently executing also sets ppc.block_break so that the block returns to
+ * the dispatcher immediately after the store.
+ *
+ * The block boundaries, code tracking and dispatch rules are shared with the
+ * threaded interpreter (ppc_threaded.c).
+ */
+
+
+/******************************************************************************
+ Code Tracking and Block Rules (all block-based engines)
+******************************************************************************/
+
+#define PPC_CODE_PAGE_SHIFT		12						// code invalidation granularity (4 KB)
+#define PPC_MAX_BLOCK			64						// maximum number of instructions per block
+
+UINT32				*ppc_code_map = NULL;		// one bit per RAM word that belongs to a cached block
+
+static UINT32		*code_page_gen = NULL;		// generation count of each RAM page
+static UINT32		code_ram_size = 0;			// size of fetch region starting at address 0
+
+static inline UINT32 ppc_code_page_gen(UINT32 pc)
+{
+	return (pc < code_ram_size) ? code_page_gen[pc >> PPC_CODE_PAGE_SHIFT] : 0;
+}
+
+static inline void ppc_code_mark(UINT32 addr)
+{
+	if (addr < code_ram_size)
+		ppc_code_map[addr >> 7] |= 1 << ((addr >> 2) & 31);
+}
+
+void ppc_invalidate_code(UINT32 addr)
+{
+	UINT32 page = addr >> PPC_CODE_PAGE_SHIFT;
+	++code_page_gen[page];
+	memset(&ppc_code_map[page << (PPC_CODE_PAGE_SHIFT - 7)], 0, 1 << (PPC_CODE_PAGE_SHIFT - 5));
+	ppc.block_break = true;
+}
+
+// Called by the core's own memory write handlers for directly mapped memory
+static inline void ppc_code_written(UINT32 addr)
+{
+	if (addr < code_ram_size)
+		ppc_code_write(addr);
+}
+
+static void ppc_code_clear_map(void)
+{
+	if (ppc_code_map != NULL)
+		memset(ppc_code_map, 0, code_ram_size / 8 / 4 * sizeof(UINT32));
+}
+
+static void ppc_code_untrack(void)
+{
+	delete [] ppc_code_map;
+	delete [] code_page_gen;
+	ppc_code_map = NULL;
+	code_page_gen = NULL;
+	code_ram_size = 0;
+}
+
+// Only the region at address 0 (RAM) is writeable and must be tracked
+static void ppc_code_track(PPC_FETCH_REGION *fetch)
+{
+	ppc_code_untrack();
+	for (int i = 0; fetch[i].ptr != NULL; i++)
+	{
+		if (fetch[i].start == 0)
+		{
+			code_ram_size = (fetch[i].end + 1) & ~((1 << PPC_CODE_PAGE_SHIFT) - 1);
+			code_page_gen = new UINT32[code_ram_size >> PPC_CODE_PAGE_SHIFT]();
+			ppc_code_map = new UINT32[code_ram_size / 8 / 4]();
+			break;
+		}
+	}
+}
+
+// Returns the interpreter handler for an opcode
+static void (*ppc_decode_handler(UINT32 op))(UINT32)
+{
+	switch (op >> 26)
+	{
+	case 19:	return optable19[(op >> 1) & 0x3ff];
+	case 31:	return optable31[(op >> 1) & 0x3ff];
+	case 59:	return optable59[(op >> 1) & 0x3ff];
+	case 63:	return optable63[(op >> 1) & 0x3ff];
+	default:	return optable[op >> 26];
+	}
+}
+
+// Instructions that may change control flow or processor state in a way that
+// is not checked for within a block must end it
+static bool ppc_ends_block(UINT32 op)
+{
+	switch (op >> 26)
+	{
+	case 3:		// twi
+	case 16:	// bcx
+	case 17:	// sc
+	case 18:	// bx
+		return true;
+	case 19:
+		switch ((op >> 1) & 0x3ff)
+		{
+		case 16:	// bclrx
+		case 50:	// rfi
+		case 150:	// isync
+		case 528:	// bcctrx
+			return true;
+		}
+		break;
+	case 31:
+		switch ((op >> 1) & 0x3ff)
+		{
+		case 4:		// tw
+		case 146:	// mtmsr
+		case 467:	// mtspr
+			return true;
+		}
+		break;
+	}
+	return ppc_decode_handler(op) == ppc_invalid;
+}
+
+// Returns true if the last instruction of a block starting at pc has been
+// reached
+static inline bool ppc_block_full(UINT32 pc, UINT32 addr, UINT32 len)
+{
+	UINT32 page_end = (pc | ((1 << PPC_CODE_PAGE_SHIFT) - 1)) - 3;
+	return len >= PPC_MAX_BLOCK || addr >= page_end || addr >= ppc.cur_fetch.end - 3;
+}
+
+// A block may not run past the end of the time slice or through the cycle on
+// which the decrementer fires
+static inline bool ppc_block_fits(int len)
+{
+	return !(ppc.icount < len || (ppc.dec_trigger_cycle < ppc.icount && ppc.dec_trigger_cycle >= ppc.icount - len));
+}
+
+// Interprets a single instruction at ppc.npc (ppc.op must point to it)
+static void ppc_step(void)
+{
+	ppc.pc = ppc.npc;
+	UINT32 opcode = *ppc.op++;
+	ppc.npc = ppc.pc + 4;
+	ppc_dispatch(opcode);
+	ppc.icount--;
+	if (ppc.icount == ppc.dec_trigger_cycle)
+	{
+		ppc.interrupt_pending |= 0x2;
+		ppc603_check_interrupts();
+	}
+	ppc_idle_branch();
+}
+
+// Called after a block returns. Only a final mtspr to DEC can have moved the
+// trigger into the block.
+static inline void ppc_block_check_decrementer(void)
+{
+	if (ppc.icount == ppc.dec_trigger_cycle)
+	{
+		ppc.interrupt_pending |= 0x2;
+		ppc603_check_interrupts();
+	}
+}
+
+
+/******************************************************************************
+ x86-64 Recompiler
+******************************************************************************/
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define PPC_JIT_CACHE_SIZE		65536					// block cache entries (must be power of 2)
+#define PPC_JIT_BUFFER_SIZE		(32*1024*1024)			// executable code buffer size
+#define PPC_JIT_MAX_INSN_SIZE	128						// upper bound on host code emitted per instruction
+
+typedef struct
+{
+	UINT32	pc;			// guest address of first instruction
+	UINT32	gen;		// page generation at time of translation
+	UINT32	length;		// number of guest instructions
+	UINT8	*code;		// host code (NULL if entry is empty)
+} PPC_JIT_BLOCK;
+
+static PPC_JIT_BLOCK	*jit_cache = NULL;
+static UINT8		*jit_buffer = NULL;
+static UINT8		*jit_ptr;					// next free byte in jit_buffer
+
+
+/*
+ * Code emitter. All guest state is addressed relative to rbx, which holds
+ * &ppc for the lifetime of a block.
+ */
+
+#define JIT_OFS(field)	((UINT32) offsetof(PPC_REGS, field))
+#define JIT_GPR(n)		(JIT_OFS(r) + (n) * 4)
+
+static inline void emit8(UINT8 b)
+{
+	*jit_ptr++ = b;
+}
+
+static inline void emit32(UINT32 d)
+{
+	memcpy(jit_ptr, &d, 4);
+	jit_ptr += 4;
+}
+
+static inline void emit64(UINT64 q)
+{
+	memcpy(jit_ptr, &q, 8);
+	jit_ptr += 8;
+}
+
+// mov dword [rbx+ofs],imm32
+static void emit_store_imm(UINT32 ofs, UINT32 imm)
+{
+	emit8(0xC7); emit8(0x83); emit32(ofs); emit32(imm);
+}
+
+// mov eax,[rbx+ofs]
+static void emit_load_eax(UINT32 ofs)
+{
+	emit8(0x8B); emit8(0x83); emit32(ofs);
+}
+
+// mov [rbx+ofs],eax
+static void emit_store_eax(UINT32 ofs)
+{
+	emit8(0x89); emit8(0x83); emit32(ofs);
+}
+
+// sub dword [rbx+ofs],imm32
+static void emit_sub_imm(UINT32 ofs, UINT32 imm)
+{
+	emit8(0x81); emit8(0xAB); emit32(ofs); emit32(imm);
+}
+
+// cmp dword [rbx+ofs],imm32 ; jne exit
+static void emit_exit_if_ne(UINT32 ofs, UINT32 imm, UINT8 **patch, int *num_patches)
+{
+	emit8(0x81); emit8(0xBB); emit32(ofs); emit32(imm);
+	emit8(0x0F); emit8(0x85); patch[(*num_patches)++] = jit_ptr; emit32(0);
+}
+
+// cmp byte [rbx+ofs],0 ; jne exit
+static void emit_exit_if_set(UINT32 ofs, UINT8 **patch, int *num_patches)
+{
+	emit8(0x80); emit8(0xBB); emit32(ofs); emit8(0);
+	emit8(0x0F); emit8(0x85); patch[(*num_patches)++] = jit_ptr; emit32(0);
+}
+
+// Calls handler(op) using the host ABI
+static void emit_call_handler(void (*handler)(UINT32), UINT32 op)
+{
+#ifdef _WIN32
+	emit8(0xB9); emit32(op);									// mov ecx,op
+#else
+	emit8(0xBF); emit32(op);									// mov edi,op
+#endif
+	emit8(0x48); emit8(0xB8); emit64((UINT64) (size_t) handler);	// mov rax,handler
+	emit8(0xFF); emit8(0xD0);									// call rax
+}
+
+static void emit_prologue(void)
+{
+	emit8(0x53);												// push rbx
+#ifdef _WIN32
+	emit8(0x48); emit8(0x83); emit8(0xEC); emit8(0x20);			// sub rsp,32 (shadow space)
+#endif
+	emit8(0x48); emit8(0xBB); emit64((UINT64) (size_t) &ppc);	// mov rbx,&ppc
+}
+
+static void emit_epilogue(void)
+{
+#ifdef _WIN32
+	emit8(0x48); emit8(0x83); emit8(0xC4); emit8(0x20);			// add rsp,32
+#endif
+	emit8(0x5B);												// pop rbx
+	emit8(0xC3);												// ret
+}
+
+
+/*
+ * Translation
+ */
+
+// Emits inline code for simple integer instructions. Returns false if the
+// instruction must go through its handler.
+static bool ppc_jit_emit_inline(UINT32 op)
+{
+	UINT32 rt = RT, ra = RA, rb = RB;
+
+	switch (op >> 26)
+	{
+	case 14:	// addi
+	case 15:	// addis
+	{
+		UINT32 imm = ((op >> 26) == 14) ? (UINT32) SIMM16 : (UIMM16 << 16);
+		if (ra == 0)
+			emit_store_imm(JIT_GPR(rt), imm);
+		else
+		{
+			emit_load_eax(JIT_GPR(ra));
+			emit8(0x05); emit32(imm);							// add eax,imm
+			emit_store_eax(JIT_GPR(rt));
+		}
+		return true;
+	}
+	case 21:	// rlwinm
+		if (RCBIT)
+			return false;
+		emit_load_eax(JIT_GPR(RS));
+		if (SH != 0)
+		{
+			emit8(0xC1); emit8(0xC0); emit8(SH);				// rol eax,sh
+		}
+		emit8(0x25); emit32(GET_ROTATE_MASK(MB, ME));			// and eax,mask
+		emit_store_eax(JIT_GPR(ra));
+		return true;
+	case 24:	// ori
+	case 25:	// oris
+	{
+		UINT32 imm = ((op >> 26) == 24) ? UIMM16 : (UIMM16 << 16);
+		if (imm == 0 && RS == ra)
+			return true;										// nop
+		emit_load_eax(JIT_GPR(RS));
+		emit8(0x0D); emit32(imm);								// or eax,imm
+		emit_store_eax(JIT_GPR(ra));
+		return true;
+	}
+	case 31:
+		if (RCBIT)
+			return false;
+		switch ((op >> 1) & 0x3ff)
+		{
+		case 266:	// add (OE=0)
+			emit_load_eax(JIT_GPR(ra));
+			emit8(0x03); emit8(0x83); emit32(JIT_GPR(rb));	// add eax,[rb]
+			emit_store_eax(JIT_GPR(rt));
+			return true;
+		case 444:	// or (mr when rS == rB)
+			emit_load_eax(JIT_GPR(RS));
+			if (rb != RS)
+			{
+				emit8(0x0B); emit8(0x83); emit32(JIT_GPR(rb));	// or eax,[rb]
+			}
+			emit_store_eax(JIT_GPR(ra));
+			return true;
+		}
+		break;
+	}
+	return false;
+}
+
+// Translates the block beginning at pc (ppc.op must point to it)
+static PPC_JIT_BLOCK *ppc_jit_translate(UINT32 pc)
+{
+	UINT8	*patch[PPC_MAX_BLOCK * 3];
+	int		num_patches = 0;
+	UINT32	pending = 0;		// icount decrements not yet emitted
+	bool	last_inline = false;
+	UINT32	*src = ppc.op;
+	UINT32	len = 0;
+	UINT32	addr = pc;
+
+	if ((size_t) (jit_buffer + PPC_JIT_BUFFER_SIZE - jit_ptr) < (PPC_MAX_BLOCK + 2) * PPC_JIT_MAX_INSN_SIZE)
+		ppc_jit_flush();
+
+	PPC_JIT_BLOCK *block = &jit_cache[(pc >> 2) & (PPC_JIT_CACHE_SIZE - 1)];
+	block->pc = pc;
+	block->gen = ppc_code_page_gen(pc);
+	block->code = jit_ptr;
+
+	emit_prologue();
+
+	while (1)
+	{
+		UINT32 op = *src++;
+
+		if (ppc_jit_emit_inline(op))
+		{
+			++pending;
+			last_inline = true;
+		}
+		else
+		{
+			// The interpreter decrements icount after the handler returns
+			if (pending)
+				emit_sub_imm(JIT_OFS(icount), pending);
+			emit_store_imm(JIT_OFS(pc), addr);
+			emit_store_imm(JIT_OFS(npc), addr + 4);
+			emit_call_handler(ppc_decode_handler(op), op);
+			emit_sub_imm(JIT_OFS(icount), 1);
+			pending = 0;
+			last_inline = false;
+
+			// Exit if the handler branched, raised an exception, halted the
+			// CPU or overwrote code
+			if (!ppc_ends_block(op))
+			{
+				emit_exit_if_ne(JIT_OFS(npc), addr + 4, patch, &num_patches);
+				emit_exit_if_set(JIT_OFS(fatalError), patch, &num_patches);
+				emit_exit_if_set(JIT_OFS(block_break), patch, &num_patches);
+			}
+		}
+
+		ppc_code_mark(addr);
+
+		++len;
+		if (ppc_ends_block(op) || ppc_block_full(pc, addr, len))
+			break;
+		addr += 4;
+	}
+
+	// Write back state after trailing inlined instructions
+	if (pending)
+		emit_sub_imm(JIT_OFS(icount), pending);
+	if (last_inline)
+	{
+		emit_store_imm(JIT_OFS(pc), addr);
+		emit_store_imm(JIT_OFS(npc), addr + 4);
+	}
+
+	// All early exits land on the shared epilogue
+	for (int i = 0; i < num_patches; i++)
+	{
+		INT32 rel = (INT32) (jit_ptr - (patch[i] + 4));
+		memcpy(patch[i], &rel, 4);
+	}
+	emit_epilogue();
+
+	block->length = len;
+	return block;
+}
+
+
+/*
+ * Dispatcher
+ */
+
+static void ppc_jit_run(void)
+{
+	while (ppc.icount > 0 && !ppc.fatalError)
+	{
+		UINT32 pc = ppc.npc;
+		ppc_change_pc(pc);
+		if (ppc.fatalError)
+			break;
+
+		PPC_JIT_BLOCK *block = &jit_cache[(pc >> 2) & (PPC_JIT_CACHE_SIZE - 1)];
+		if (block->code == NULL || block->pc != pc || block->gen != ppc_code_page_gen(pc))
+			block = ppc_jit_translate(pc);
+
+		if (!ppc_block_fits((int) block->length))
+		{
+			ppc_step();
+			continue;
+		}
+
+		ppc.block_break = false;
+		((void (*)(void)) block->code)();
+		ppc_block_check_decrementer();
+		ppc_idle_branch();
+	}
+}
+
+
+/*
+ * Cache management
+ */
+
+static void ppc_jit_flush(void)
+{
+	if (jit_cache == NULL)
+		return;
+	memset(jit_cache, 0, PPC_JIT_CACHE_SIZE * sizeof(PPC_JIT_BLOCK));
+	jit_ptr = jit_buffer;
+}
+
+static bool ppc_jit_enabled(void)
+{
+#ifdef SUPERMODEL_DEBUGGER
+	if (PPCDebug != NULL)
+		return false;
+#endif
+	return ppc.engine == PPC_ENGINE_RECOMPILER;
+}
+
+static bool ppc_jit_init(void)
+{
+#ifdef _WIN32
+	jit_buffer = (UINT8 *) VirtualAlloc(NULL, PPC_JIT_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	jit_buffer = (UINT8 *) mmap(NULL, PPC_JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (jit_buffer == MAP_FAILED)
+		jit_buffer = NULL;
+#endif
+	if (jit_buffer == NULL)
+	{
+		ErrorLog("Unable to allocate executable memory for PowerPC recompiler. Using interpreter instead.");
+		return FAIL;
+	}
+
+	jit_cache = new PPC_JIT_BLOCK[PPC_JIT_CACHE_SIZE]();
+	jit_ptr = jit_buffer;
+	return OKAY;
+}
+
+static void ppc_jit_shutdown(void)
+{
+	if (jit_buffer != NULL)
+	{
+#ifdef _WIN32
+		VirtualFree(jit_buffer, 0, MEM_RELEASE);
+#else
+		munmap(jit_buffer, PPC_JIT_BUFFER_SIZE);
+#endif
+	}
+	delete [] jit_cache;
+	jit_buffer = NULL;
+	jit_cache = NULL;
+}
+
+#else	// !x86-64
+
+static void ppc_jit_run(void)
+{
+}
+
+static void ppc_jit_flush(void)
+{
+}
+
+static bool ppc_jit_enabled(void)
+{
+	return false;
+}
+
+static bool ppc_jit_init(void)
+{
+	ErrorLog("PowerPC recompiler is only supported on x86-64. Using interpreter instead.");
+	return FAIL;
+}
+
+static void ppc_jit_shutdown(void)
+{
+}
+
+#endif	// x86-64
@@ -0,0 +1,286 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * ppc_threaded.c
+ *
+ * Threaded interpreter for the PowerPC 603e. Included from ppc.cpp after
+ * ppc_jit.c; do not compile separately.
+ *
+ * Straight-line blocks are decoded once into arrays of PPC_DECODED_OP, each
+ * holding the function that executes it and the operand fields it needs, and
+ * are kept in a block cache. Block boundaries, invalidation of blocks in RAM
+ * and the rules for when a block may be entered are the same as for the
+ * recompiler (see ppc_jit.c), so a block is executed without checking the
+ * time slice or the decrementer after every instruction.
+ *
+ * Common integer instructions have dedicated functions that use the
+ * predecoded fields directly. Everything else calls the regular interpreter
+ * handler. Only the latter need ppc.pc, ppc.npc and ppc.icount to be up to
+ * date, so these are written just before the handler is called.
+ */
+
+#define PPC_THR_CACHE_SIZE		16384					// block cache entries (must be power of 2)
+#define PPC_THR_POOL_SIZE		(256*1024)				// decoded instructions in pool
+
+struct PPC_DECODED_OP;
+
+// Returns false if the block must be exited after this instruction
+typedef bool (*PPC_THR_FUNC)(const struct PPC_DECODED_OP *d);
+
+typedef struct PPC_DECODED_OP
+{
+	PPC_THR_FUNC	exec;
+	void			(*handler)(UINT32);	// interpreter handler (generic instructions)
+	UINT32			op;
+	UINT32			pc;
+	UINT32			imm;		// SIMM/UIMM, shifted as needed, or rotate mask
+	UINT8			rd;			// rD/rS
+	UINT8			ra;
+	UINT8			rb;			// rB or rotate amount
+	UINT8			index;		// position within block
+} PPC_DECODED_OP;
+
+typedef struct
+{
+	UINT32			pc;
+	UINT32			gen;		// page generation at time of decoding
+	UINT32			length;
+	PPC_DECODED_OP	*ops;		// NULL if entry is empty
+} PPC_THR_BLOCK;
+
+static PPC_THR_BLOCK	*thr_cache = NULL;
+static PPC_DECODED_OP	*thr_pool = NULL;
+static UINT32			thr_pool_used = 0;
+static int				thr_icount_base;	// ppc.icount on entry to current block
+
+
+/******************************************************************************
+ Instruction Functions
+******************************************************************************/
+
+static bool thr_generic(const PPC_DECODED_OP *d)
+{
+	ppc.pc = d->pc;
+	ppc.npc = d->pc + 4;
+	ppc.icount = thr_icount_base - d->index;
+	d->handler(d->op);
+	return ppc.npc == d->pc + 4 && !ppc.fatalError && !ppc.block_break;
+}
+
+static bool thr_addi(const PPC_DECODED_OP *d)
+{
+	REG(d->rd) = REG(d->ra) + d->imm;
+	return true;
+}
+
+static bool thr_li(const PPC_DECODED_OP *d)
+{
+	REG(d->rd) = d->imm;
+	return true;
+}
+
+static bool thr_ori(const PPC_DECODED_OP *d)
+{
+	REG(d->ra) = REG(d->rd) | d->imm;
+	return true;
+}
+
+static bool thr_rlwinm(const PPC_DECODED_OP *d)
+{
+	UINT32 r = REG(d->rd);
+	REG(d->ra) = ((r << d->rb) | (r >> ((32 - d->rb) & 31))) & d->imm;
+	return true;
+}
+
+static bool thr_add(const PPC_DECODED_OP *d)
+{
+	REG(d->rd) = REG(d->ra) + REG(d->rb);
+	return true;
+}
+
+static bool thr_or(const PPC_DECODED_OP *d)
+{
+	REG(d->ra) = REG(d->rd) | REG(d->rb);
+	return true;
+}
+
+static bool thr_nop(const PPC_DECODED_OP *d)
+{
+	return true;
+}
+
+// Selects a dedicated function for the instruction if there is one
+static void ppc_thr_decode(PPC_DECODED_OP *d, UINT32 op, UINT32 pc, UINT32 index)
+{
+	d->exec = thr_generic;
+	d->handler = ppc_decode_handler(op);
+	d->op = op;
+	d->pc = pc;
+	d->imm = 0;
+	d->rd = RT;
+	d->ra = RA;
+	d->rb = RB;
+	d->index = index;
+
+	switch (op >> 26)
+	{
+	case 14:	// addi
+		d->imm = SIMM16;
+		d->exec = (d->ra == 0) ? thr_li : thr_addi;
+		break;
+	case 15:	// addis
+		d->imm = UIMM16 << 16;
+		d->exec = (d->ra == 0) ? thr_li : thr_addi;
+		break;
+	case 21:	// rlwinm
+		if (!RCBIT)
+		{
+			d->rb = SH;
+			d->imm = GET_ROTATE_MASK(MB, ME);
+			d->exec = thr_rlwinm;
+		}
+		break;
+	case 24:	// ori
+	case 25:	// oris
+		d->imm = ((op >> 26) == 24) ? UIMM16 : (UIMM16 << 16);
+		d->exec = (d->imm == 0 && d->rd == d->ra) ? thr_nop : thr_ori;
+		break;
+	case 31:
+		if (RCBIT)
+			break;
+		switch ((op >> 1) & 0x3ff)
+		{
+		case 266:	d->exec = thr_add; break;	// add (OE=0)
+		case 444:	d->exec = thr_or; break;	// or
+		}
+		break;
+	}
+}
+
+
+/******************************************************************************
+ Block Cache
+******************************************************************************/
+
+static void ppc_threaded_flush(void)
+{
+	if (thr_cache == NULL)
+		return;
+	memset(thr_cache, 0, PPC_THR_CACHE_SIZE * sizeof(PPC_THR_BLOCK));
+	thr_pool_used = 0;
+}
+
+// Decodes the block beginning at pc (ppc.op must point to it)
+static PPC_THR_BLOCK *ppc_thr_decode_block(UINT32 pc)
+{
+	if (thr_pool_used + PPC_MAX_BLOCK > PPC_THR_POOL_SIZE)
+		ppc_threaded_flush();
+
+	PPC_THR_BLOCK *block = &thr_cache[(pc >> 2) & (PPC_THR_CACHE_SIZE - 1)];
+	block->pc = pc;
+	block->gen = ppc_code_page_gen(pc);
+	block->ops = &thr_pool[thr_pool_used];
+
+	UINT32 *src = ppc.op;
+	UINT32 len = 0;
+	UINT32 addr = pc;
+	while (1)
+	{
+		UINT32 op = *src++;
+		ppc_thr_decode(&block->ops[len], op, addr, len);
+		ppc_code_mark(addr);
+		++len;
+		if (ppc_ends_block(op) || ppc_block_full(pc, addr, len))
+			break;
+		addr += 4;
+	}
+
+	block->length = len;
+	thr_pool_used += len;
+	return block;
+}
+
+static void ppc_threaded_run(void)
+{
+	while (ppc.icount > 0 && !ppc.fatalError)
+	{
+		UINT32 pc = ppc.npc;
+		ppc_change_pc(pc);
+		if (ppc.fatalError)
+			break;
+
+		PPC_THR_BLOCK *block = &thr_cache[(pc >> 2) & (PPC_THR_CACHE_SIZE - 1)];
+		if (block->ops == NULL || block->pc != pc || block->gen != ppc_code_page_gen(pc))
+			block = ppc_thr_decode_block(pc);
+
+		if (!ppc_block_fits((int) block->length))
+		{
+			ppc_step();
+			continue;
+		}
+
+		ppc.block_break = false;
+		thr_icount_base = ppc.icount;
+		const PPC_DECODED_OP *d = block->ops;
+		const PPC_DECODED_OP *end = d + block->length;
+		while (d->exec(d) && ++d < end)
+			;
+		if (d == end)
+			--d;
+
+		// Write back state after a trailing dedicated instruction
+		if (d->exec != thr_generic)
+		{
+			ppc.pc = d->pc;
+			ppc.npc = d->pc + 4;
+		}
+		ppc.icount = thr_icount_base - d->index - 1;
+		ppc_block_check_decrementer();
+		ppc_idle_branch();
+	}
+}
+
+static bool ppc_threaded_enabled(void)
+{
+#ifdef SUPERMODEL_DEBUGGER
+	if (PPCDebug != NULL)
+		return false;
+#endif
+	return ppc.engine == PPC_ENGINE_THREADED;
+}
+
+static bool ppc_threaded_init(void)
+{
+	thr_cache = new PPC_THR_BLOCK[PPC_THR_CACHE_SIZE]();
+	thr_pool = new PPC_DECODED_OP[PPC_THR_POOL_SIZE];
+	thr_pool_used = 0;
+	return OKAY;
+}
+
+static void ppc_threaded_shutdown(void)
+{
+	delete [] thr_cache;
+	delete [] thr_pool;
+	thr_cache = NULL;
+	thr_pool = NULL;
+	thr_pool_used = 0;
+}
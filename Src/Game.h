@@ -3,6 +3,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 struct Game
 {
@@ -15,6 +16,8 @@ struct Game
   std::string stepping;
   std::string mpeg_board;
   uint32_t encryption_key = 0;
+  bool idle_loop_detect = true;     // automatic PowerPC idle loop detection
+  std::vector<uint32_t> idle_loops; // start addresses of known PowerPC idle loops
   enum Inputs
   {
     INPUT_UI              = 0,          // special code reserved for Supermodel UI inputs
@@ -198,6 +198,12 @@ static void PopulateGameInfo(Game *game, const Util::Config::Node &game_node)
   game->stepping = game_node["hardware/stepping"].ValueAsDefault<std::string>("");
   game->mpeg_board = game_node["hardware/mpeg_board"].ValueAsDefault<std::string>("");
   game->encryption_key = game_node["hardware/encryption_key"].ValueAsDefault<uint32_t>(0);
+  game->idle_loop_detect = game_node["hardware/idle_loops/detect"].ValueAsDefault<bool>(true);
+  for (auto &node: game_node["hardware/idle_loops"])
+  {
+    if (node.Key() == "idle_loop" && node["address"].Exists())
+      game->idle_loops.push_back(node["address"].ValueAs<uint32_t>());
+  }
   std::map<std::string, uint32_t> input_flags
   {
     { "common",           Game::INPUT_COMMON },
@@ -20,6 +20,7 @@ public:
   virtual bool Init(unsigned xOffset, unsigned yOffset, unsigned xRes, unsigned yRes, unsigned totalXRes, unsigned totalYRes) = 0;
   virtual void SetSunClamp(bool enable) = 0;
   virtual void SetSignedShade(bool enable) = 0;
+  virtual bool GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions) = 0;  // false if there is no model cache
 
   virtual ~IRender3D()
   {
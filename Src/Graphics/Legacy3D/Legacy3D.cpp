@@ -158,6 +158,7 @@
 
 #include "Supermodel.h"
 #include "Graphics/Legacy3D/Shaders3D.h"  // fragment and vertex shaders
+#include "Graphics/TextureDecode.h"
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
@@ -231,142 +232,14 @@ void CLegacy3D::DecodeTexture(int format, int x, int y, int width, int height)
 
   //printf("Decoding texture format %u: %u x %u @ (%u, %u) sheet %u\n", format, width, height, x, y, texNum);
 
-  // Copy and decode
-  int i = 0;
-  switch (format)
-  {
-  default:  // Unknown
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        textureBuffer[i++] = 0.0; // R
-        textureBuffer[i++] = 0.0; // G
-        textureBuffer[i++] = 1.0f;  // B
-        textureBuffer[i++] = 1.0f;  // A
-      }
-    }
-    break;    
-  case 0: // T1RGB5
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>10)&0x1F) * (1.0f/31.0f);  // R
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>5)&0x1F) * (1.0f/31.0f); // G
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>0)&0x1F) * (1.0f/31.0f); // B
-        textureBuffer[i++] = ((textureRAM[yi*2048+xi]&0x8000)?0.0f:1.0f);         // T
-      }
-    }
-    break;
-  case 7: // RGBA4
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>12)&0xF) * (1.0f/15.0f); // R
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>8)&0xF) * (1.0f/15.0f);  // G
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>4)&0xF) * (1.0f/15.0f);  // B
-        textureBuffer[i++] = (GLfloat) ((textureRAM[yi*2048+xi]>>0)&0xF) * (1.0f/15.0f);  // A
-      }
-    }
-    break;
-  case 5: // 8-bit grayscale
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        // Interpret as 8-bit grayscale
-        uint16_t texel = textureRAM[yi*2048+xi] & 0xFF;
-        GLfloat c = texel * (1.0f/255.0f);
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = (texel == 0xFF) ? 0.f : 1.f;
-      }
-    }
-    break;
-  case 4: // 8-bit L4A4 (high byte)
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        uint16_t texel = textureRAM[yi*2048+xi] >> 8;
-        GLfloat c = (texel >> 4) * (1.0f/15.0f);
-        GLfloat a = (texel & 0xF) * (1.0f/15.0f);
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = a;
-      }
-    }
-    break;
-  case 6: // 8-bit grayscale
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        uint16_t texel = textureRAM[yi*2048+xi] >> 8;
-        GLfloat c = texel * (1.0f/255.0f);
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = (texel == 0xFF) ? 0.f : 1.f;
-      }
-    }
-    break;
-  case 2: // 8-bit L4A4 (low byte)
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        uint16_t texel = textureRAM[yi*2048+xi] & 0xFF;
-        GLfloat c = (texel >> 4) * (1.0f/15.0f);
-        GLfloat a = (texel & 0xF) * (1.0f/15.0f);
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = a;
-      }
-    }
-    break;
-  case 3: // 8-bit A4L4 (high byte)
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        uint16_t texel = textureRAM[yi*2048+xi] >> 8;
-        GLfloat c = (texel & 0xF) * (1.0f/15.0f);
-        GLfloat a = (texel >> 4) * (1.0f/15.0f);
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = a;
-      }
-    }
-    break;
-  case 1: // 8-bit A4L4 (low byte)
-    for (int yi = y; yi < (y+height); yi++)
-    {
-      for (int xi = x; xi < (x+width); xi++)
-      {
-        uint16_t texel = textureRAM[yi*2048+xi] & 0xFF;
-        GLfloat c = (texel & 0xF) * (1.0f/15.0f);
-        GLfloat a = (texel >> 4) * (1.0f/15.0f);
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = c;
-        textureBuffer[i++] = a;
-      }
-    }
-    break;
-  }
-    
+  // Decode
+  DecodeTexelsRGBA8(textureBuffer, textureRAM, format, x, y, width, height);
+
   // Upload texture to correct position within texture map
   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glActiveTexture(GL_TEXTURE0 + texSheet->mapNum);           // activate correct texture unit
   glBindTexture(GL_TEXTURE_2D, texMapIDs[texSheet->mapNum]); // bind correct texture map
-  glTexSubImage2D(GL_TEXTURE_2D, 0, texSheet->xOffset + x, texSheet->yOffset + y, width, height, GL_RGBA, GL_FLOAT, textureBuffer);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, texSheet->xOffset + x, texSheet->yOffset + y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, textureBuffer);
   
   // Mark texture as decoded
   texSheet->texFormat[y/32][x/32] = format;
@@ -381,10 +254,10 @@ void CLegacy3D::UploadTextures(unsigned level, unsigned x, unsigned y, unsigned
   // Make everything red
   for (int i = 0; i < 512*512; )
   {
-    textureBuffer[i++] = 1.0f;
-    textureBuffer[i++] = 0.0f;
-    textureBuffer[i++] = 0.0f;
-    textureBuffer[i++] = 1.0f;
+    textureBuffer[i++] = 255;
+    textureBuffer[i++] = 0;
+    textureBuffer[i++] = 0;
+    textureBuffer[i++] = 255;
   }
 #endif
 
@@ -1093,7 +966,7 @@ void CLegacy3D::SetStepping(int stepping)
 bool CLegacy3D::Init(unsigned xOffset, unsigned yOffset, unsigned xRes, unsigned yRes, unsigned totalXResParam, unsigned totalYResParam)
 {
   // Allocate memory for texture buffer
-  textureBuffer = new(std::nothrow) GLfloat[1024*1024*4];
+  textureBuffer = new(std::nothrow) UINT8[1024*1024*4];
   if (NULL == textureBuffer)
     return ErrorLog("Insufficient memory for texture decode buffer.");
     
@@ -1305,6 +1178,11 @@ void CLegacy3D::SetSignedShade(bool enable)
 {
 }
 
+bool CLegacy3D::GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions)
+{
+  return false;
+}
+
 CLegacy3D::CLegacy3D(const Util::Config::Node &config)
   : m_config(config)
 { 
@@ -348,6 +348,16 @@ public:
 	*/
 	void SetSignedShade(bool enable);
 
+	/*
+	* GetModelCacheStats(hitRate, residentPolys, evictions);
+	*
+	* Not supported by the legacy engine, whose model caches are not tracked.
+	*
+	* Returns:
+	*		Always false.
+	*/
+	bool GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions);
+
 	/*
 	 * CLegacy3D(void):
 	 * ~CLegacy3D(void):
@@ -516,7 +526,7 @@ private:
  	 * Textures are decoded and copied from texture RAM into this temporary buffer
  	 * before being uploaded. Dimensions are 512x512.
  	 */
-	GLfloat	*textureBuffer;	// RGBA8 format
+	UINT8	*textureBuffer;	// RGBA8 format
 };
 
 } // Legacy3D
@@ -105,6 +105,17 @@ struct Mesh
 		return true;
 	}
 
+	// true if drawing either mesh sets the same textures, uniforms and states
+	bool SameDrawState(const Mesh& m) const
+	{
+		return textured == m.textured && format == m.format && x == m.x && y == m.y && width == m.width && height == m.height
+			&& mirrorU == m.mirrorU && mirrorV == m.mirrorV && inverted == m.inverted
+			&& microTexture == m.microTexture && microTextureID == m.microTextureID && microTextureScale == m.microTextureScale
+			&& alphaTest == m.alphaTest && textureAlpha == m.textureAlpha && layered == m.layered
+			&& lighting == m.lighting && fixedShading == m.fixedShading && specular == m.specular
+			&& shininess == m.shininess && specularValue == m.specularValue && fogIntensity == m.fogIntensity;
+	}
+
 	// texture
 	int format, x, y, width, height = 0;
 	bool mirrorU = false;
@@ -136,16 +147,15 @@ struct Mesh
 	// fog
 	float fogIntensity = 1.0f;
 
+	// bounding box in model space, so the mesh can be clipped as a whole
+	float bboxMin[3]	= { 0, 0, 0 };
+	float bboxMax[3]	= { 0, 0, 0 };
+
 	// opengl resources
 	int vboOffset		= 0;			// this will be calculated later
 	int triangleCount	= 0;
 };
 
-struct SortingMesh : public Mesh		// This struct temporarily holds the model data, before it gets copied to the main buffer
-{
-	std::vector<Poly> polys;
-};
-
 struct Model
 {
 	std::shared_ptr<std::vector<Mesh>> meshes;	// this reason why this is a shared ptr to an array, is that multiple models might use the same meshes
@@ -0,0 +1,235 @@
+#include "ModelCache.h"
+#include "OSD/Logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+namespace New3D {
+
+static_assert(std::is_trivially_copyable<Mesh>::value && std::is_trivially_copyable<Poly>::value, "meshes and polys are saved as raw bytes");
+
+ModelCache::ModelCache()
+{
+	m_dirty = false;
+	Clear();
+}
+
+void ModelCache::Clear()
+{
+	memset(&m_header, 0, sizeof(m_header));
+	memcpy(m_header.magic, "R3DM", 4);
+	m_header.version	= VERSION;
+	m_header.meshSize	= sizeof(Mesh);
+	m_header.polySize	= sizeof(Poly);
+
+	m_data.clear();
+	m_index.clear();
+}
+
+bool ModelCache::Load(const std::string& path, UINT32 vromCRC)
+{
+	m_path = path;
+	m_dirty = false;
+
+	Clear();
+	m_header.vromCRC = vromCRC;
+
+	FILE* fp = fopen(path.c_str(), "rb");
+
+	if (!fp) {
+		return false;
+	}
+
+	FileHeader header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1
+		&& !memcmp(header.magic, m_header.magic, 4)
+		&& header.version == VERSION
+		&& header.vromCRC == vromCRC
+		&& header.meshSize == sizeof(Mesh)
+		&& header.polySize == sizeof(Poly);
+
+	if (ok) {
+		m_data.resize(header.dataSize);
+		ok = fread(m_data.data(), 1, m_data.size(), fp) == m_data.size();
+	}
+
+	fclose(fp);
+
+	if (ok) {
+		m_header = header;
+		ok = BuildIndex();
+	}
+
+	if (!ok) {
+		InfoLog("Ignoring model cache '%s', it is out of date or damaged.", path.c_str());
+		Clear();
+		m_header.vromCRC = vromCRC;
+		return false;
+	}
+
+	InfoLog("Loaded %u models from model cache '%s'.", (unsigned)m_index.size(), path.c_str());
+	return true;
+}
+
+bool ModelCache::BuildIndex()
+{
+	size_t pos = 0;
+
+	while (pos < m_data.size()) {
+
+		RecordHeader rh;
+
+		if (m_data.size() - pos < sizeof(rh)) {
+			return false;
+		}
+
+		memcpy(&rh, &m_data[pos], sizeof(rh));
+
+		size_t size = sizeof(rh) + (size_t)rh.numMeshes * sizeof(Mesh) + (size_t)rh.numPolys * sizeof(Poly);
+
+		if (m_data.size() - pos < size) {
+			return false;
+		}
+
+		m_index[rh.modelAddr] = pos;
+		pos += size;
+	}
+
+	return true;
+}
+
+bool ModelCache::Save()
+{
+	if (!m_dirty || m_path.empty()) {
+		return true;
+	}
+
+	FILE* fp = fopen(m_path.c_str(), "wb");
+
+	if (!fp) {
+		InfoLog("Unable to save model cache to '%s'.", m_path.c_str());
+		return false;
+	}
+
+	m_header.dataSize = (UINT32)m_data.size();
+
+	bool ok = fwrite(&m_header, sizeof(m_header), 1, fp) == 1 && fwrite(m_data.data(), 1, m_data.size(), fp) == m_data.size();
+
+	fclose(fp);
+
+	if (ok) {
+		m_dirty = false;
+	}
+
+	return ok;
+}
+
+void ModelCache::SetSettings(float vertexFactor, bool shadeIsSigned)
+{
+	if (m_header.vertexFactor == vertexFactor && m_header.shadeIsSigned == (UINT32)shadeIsSigned) {
+		return;
+	}
+
+	UINT32 vromCRC = m_header.vromCRC;
+
+	if (!m_index.empty()) {
+		m_dirty = true;		// so that the stale file is replaced
+	}
+
+	Clear();
+	m_header.vromCRC		= vromCRC;
+	m_header.vertexFactor	= vertexFactor;
+	m_header.shadeIsSigned	= shadeIsSigned;
+}
+
+bool ModelCache::Find(UINT32 modelAddr, std::vector<Mesh>& meshes, std::vector<Poly>& polys) const
+{
+	auto it = m_index.find(modelAddr);
+
+	if (it == m_index.end()) {
+		return false;
+	}
+
+	const UINT8* p = &m_data[it->second];
+
+	RecordHeader rh;
+	memcpy(&rh, p, sizeof(rh));
+	p += sizeof(rh);
+
+	size_t firstMesh = meshes.size();
+	meshes.resize(firstMesh + rh.numMeshes);
+	memcpy(&meshes[firstMesh], p, rh.numMeshes * sizeof(Mesh));
+	p += rh.numMeshes * sizeof(Mesh);
+
+	size_t firstPoly = polys.size();
+	polys.resize(firstPoly + rh.numPolys);
+	memcpy(&polys[firstPoly], p, rh.numPolys * sizeof(Poly));
+
+	return true;
+}
+
+void ModelCache::Add(UINT32 modelAddr, const std::vector<Mesh>& meshes, const std::vector<Poly>& polys)
+{
+	if (m_index.count(modelAddr)) {
+		return;
+	}
+
+	RecordHeader rh;
+	rh.modelAddr	= modelAddr;
+	rh.numMeshes	= (UINT32)meshes.size();
+	rh.numPolys		= (UINT32)polys.size();
+
+	size_t pos = m_data.size();
+	m_data.resize(pos + sizeof(rh) + meshes.size() * sizeof(Mesh) + polys.size() * sizeof(Poly));
+
+	UINT8* p = &m_data[pos];
+	memcpy(p, &rh, sizeof(rh));
+	p += sizeof(rh);
+
+	if (!meshes.empty()) {
+		memcpy(p, meshes.data(), meshes.size() * sizeof(Mesh));
+		p += meshes.size() * sizeof(Mesh);
+	}
+
+	if (!polys.empty()) {
+		memcpy(p, polys.data(), polys.size() * sizeof(Poly));
+	}
+
+	m_index[modelAddr] = pos;
+	m_dirty = true;
+}
+
+void ModelCache::GetModels(std::vector<UINT32>& models) const
+{
+	models.clear();
+
+	for (auto& it : m_index) {
+		models.push_back(it.first);
+	}
+}
+
+UINT32 ModelCache::CRC32(const void* data, size_t size)
+{
+	static UINT32 table[256];
+
+	if (!table[1]) {
+		for (UINT32 i = 0; i < 256; i++) {
+			UINT32 c = i;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+			}
+			table[i] = c;
+		}
+	}
+
+	const UINT8* p = (const UINT8*)data;
+	UINT32 crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+} // New3D
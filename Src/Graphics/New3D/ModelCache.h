@@ -0,0 +1,68 @@
+#ifndef _MODEL_CACHE_H_
+#define _MODEL_CACHE_H_
+
+#include "Types.h"
+#include "Model.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace New3D {
+
+/*
+* Decoded VROM models saved to disk, so that they don't have to be decoded
+* again when they first appear in a later session. The file is tied to the
+* VROM it was made from by its CRC, and to the decoding settings in effect.
+* Each record is the model address, the meshes (VBO offsets relative to the
+* model's first poly) and the polys.
+*/
+class ModelCache
+{
+public:
+	ModelCache();
+
+	bool	Load			(const std::string& path, UINT32 vromCRC);	// starts an empty cache if the file is missing or doesn't match
+	bool	Save			();											// only writes if models were added
+	void	SetSettings		(float vertexFactor, bool shadeIsSigned);	// throws away all models if these have changed
+	bool	Find			(UINT32 modelAddr, std::vector<Mesh>& meshes, std::vector<Poly>& polys) const;	// appends to meshes and polys
+	void	Add				(UINT32 modelAddr, const std::vector<Mesh>& meshes, const std::vector<Poly>& polys);
+	void	GetModels		(std::vector<UINT32>& models) const;
+
+	static UINT32 CRC32(const void* data, size_t size);
+
+private:
+
+	struct FileHeader
+	{
+		char	magic[4];
+		UINT32	version;
+		UINT32	vromCRC;
+		float	vertexFactor;
+		UINT32	shadeIsSigned;
+		UINT32	meshSize;		// sizeof(Mesh), sizeof(Poly) of the build that wrote the file
+		UINT32	polySize;
+		UINT32	dataSize;
+	};
+
+	struct RecordHeader
+	{
+		UINT32	modelAddr;
+		UINT32	numMeshes;
+		UINT32	numPolys;
+	};
+
+	static const UINT32 VERSION = 1;
+
+	std::string							m_path;
+	FileHeader							m_header;
+	std::vector<UINT8>					m_data;		// records, as in the file
+	std::unordered_map<UINT32, size_t>	m_index;	// model address -> record offset
+	bool								m_dirty;
+
+	void Clear();
+	bool BuildIndex();
+};
+
+} // New3D
+
+#endif
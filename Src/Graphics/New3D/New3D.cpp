@@ -7,6 +7,11 @@
 #include <string.h>
 #include "R3DFloat.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NEW3D_USE_SSE
+#endif
+
 #define MAX_RAM_POLYS 100000	
 #define MAX_ROM_POLYS 500000
 
@@ -29,10 +34,52 @@ CNew3D::CNew3D(const Util::Config::Node &config, std::string gameName)
 
 	// Fall-back mechanism for games with patched (not working) JTAG
 	if (m_gameName == "swtrilgy") m_shadeIsSigned = false;
+
+	m_frameCount				= 0;
+	m_polyBufferRamUploaded		= 0;
+	m_polyBufferRamFull			= false;
+	m_romStats					= {};
+
+	m_romAlloc.Reset(MAX_ROM_POLYS);
+
+	m_texSheet.EnableAtlas(config["TextureAtlas"].ValueAsDefault<bool>(false));
+
+	m_modelCacheEnabled	= config["ModelCache"].ValueAsDefault<bool>(false);
+	m_modelCacheLoaded	= false;
+
+	// Worker threads for decoding dynamic models, leaving cores free for the PPC and sound threads
+	m_numModelJobs		= 0;
+	m_numClipJobs		= 0;
+	m_workGeneration	= 0;
+	m_workersBusy		= 0;
+	m_workersExit		= false;
+	m_workJobs			= nullptr;
+
+	unsigned cores		= std::thread::hardware_concurrency();
+	unsigned numWorkers	= cores > 3 ? std::min(cores - 3, 3u) : 0;
+
+	for (unsigned i = 0; i < numWorkers; i++) {
+		m_workers.emplace_back(&CNew3D::WorkerThread, this);
+	}
 }
 
 CNew3D::~CNew3D()
 {
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_workersExit = true;
+	}
+
+	m_workStart.notify_all();
+
+	for (auto &worker : m_workers) {
+		worker.join();
+	}
+
+	if (m_modelCacheLoaded) {
+		m_modelCache.Save();
+	}
+
 	m_vbo.Destroy();
 }
 
@@ -86,6 +133,8 @@ bool CNew3D::Init(unsigned xOffset, unsigned yOffset, unsigned xRes, unsigned yR
 
 void CNew3D::UploadTextures(unsigned level, unsigned x, unsigned y, unsigned width, unsigned height)
 {
+	m_texSheet.InvalidateAtlas(x, y, width, height);	// any level, atlases hold the whole sheet
+
 	if (level == 0) {
 		m_texSheet.Invalidate(x, y, width, height);		// base textures only
 	} 
@@ -147,109 +196,265 @@ void CNew3D::DrawScrollFog()
 	}
 }
 
-bool CNew3D::RenderScene(int priority, bool renderOverlay, bool alpha)
+void CNew3D::BuildDrawLists()
 {
-	bool hasOverlay = false;		// (high priority polys)
+	for (int pri = 0; pri < 4; pri++) {
 
-	if (alpha) {
-		glEnable(GL_BLEND);
+		m_hasOverlay[pri] = false;
+
+		for (int overlay = 0; overlay < 2; overlay++) {
+			for (int alpha = 0; alpha < 2; alpha++) {
+				m_drawLists[pri][overlay][alpha].batches.clear();
+				m_drawLists[pri][overlay][alpha].firsts.clear();
+				m_drawLists[pri][overlay][alpha].counts.clear();
+			}
+		}
 	}
 
 	for (auto &n : m_nodes) {
 
-		if (n.viewport.priority != priority || n.models.empty()) {
-			continue;
-		}
+		int pri = n.viewport.priority;
 
-		std::shared_ptr<Texture> tex1;
+		for (auto &m : n.models) {
 
-		CalcViewport(&n.viewport, std::abs(m_nfPairs[priority].zNear*0.95f), std::abs(m_nfPairs[priority].zFar*1.05f));	// make planes 5% bigger
+			for (auto &mesh : *m.meshes) {
 
-		glViewport		(n.viewport.x, n.viewport.y, n.viewport.width, n.viewport.height);
-		glMatrixMode	(GL_PROJECTION);
-		glLoadMatrixf	(n.viewport.projectionMatrix);
-		glMatrixMode	(GL_MODELVIEW);
+				if (mesh.highPriority) {
+					m_hasOverlay[pri] = true;
+				}
 
-		m_r3dShader.SetViewportUniforms(&n.viewport);
+				for (int alpha = 0; alpha < 2; alpha++) {
 
-		for (auto &m : n.models) {
+					if (!mesh.Render(alpha != 0)) continue;
 
-			bool matrixLoaded = false;
+					DrawList& list	= m_drawLists[pri][mesh.highPriority][alpha];
+					GLint first		= mesh.vboOffset * 3;		// times 3 to convert triangles to vertices
+					GLsizei count	= mesh.triangleCount * 3;
 
-			if (m.meshes->empty()) {
-				continue;
+					if (!list.batches.empty() && list.batches.back().model == &m && list.batches.back().mesh->SameDrawState(mesh)) {
+
+						MeshBatch& batch = list.batches.back();
+
+						if (list.firsts.back() + list.counts.back() == first) {
+							list.counts.back() += count;		// meshes are next to each other in the VBO
+						}
+						else {
+							list.firsts.push_back(first);
+							list.counts.push_back(count);
+							batch.num++;
+						}
+					}
+					else {
+						list.batches.push_back({ &n, &m, &mesh, (int)list.firsts.size(), 1 });
+						list.firsts.push_back(first);
+						list.counts.push_back(count);
+					}
+				}
 			}
+		}
+	}
+}
 
-			m_r3dShader.SetModelStates(&m);
+void CNew3D::PrepareTextures()
+{
+	if (m_texSheet.AtlasEnabled()) {
+		return;		// atlases are kept up to date tile by tile
+	}
 
-			for (auto &mesh : *m.meshes) {
+	for (int pri = 0; pri < 4; pri++) {
+		for (int overlay = 0; overlay < 2; overlay++) {
+			for (int alpha = 0; alpha < 2; alpha++) {
 
-				if (mesh.highPriority) {
-					hasOverlay = true;
-				}
+				for (auto &batch : m_drawLists[pri][overlay][alpha].batches) {
 
-				if (!mesh.Render(alpha)) continue;
-				if (mesh.highPriority != renderOverlay) continue;
+					const Model&	m		= *batch.model;
+					const Mesh&		mesh	= *batch.mesh;
 
-				if (!matrixLoaded) {
-					glLoadMatrixf(m.modelMat);
-					matrixLoaded = true;		// do this here to stop loading matrices we don't need. Ie when rendering non transparent etc
-				}
-				
-				if (mesh.textured) {
+					if (!mesh.textured) {
+						continue;
+					}
 
 					int x, y;
 					CalcTexOffset(m.textureOffsetX, m.textureOffsetY, m.page, mesh.x, mesh.y, x, y);
 
-					if (tex1 && tex1->Compare(x, y, mesh.width, mesh.height, mesh.format)) {
-						tex1->SetWrapMode(mesh.mirrorU, mesh.mirrorV);	
-					}
-					else {
-						tex1 = m_texSheet.BindTexture(m_textureRAM, mesh.format, mesh.mirrorU, mesh.mirrorV, x, y, mesh.width, mesh.height);
-						if (tex1) {
-							tex1->BindTexture();
-							tex1->SetWrapMode(mesh.mirrorU, mesh.mirrorV);
-						}
-					}
+					m_texSheet.QueueTexture(mesh.format, mesh.mirrorU, mesh.mirrorV, x, y, mesh.width, mesh.height);
 
 					if (mesh.microTexture) {
-
 						int mX, mY;
-						glActiveTexture(GL_TEXTURE1);
 						m_texSheet.GetMicrotexPos(y / 1024, mesh.microTextureID, mX, mY);
-						auto tex2 = m_texSheet.BindTexture(m_textureRAM, 0, false, false, mX, mY, 128, 128);
-						if (tex2) {
-							tex2->BindTexture();
-						}
-						glActiveTexture(GL_TEXTURE0);
+						m_texSheet.QueueTexture(0, false, false, mX, mY, 128, 128);
 					}
 				}
-				
-				m_r3dShader.SetMeshUniforms(&mesh);
-				glDrawArrays(GL_TRIANGLES, mesh.vboOffset*3, mesh.triangleCount*3);			// times 3 to convert triangles to vertices
 			}
 		}
 	}
 
+	if (!m_texSheet.MapUploads()) {
+		return;
+	}
+
+	RunJobs(&CNew3D::RunTextureJobs, m_texSheet.GetUploadSize() >= 256 * 1024);
+	m_texSheet.FinishUploads();
+}
+
+void CNew3D::RenderScene(int priority, bool renderOverlay, bool alpha)
+{
+	DrawList&					list	= m_drawLists[priority][renderOverlay][alpha];
+	const Node*					node	= nullptr;
+	const Model*				model	= nullptr;
+	std::shared_ptr<Texture>	tex1;
+	GLuint						atlas1	= 0;		// bound texture sheets in atlas mode
+	GLuint						atlas2	= 0;
+
+	if (alpha) {
+		glEnable(GL_BLEND);
+	}
+
+	for (auto &batch : list.batches) {
+
+		if (batch.node != node) {
+
+			Node& n = *batch.node;
+
+			node = batch.node;
+			tex1.reset();
+
+			CalcViewport(&n.viewport, std::abs(m_nfPairs[priority].zNear*0.95f), std::abs(m_nfPairs[priority].zFar*1.05f));	// make planes 5% bigger
+
+			glViewport		(n.viewport.x, n.viewport.y, n.viewport.width, n.viewport.height);
+			glMatrixMode	(GL_PROJECTION);
+			glLoadMatrixf	(n.viewport.projectionMatrix);
+			glMatrixMode	(GL_MODELVIEW);
+
+			m_r3dShader.SetViewportUniforms(&n.viewport);
+		}
+
+		if (batch.model != model) {
+			model = batch.model;
+			m_r3dShader.SetModelStates(model);
+			glLoadMatrixf(model->modelMat);
+		}
+
+		const Model&	m		= *batch.model;
+		const Mesh&		mesh	= *batch.mesh;
+
+		if (mesh.textured) {
+
+			int x, y;
+			CalcTexOffset(m.textureOffsetX, m.textureOffsetY, m.page, mesh.x, mesh.y, x, y);
+
+			if (m_texSheet.AtlasEnabled()) {
+
+				int mX = 0, mY = 0;
+
+				GLuint sheet1 = m_texSheet.GetAtlas(m_textureRAM, mesh.format);
+				GLuint sheet2 = mesh.microTexture ? m_texSheet.GetAtlas(m_textureRAM, 0) : atlas2;
+
+				if (sheet1 != atlas1) {
+					glBindTexture(GL_TEXTURE_2D, sheet1);
+					atlas1 = sheet1;
+				}
+
+				if (sheet2 != atlas2) {
+					glActiveTexture(GL_TEXTURE1);
+					glBindTexture(GL_TEXTURE_2D, sheet2);
+					glActiveTexture(GL_TEXTURE0);
+					atlas2 = sheet2;
+				}
+
+				if (mesh.microTexture) {
+					m_texSheet.GetMicrotexPos(y / 1024, mesh.microTextureID, mX, mY);
+				}
+
+				m_r3dShader.SetAtlasPosition(x, y, &mesh, mX, mY);
+			}
+			else if (tex1 && tex1->Compare(x, y, mesh.width, mesh.height, mesh.format)) {
+				tex1->SetWrapMode(mesh.mirrorU, mesh.mirrorV);	
+			}
+			else {
+				tex1 = m_texSheet.BindTexture(m_textureRAM, mesh.format, mesh.mirrorU, mesh.mirrorV, x, y, mesh.width, mesh.height);
+				if (tex1) {
+					tex1->BindTexture();
+					tex1->SetWrapMode(mesh.mirrorU, mesh.mirrorV);
+				}
+			}
+
+			if (mesh.microTexture && !m_texSheet.AtlasEnabled()) {
+
+				int mX, mY;
+				glActiveTexture(GL_TEXTURE1);
+				m_texSheet.GetMicrotexPos(y / 1024, mesh.microTextureID, mX, mY);
+				auto tex2 = m_texSheet.BindTexture(m_textureRAM, 0, false, false, mX, mY, 128, 128);
+				if (tex2) {
+					tex2->BindTexture();
+				}
+				glActiveTexture(GL_TEXTURE0);
+			}
+		}
+		
+		m_r3dShader.SetMeshUniforms(&mesh);
+
+		if (batch.num == 1) {
+			glDrawArrays(GL_TRIANGLES, list.firsts[batch.start], list.counts[batch.start]);
+		}
+		else {
+			glMultiDrawArrays(GL_TRIANGLES, &list.firsts[batch.start], &list.counts[batch.start], batch.num);
+		}
+	}
+
 	glDisable(GL_BLEND);
+}
 
-	return hasOverlay;
+void CNew3D::FlushRamPolys()
+{
+	m_polyBufferRam.clear();
+	m_dynamicMap.clear();
+	m_polyBufferRamUploaded = 0;
 }
 
 void CNew3D::RenderFrame(void)
 {
-	for (int i = 0; i < 4; i++) {
-		m_nfPairs[i].zNear = -std::numeric_limits<float>::max();
-		m_nfPairs[i].zFar  =  std::numeric_limits<float>::max();
+	// flush the dynamic model cache once it has filled up with stale models, or if models were left out last frame
+	if (m_polyBufferRam.size() > MAX_RAM_POLYS / 2 || m_polyBufferRamFull) {
+		FlushRamPolys();
+	}
+
+	m_frameCount++;
+
+	m_romStats.hits			= 0;
+	m_romStats.misses		= 0;
+	m_romStats.evictions	= 0;
+
+	if (m_modelCacheEnabled && !m_modelCacheLoaded && m_vrom) {
+		LoadModelCache();
 	}
 
-	// release any resources from last frame
-	m_polyBufferRam.clear();		// clear dyanmic model memory buffer
-	m_nodes.clear();				// memory will grow during the object life time, that's fine, no need to shrink to fit
-	m_modelMat.Release();			// would hope we wouldn't need this but no harm in checking
-	m_nodeAttribs.Reset();
+	// if the dynamic models didn't all fit, flush the stale ones and build the frame again from scratch,
+	// as models found earlier in the frame may still be drawn from polys that were there before
+	for (int pass = 0; pass < 2; pass++) {
+
+		for (int i = 0; i < 4; i++) {
+			m_nfPairs[i].zNear = -std::numeric_limits<float>::max();
+			m_nfPairs[i].zFar  =  std::numeric_limits<float>::max();
+		}
+
+		// release any resources from last frame
+		m_nodes.clear();				// memory will grow during the object life time, that's fine, no need to shrink to fit
+		m_modelMat.Release();			// would hope we wouldn't need this but no harm in checking
+		m_nodeAttribs.Reset();
+		m_numModelJobs = 0;
+		m_numClipJobs = 0;
+		m_polyBufferRamFull = false;
 
-	RenderViewport(0x800000);						// build model structure
+		RenderViewport(0x800000);					// build model structure
+		CacheDynamicModels();						// decode the dynamic models it found
+
+		if (!m_polyBufferRamFull || pass > 0 || m_polyBufferRamUploaded == 0) {
+			break;
+		}
+
+		FlushRamPolys();
+	}
 
 	DrawScrollFog();								// fog layer if applicable must be drawn here
 
@@ -265,28 +470,29 @@ void CNew3D::RenderFrame(void)
 	glStencilMask	(0xFF);
 	
 	m_vbo.Bind(true);
-	m_vbo.BufferSubData(MAX_ROM_POLYS*sizeof(Poly), m_polyBufferRam.size()*sizeof(Poly), m_polyBufferRam.data());	// upload all the dynamic data to GPU in one go
-
-	if (m_polyBufferRom.size()) {
-
-		// sync rom memory with vbo
-		int romBytes	= (int)m_polyBufferRom.size() * sizeof(Poly);
-		int vboBytes	= m_vbo.GetSize();
-		int size		= romBytes - vboBytes;
-
-		if (size) {
-			//check we haven't blown up the memory buffers
-			//we will lose rom models for 1 frame is this happens, not the end of the world, as probably won't ever happen anyway
-			if (m_polyBufferRom.size() >= MAX_ROM_POLYS) {
-				m_polyBufferRom.clear();
-				m_romMap.clear();
-				m_vbo.Reset();
-			}
-			else {
-				m_vbo.AppendData(size, &m_polyBufferRom[vboBytes / sizeof(Poly)]);
-			}
-		}
+
+	// the appends above are bounded, but never write past the end of the VBO
+	if (m_polyBufferRam.size() > MAX_RAM_POLYS) {
+		FlushRamPolys();
+		m_nodes.clear();
+	}
+
+	// upload the dynamic models decoded this frame, the others are still in the VBO
+	if (m_polyBufferRam.size() > m_polyBufferRamUploaded) {
+		size_t count = m_polyBufferRam.size() - m_polyBufferRamUploaded;
+		m_vbo.BufferSubData((MAX_ROM_POLYS + m_polyBufferRamUploaded)*sizeof(Poly), count*sizeof(Poly), &m_polyBufferRam[m_polyBufferRamUploaded]);
+		m_polyBufferRamUploaded = m_polyBufferRam.size();
 	}
+
+	// upload the ROM models decoded this frame into their blocks
+	for (auto &block : m_romUploads) {
+		m_vbo.BufferSubData(block.first * sizeof(Poly), block.second * sizeof(Poly), &m_polyBufferRom[block.first]);
+	}
+
+	m_romUploads.clear();
+
+	m_romStats.residentModels	= (UINT32)m_romMap.size();
+	m_romStats.residentPolys	= (UINT32)m_romAlloc.used;
 	
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -305,21 +511,20 @@ void CNew3D::RenderFrame(void)
 
 	m_r3dShader.SetShader(true);
 
-	for (int pri = 0; pri <= 3; pri++) {
+	BuildDrawLists();
+	PrepareTextures();
 
-		//==============
-		bool hasOverlay;
-		//==============
+	for (int pri = 0; pri <= 3; pri++) {
 
 		glViewport	(0, 0, m_totalXRes, m_totalYRes);		// clear whole viewport
 		glClear		(GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
 
 		m_r3dShader.DiscardAlpha(true);						// chuck out alpha pixels in texture alpha only polys
-		hasOverlay = RenderScene(pri, false, false);
+		RenderScene(pri, false, false);
 		m_r3dShader.DiscardAlpha(false);
-		hasOverlay = RenderScene(pri, false, true);
+		RenderScene(pri, false, true);
 
-		if (hasOverlay) {
+		if (m_hasOverlay[pri]) {
 			//clear depth buffer and render high priority polys
 			glViewport(0, 0, m_totalXRes, m_totalYRes);		// clear whole viewport
 			glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -389,6 +594,7 @@ bool CNew3D::DrawModel(UINT32 modelAddr)
 {
 	const UINT32*	modelAddress;
 	bool			cached = false;
+	bool			decode = false;
 	Model*			m;
 
 	modelAddress = TranslateModelAddress(modelAddr);
@@ -403,20 +609,47 @@ bool CNew3D::DrawModel(UINT32 modelAddr)
 
 		// try to find meshes in the rom cache
 
-		m->meshes = m_romMap[modelAddr];	// will create an entry with a null pointer if empty
+		RomModel& rm = m_romMap[modelAddr];	// will create an entry with a null pointer if empty
+
+		rm.lastUsed = m_frameCount;
 
-		if (m->meshes) {
+		if (rm.meshes) {
 			cached = true;
+			m_romStats.hits++;
 		}
 		else {
-			m->meshes = std::make_shared<std::vector<Mesh>>();
-			m_romMap[modelAddr] = m->meshes;		// store meshes in our rom map here
+			rm.meshes = std::make_shared<std::vector<Mesh>>();	// store meshes in our rom map here
+			m_romStats.misses++;
 		}
 
-		m->dynamic = false;
+		m->meshes	= rm.meshes;
+		m->dynamic	= false;
 	}
 	else {
-		m->meshes = std::make_shared<std::vector<Mesh>>();
+
+		// look for the model in the dynamic cache, checking once a frame that it hasn't changed
+
+		DynamicModel& dm = m_dynamicMap[((UINT64)m_colorTableAddr << 32) | modelAddr];
+
+		if (dm.frame != m_frameCount) {
+
+			UINT64 hash = HashModel(modelAddress, m_colorTableAddr);
+
+			if (!dm.meshes || dm.hash != hash) {
+				dm.hash		= hash;
+				dm.meshes	= std::make_shared<std::vector<Mesh>>();
+				dm.decoded	= m_frameCount;
+				decode		= true;
+			}
+
+			dm.frame = m_frameCount;
+		}
+
+		m->meshes = dm.meshes;
+
+		if (dm.decoded != m_frameCount) {
+			cached = true;		// polys from an earlier frame are already in the VBO
+		}
 	}
 
 	// copy current model matrix
@@ -431,7 +664,42 @@ bool CNew3D::DrawModel(UINT32 modelAddr)
 	m->scale = m_nodeAttribs.currentModelScale;
 
 	if (!cached) {
-		CacheModel(m, modelAddress);
+
+		if (m->dynamic) {
+
+			// decoded later by CacheDynamicModels(), along with the clipping
+			// further instances of the model in this frame only need clipping, once it has been decoded
+			std::vector<ModelJob>&	jobs	= decode ? m_modelJobs : m_clipJobs;
+			size_t&					numJobs	= decode ? m_numModelJobs : m_numClipJobs;
+
+			if (!decode && m_nodeAttribs.currentClipStatus == Clip::INSIDE) {
+				return true;
+			}
+
+			if (numJobs == jobs.size()) {
+				jobs.emplace_back();
+			}
+
+			ModelJob& job = jobs[numJobs++];
+
+			job.data			= modelAddress;
+			job.colorTableAddr	= m_colorTableAddr;
+			job.meshes			= m->meshes;
+			job.clip			= m_nodeAttribs.currentClipStatus != Clip::INSIDE;
+			job.priority		= m_currentPriority;
+
+			for (int i = 0; i < 16; i++) {
+				job.modelMat[i] = m->modelMat[i];
+			}
+
+			for (int i = 0; i < 4; i++) {
+				job.planes[i] = m_planes[i];
+			}
+
+			return true;
+		}
+
+		CacheRomModel(modelAddr, modelAddress, m);
 	}
 
 	if (m_nodeAttribs.currentClipStatus != Clip::INSIDE) {
@@ -441,6 +709,218 @@ bool CNew3D::DrawModel(UINT32 modelAddr)
 	return true;
 }
 
+void CNew3D::CacheRomModel(UINT32 modelAddr, const UINT32 *data, Model *m)
+{
+	m_romDecode.clear();
+
+	if (m_modelCacheLoaded) {
+		m_modelCache.SetSettings(m_vertexFactor, m_shadeIsSigned);
+	}
+
+	if (!m_modelCacheLoaded || !m_modelCache.Find(modelAddr, *m->meshes, m_romDecode)) {
+
+		CacheModel(data, m_colorTableAddr, *m->meshes, m_romDecode, 0, m_romBuckets);
+
+		if (m_modelCacheLoaded) {
+			m_modelCache.Add(modelAddr, *m->meshes, m_romDecode);
+		}
+	}
+
+	int size	= (int)m_romDecode.size();
+	int offset	= AllocRomPolys(size);
+
+	if (offset >= 0) {
+
+		RomModel& rm = m_romMap[modelAddr];
+		rm.offset	= offset;
+		rm.numPolys	= size;
+
+		StoreRomPolys(offset);
+	}
+	else {
+
+		// the region is full of models drawn this frame, so draw this one from the
+		// dynamic region and decode it again next time it comes up
+
+		m_romMap.erase(modelAddr);
+
+		if (m_polyBufferRam.size() + m_romDecode.size() > MAX_RAM_POLYS) {
+			m_polyBufferRamFull = true;				// no room there either, leave it out
+			m->meshes = std::make_shared<std::vector<Mesh>>();
+			return;
+		}
+
+		offset = MAX_ROM_POLYS + (int)m_polyBufferRam.size();
+		m_polyBufferRam.insert(m_polyBufferRam.end(), m_romDecode.begin(), m_romDecode.end());
+		m->dynamic = true;
+	}
+
+	for (auto &mesh : *m->meshes) {
+		mesh.vboOffset += offset;
+	}
+}
+
+void CNew3D::StoreRomPolys(int offset)
+{
+	int size = (int)m_romDecode.size();
+
+	if ((int)m_polyBufferRom.size() < offset + size) {
+		m_polyBufferRom.resize(offset + size);
+	}
+
+	std::copy(m_romDecode.begin(), m_romDecode.end(), m_polyBufferRom.begin() + offset);
+
+	if (!m_romUploads.empty() && m_romUploads.back().first + m_romUploads.back().second == offset) {
+		m_romUploads.back().second += size;
+	}
+	else if (size) {
+		m_romUploads.emplace_back(offset, size);
+	}
+}
+
+void CNew3D::LoadModelCache()
+{
+	m_modelCacheLoaded = true;
+
+	std::string path = "NVRAM/" + m_gameName + ".models";
+
+	if (!m_modelCache.Load(path, ModelCache::CRC32(m_vrom, 0x4000000))) {
+		return;
+	}
+
+	m_modelCache.SetSettings(m_vertexFactor, m_shadeIsSigned);
+
+	// put as many of the models in the VBO as will fit, so that they are ready when first drawn
+	std::vector<UINT32> models;
+	m_modelCache.GetModels(models);
+
+	for (UINT32 modelAddr : models) {
+
+		auto meshes = std::make_shared<std::vector<Mesh>>();
+
+		m_romDecode.clear();
+		m_modelCache.Find(modelAddr, *meshes, m_romDecode);
+
+		int size	= (int)m_romDecode.size();
+		int offset	= m_romAlloc.Alloc(size);
+
+		if (offset < 0) {
+			break;
+		}
+
+		for (auto &mesh : *meshes) {
+			mesh.vboOffset += offset;
+		}
+
+		RomModel& rm = m_romMap[modelAddr];
+		rm.meshes	= meshes;
+		rm.offset	= offset;
+		rm.numPolys	= size;
+		rm.lastUsed	= 0;
+
+		StoreRomPolys(offset);
+	}
+}
+
+int CNew3D::AllocRomPolys(int size)
+{
+	int offset = m_romAlloc.Alloc(size);
+
+	if (offset >= 0) {
+		return offset;
+	}
+
+	// evict least recently used models until a block is big enough
+	std::vector<std::pair<UINT32, UINT32>> candidates;	// last used, address
+
+	for (auto &it : m_romMap) {
+		if (it.second.lastUsed != m_frameCount && it.second.offset >= 0) {
+			candidates.emplace_back(it.second.lastUsed, it.first);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+
+	for (auto &c : candidates) {
+
+		auto it = m_romMap.find(c.second);
+
+		m_romAlloc.Free(it->second.offset, it->second.numPolys);
+		m_romMap.erase(it);
+		m_romStats.evictions++;
+
+		offset = m_romAlloc.Alloc(size);
+
+		if (offset >= 0) {
+			return offset;
+		}
+	}
+
+	return -1;
+}
+
+void CNew3D::PolyAllocator::Reset(int size)
+{
+	freeBlocks.clear();
+	freeBlocks[0] = size;
+	used = 0;
+}
+
+int CNew3D::PolyAllocator::Alloc(int size)
+{
+	if (size == 0) {
+		return 0;
+	}
+
+	for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+
+		if (it->second >= size) {
+
+			int offset = it->first;
+			int remaining = it->second - size;
+
+			freeBlocks.erase(it);
+
+			if (remaining) {
+				freeBlocks[offset + size] = remaining;
+			}
+
+			used += size;
+			return offset;
+		}
+	}
+
+	return -1;
+}
+
+void CNew3D::PolyAllocator::Free(int offset, int size)
+{
+	if (size == 0) {
+		return;
+	}
+
+	used -= size;
+
+	auto next = freeBlocks.lower_bound(offset);
+
+	// merge with the following block
+	if (next != freeBlocks.end() && next->first == offset + size) {
+		size += next->second;
+		next = freeBlocks.erase(next);
+	}
+
+	// and the preceding one
+	if (next != freeBlocks.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+
+	freeBlocks[offset] = size;
+}
+
 // Descends into a 10-word culling node
 void CNew3D::DescendCullingNode(UINT32 addr)
 {
@@ -895,13 +1375,16 @@ void CNew3D::RenderViewport(UINT32 addr)
 	}
 }
 
-void CNew3D::CopyVertexData(const R3DPoly& r3dPoly, std::vector<Poly>& polyArray)
+int CNew3D::CopyVertexData(const R3DPoly& r3dPoly, Poly* polys)
 {
-	polyArray.emplace_back(Poly(true,r3dPoly));			// create object directly in array without temporary copy
+	polys[0] = Poly(true, r3dPoly);
 
 	if (r3dPoly.number == 4) {
-		polyArray.emplace_back(Poly(false, r3dPoly));	// copy second triangle
+		polys[1] = Poly(false, r3dPoly);	// copy second triangle
+		return 2;
 	}
+
+	return 1;
 }
 
 // non smooth texturing on the pro-1000 seems to sample like gl_nearest
@@ -951,7 +1434,7 @@ void CNew3D::OffsetTexCoords(R3DPoly& r3dPoly, float offset[2])
 	}
 }
 
-void CNew3D::SetMeshValues(SortingMesh *currentMesh, PolyHeader &ph)
+void CNew3D::SetMeshValues(Mesh *currentMesh, PolyHeader &ph)
 {
 	//copy attributes
 	currentMesh->doubleSided	= false;			// we will double up polys
@@ -1000,55 +1483,142 @@ void CNew3D::SetMeshValues(SortingMesh *currentMesh, PolyHeader &ph)
 	}
 }
 
-void CNew3D::CacheModel(Model *m, const UINT32 *data)
+void CNew3D::MeshBuckets::Clear()
+{
+	buckets.clear();
+	polyBucket.clear();
+
+	if (slots.empty()) {
+		slots.resize(64);
+	}
+
+	std::fill(slots.begin(), slots.end(), -1);
+}
+
+int CNew3D::MeshBuckets::Find(UINT64 hash, bool &created)
+{
+	// keep the table at most half full
+	if (buckets.size() * 2 >= slots.size()) {
+
+		slots.assign(slots.size() * 2, -1);
+
+		for (int b = 0; b < (int)buckets.size(); b++) {
+			size_t s = (size_t)((buckets[b].hash * 0x9E3779B97F4A7C15ULL) >> 32) & (slots.size() - 1);
+			while (slots[s] >= 0) {
+				s = (s + 1) & (slots.size() - 1);
+			}
+			slots[s] = b;
+		}
+	}
+
+	size_t s = (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> 32) & (slots.size() - 1);
+
+	while (slots[s] >= 0) {
+		if (buckets[slots[s]].hash == hash) {
+			created = false;
+			return slots[s];
+		}
+		s = (s + 1) & (slots.size() - 1);
+	}
+
+	slots[s] = (int)buckets.size();
+	buckets.emplace_back();
+	buckets.back().hash			= hash;
+	buckets.back().numTriangles	= 0;
+	created = true;
+
+	return slots[s];
+}
+
+// Decodes a model into meshes, appending their polys to polyBuffer. Mesh VBO offsets are relative to vboBase.
+void CNew3D::CacheModel(const UINT32 *data, UINT32 colorTableAddr, std::vector<Mesh> &meshes, std::vector<Poly> &polyBuffer, int vboBase, MeshBuckets &mb)
 {
 	Vertex			prev[4];
 	UINT16			texCoords[4][2];
 	UINT16			prevTexCoords[4][2];
 	PolyHeader		ph;
 	UINT64			lastHash	= -1;
-	SortingMesh*	currentMesh = nullptr;
-	
-	std::map<UINT64, SortingMesh> sMap;
+	Mesh*			currentMesh = nullptr;
 
 	if (data == NULL)
 		return;
 
-	ph = data; 
-	int numTriangles = ph.NumTrianglesTotal();
+	// First pass sorts the polys into meshes by their attributes and counts the triangles of each
+	mb.Clear();
+	ph = data;
 
-	// Cache all polygons
 	do {
 
-		R3DPoly		p;					// current polygon
-		float		uvScale;
-		int			i, j;
-
 		if (ph.header[6] == 0) {
 			break;
 		}
 
 		// create a hash value based on poly attributes -todo add more attributes
-		auto hash = ph.Hash();
+		bool created;
+		int b = mb.Find(ph.Hash(), created);
 
-		if (hash != lastHash) {
+		if (created) {
+			SetMeshValues(&mb.buckets[b].mesh, ph);
+		}
 
-			if (sMap.count(hash) == 0) {
+		if (!ph.Discard()) {
+			int tris = (ph.NumVerts() == 4) ? 2 : 1;
+			mb.buckets[b].numTriangles += ph.DoubleSided() ? tris * 2 : tris;
+		}
 
-				sMap[hash] = SortingMesh();
+		mb.polyBucket.push_back(b);
 
-				currentMesh = &sMap[hash];
+	} while (ph.NextPoly());
 
-				//make space for our vertices
-				currentMesh->polys.reserve(numTriangles);
+	// Lay the meshes out in the poly buffer, in hash order
+	mb.order.resize(mb.buckets.size());
 
-				//set mesh values
-				SetMeshValues(currentMesh, ph);
-			}
+	for (int b = 0; b < (int)mb.order.size(); b++) {
+		mb.order[b] = b;
+	}
+
+	std::sort(mb.order.begin(), mb.order.end(), [&mb](int a, int b) { return mb.buckets[a].hash < mb.buckets[b].hash; });
+
+	int start = (int)polyBuffer.size();
+	int total = 0;
+
+	size_t firstMesh = meshes.size();
+
+	meshes.reserve(firstMesh + mb.buckets.size());
+
+	for (int b : mb.order) {
 
-			currentMesh = &sMap[hash];
+		auto& bucket = mb.buckets[b];
+
+		bucket.mesh.vboOffset		= vboBase + start + total;
+		bucket.mesh.triangleCount	= bucket.numTriangles;
+		bucket.next					= start + total;
+		total += bucket.numTriangles;
+
+		meshes.push_back(bucket.mesh);
+	}
+
+	polyBuffer.resize(start + total);
+
+	// Second pass decodes the polys straight into their place in the buffer
+	ph = data;
+	size_t polyIndex = 0;
+
+	do {
+
+		R3DPoly		p;					// current polygon
+		float		uvScale;
+		int			i, j;
+
+		if (ph.header[6] == 0) {
+			break;
 		}
 
+		auto& bucket = mb.buckets[mb.polyBucket[polyIndex++]];
+		auto hash = bucket.hash;
+
+		currentMesh = &bucket.mesh;
+
 		// Obtain basic polygon parameters
 		p.number	= ph.NumVerts();
 		uvScale		= ph.UVScale();
@@ -1084,9 +1654,9 @@ void CNew3D::CacheModel(Model *m, const UINT32 *data)
 
 		if (!ph.PolyColor()) {
 			int colorIdx = ph.ColorIndex();
-			p.faceColour[2] = (m_polyRAM[m_colorTableAddr + colorIdx] & 0xFF);
-			p.faceColour[1] = ((m_polyRAM[m_colorTableAddr + colorIdx] >> 8) & 0xFF);
-			p.faceColour[0] = ((m_polyRAM[m_colorTableAddr + colorIdx] >> 16) & 0xFF);
+			p.faceColour[2] = (m_polyRAM[colorTableAddr + colorIdx] & 0xFF);
+			p.faceColour[1] = ((m_polyRAM[colorTableAddr + colorIdx] >> 8) & 0xFF);
+			p.faceColour[0] = ((m_polyRAM[colorTableAddr + colorIdx] >> 16) & 0xFF);
 		}
 		else {
 
@@ -1199,12 +1769,12 @@ void CNew3D::CacheModel(Model *m, const UINT32 *data)
 				V3::inverse(tempP.v[i].normal);
 			}
 
-			CopyVertexData(tempP, currentMesh->polys);
+			bucket.next += CopyVertexData(tempP, &polyBuffer[bucket.next]);
 		}
 
 		// Copy this polygon into the model buffer
 		if (!ph.Discard()) {
-			CopyVertexData(p, currentMesh->polys);
+			bucket.next += CopyVertexData(p, &polyBuffer[bucket.next]);
 		}
 		
 		// Copy current vertices into previous vertex array
@@ -1216,34 +1786,155 @@ void CNew3D::CacheModel(Model *m, const UINT32 *data)
 
 	} while (ph.NextPoly());
 
-	//sorted the data, now copy to main data structures
+	// Work out bounding boxes of the meshes
+	for (size_t i = firstMesh; i < meshes.size(); i++) {
 
-	// we know how many meshes we have so reserve appropriate space
-	m->meshes->reserve(sMap.size());
+		Mesh& mesh = meshes[i];
 
-	for (auto& it : sMap) {
+		for (int k = 0; k < 3; k++) {
+			mesh.bboxMin[k] =  std::numeric_limits<float>::max();
+			mesh.bboxMax[k] = -std::numeric_limits<float>::max();
+		}
 
-		if (m->dynamic) {
+		const Poly* polys = &polyBuffer[mesh.vboOffset - vboBase];
 
-			// calculate VBO values for current mesh
-			it.second.vboOffset		= m_polyBufferRam.size() + MAX_ROM_POLYS;
-			it.second.triangleCount = it.second.polys.size();
+		for (int j = 0; j < mesh.triangleCount; j++) {
 
-			// copy poly data to main buffer
-			m_polyBufferRam.insert(m_polyBufferRam.end(), it.second.polys.begin(), it.second.polys.end());
+			const FVertex* verts[3] = { &polys[j].p1, &polys[j].p2, &polys[j].p3 };
+
+			for (auto v : verts) {
+				for (int k = 0; k < 3; k++) {
+					mesh.bboxMin[k] = std::min(v->pos[k], mesh.bboxMin[k]);
+					mesh.bboxMax[k] = std::max(v->pos[k], mesh.bboxMax[k]);
+				}
+			}
 		}
-		else {
-			// calculate VBO values for current mesh
-			it.second.vboOffset		= m_polyBufferRom.size();
-			it.second.triangleCount = it.second.polys.size();
+	}
+}
+
+void CNew3D::CacheDynamicModels()
+{
+	if (m_numModelJobs == 0) {
+		return;
+	}
+
+	m_nextModelJob = 0;
 
-			// copy poly data to main buffer
-			m_polyBufferRom.insert(m_polyBufferRom.end(), it.second.polys.begin(), it.second.polys.end());
+	RunJobs(&CNew3D::RunModelJobs, m_numModelJobs >= 16);	// not worth waking the workers for just a few models
+
+	// merge poly buffers in traversal order
+	for (size_t i = 0; i < m_numModelJobs; i++) {
+
+		ModelJob& job = m_modelJobs[i];
+
+		if (m_polyBufferRam.size() + job.polys.size() > MAX_RAM_POLYS) {
+			m_polyBufferRamFull = true;				// leave it out, every instance shares these meshes
+			job.meshes->clear();
+			job.meshes.reset();
+			continue;
+		}
+
+		int vboBase = (int)m_polyBufferRam.size() + MAX_ROM_POLYS;
+
+		for (auto& mesh : *job.meshes) {
+			mesh.vboOffset += vboBase;
 		}
 
-		//copy the temp mesh into the model structure
-		//this will lose the associated vertex data, which is now copied to the main buffer anyway
-		m->meshes->push_back(it.second);
+		m_polyBufferRam.insert(m_polyBufferRam.end(), job.polys.begin(), job.polys.end());
+
+		if (job.clip) {
+			m_nfPairs[job.priority].zNear = std::max(job.nfPair.zNear, m_nfPairs[job.priority].zNear);
+			m_nfPairs[job.priority].zFar  = std::min(job.nfPair.zFar, m_nfPairs[job.priority].zFar);
+		}
+
+		job.meshes.reset();
+	}
+
+	for (size_t i = 0; i < m_numClipJobs; i++) {
+
+		ModelJob& job = m_clipJobs[i];
+
+		ClipMeshes(job.modelMat, *job.meshes, m_polyBufferRam, MAX_ROM_POLYS, job.planes, m_nfPairs[job.priority]);
+
+		job.meshes.reset();
+	}
+
+	m_numModelJobs = 0;
+	m_numClipJobs = 0;
+}
+
+void CNew3D::RunModelJobs()
+{
+	MeshBuckets mb;
+	size_t i;
+
+	while ((i = m_nextModelJob++) < m_numModelJobs) {
+
+		ModelJob& job = m_modelJobs[i];
+
+		job.polys.clear();
+		CacheModel(job.data, job.colorTableAddr, *job.meshes, job.polys, 0, mb);
+
+		if (job.clip) {
+			job.nfPair.zNear = -std::numeric_limits<float>::max();
+			job.nfPair.zFar  =  std::numeric_limits<float>::max();
+			ClipMeshes(job.modelMat, *job.meshes, job.polys, 0, job.planes, job.nfPair);
+		}
+	}
+}
+
+void CNew3D::RunTextureJobs()
+{
+	m_texSheet.DecodeUploads(m_textureRAM);
+}
+
+void CNew3D::RunJobs(void (CNew3D::*jobs)(), bool parallel)
+{
+	parallel = parallel && !m_workers.empty();
+
+	if (parallel) {
+		{
+			std::lock_guard<std::mutex> lock(m_workMutex);
+			m_workJobs = jobs;
+			m_workersBusy = (unsigned)m_workers.size();
+			m_workGeneration++;
+		}
+		m_workStart.notify_all();
+	}
+
+	(this->*jobs)();	// render thread takes jobs too
+
+	if (parallel) {
+		std::unique_lock<std::mutex> lock(m_workMutex);
+		m_workDone.wait(lock, [this] { return m_workersBusy == 0; });
+	}
+}
+
+void CNew3D::WorkerThread()
+{
+	unsigned generation = 0;
+
+	std::unique_lock<std::mutex> lock(m_workMutex);
+
+	while (true) {
+
+		m_workStart.wait(lock, [&] { return m_workersExit || m_workGeneration != generation; });
+
+		if (m_workersExit) {
+			return;
+		}
+
+		generation = m_workGeneration;
+
+		auto jobs = m_workJobs;
+
+		lock.unlock();
+		(this->*jobs)();
+		lock.lock();
+
+		if (--m_workersBusy == 0) {
+			m_workDone.notify_one();
+		}
 	}
 }
 
@@ -1285,6 +1976,42 @@ bool CNew3D::IsDynamicModel(UINT32 *data)
 	return false;
 }
 
+UINT64 CNew3D::HashModel(const UINT32 *data, UINT32 colorTableAddr)
+{
+	UINT64 hash = 0xCBF29CE484222325ULL;	// FNV-1a, a word at a time
+
+	if (data == NULL) {
+		return hash;
+	}
+
+	PolyHeader ph((UINT32*)data);
+
+	do {
+
+		for (int i = 0; i < 7; i++) {
+			hash = (hash ^ ph.header[i]) * 0x100000001B3ULL;
+		}
+
+		if (ph.header[6] == 0) {
+			break;
+		}
+
+		if (!ph.PolyColor()) {
+			hash = (hash ^ m_polyRAM[colorTableAddr + ph.ColorIndex()]) * 0x100000001B3ULL;
+		}
+
+		const UINT32* vData = ph.StartOfData();
+		int numWords = (ph.NumVerts() - ph.NumSharedVerts()) * 4;
+
+		for (int i = 0; i < numWords; i++) {
+			hash = (hash ^ vData[i]) * 0x100000001B3ULL;
+		}
+
+	} while (ph.NextPoly());
+
+	return hash;
+}
+
 bool CNew3D::IsVROMModel(UINT32 modelAddr)
 {
 	return modelAddr >= 0x100000;
@@ -1528,45 +2255,128 @@ void CNew3D::ClipPolygon(ClipPoly& clipPoly, Plane planes[4])
 
 void CNew3D::ClipModel(const Model *m)
 {
-	//================
-	ClipPoly clipPoly;
-	std::vector<Poly> *polys;
-	int offset;
-	//================
-
 	if (m->dynamic) {
-		polys = &m_polyBufferRam;
-		offset = MAX_ROM_POLYS;
+		ClipMeshes(m->modelMat, *m->meshes, m_polyBufferRam, MAX_ROM_POLYS, m_planes, m_nfPairs[m_currentPriority]);
 	}
 	else {
-		polys = &m_polyBufferRom;
-		offset = 0;
+		ClipMeshes(m->modelMat, *m->meshes, m_polyBufferRom, 0, m_planes, m_nfPairs[m_currentPriority]);
 	}
+}
 
-	for (const auto &mesh : *m->meshes) {
+void CNew3D::ClipMeshes(const float modelMat[16], const std::vector<Mesh>& meshes, const std::vector<Poly>& polys, int vboBase, Plane planes[4], NFPair& nfPair)
+{
+	for (const auto &mesh : meshes) {
 
-		int start = mesh.vboOffset - offset;
-		
-		for (int i = 0; i < mesh.triangleCount; i++) {
+		if (mesh.triangleCount == 0) {
+			continue;
+		}
+
+		// Clip the mesh bounding box first. Like culling nodes, a box entirely inside
+		// the frustum gives a conservative Z range without looking at the triangles.
+
+		//=======
+		BBox box;
+		//=======
+
+		for (int i = 0; i < 8; i++) {
+			box.points[i][0] = (i & 1) ? mesh.bboxMax[0] : mesh.bboxMin[0];
+			box.points[i][1] = (i & 2) ? mesh.bboxMax[1] : mesh.bboxMin[1];
+			box.points[i][2] = (i & 4) ? mesh.bboxMax[2] : mesh.bboxMin[2];
+			box.points[i][3] = 1;
+		}
+
+		TransformBox(modelMat, box);
+
+		Clip clip = ClipBox(box, planes);
+
+		if (clip == Clip::OUTSIDE) {
+			continue;
+		}
+
+		if (clip == Clip::INSIDE) {
+			for (int i = 0; i < 8; i++) {
+				if (box.points[i][2] < 0) {
+					nfPair.zNear = std::max(box.points[i][2], nfPair.zNear);
+					nfPair.zFar  = std::min(box.points[i][2], nfPair.zFar);
+				}
+			}
+			continue;
+		}
 
-			//==================================
-			Poly& poly = (*polys)[start + i];
-			//==================================
+		ClipTriangles(modelMat, &polys[mesh.vboOffset - vboBase], mesh.triangleCount, planes, nfPair);
+	}
+}
+
+// Finds the Z range of triangles after clipping. Triangles entirely inside the frustum are not clipped.
+void CNew3D::ClipTriangles(const float modelMat[16], const Poly *polys, int count, Plane planes[4], NFPair& nfPair)
+{
+	//================
+	ClipPoly clipPoly;
+	//================
+
+#ifdef NEW3D_USE_SSE
+	const __m128 m0 = _mm_loadu_ps(&modelMat[0]);
+	const __m128 m1 = _mm_loadu_ps(&modelMat[4]);
+	const __m128 m2 = _mm_loadu_ps(&modelMat[8]);
+	const __m128 m3 = _mm_loadu_ps(&modelMat[12]);
 
-			MultVec(m->modelMat, poly.p1.pos, clipPoly.list[0].pos);
-			MultVec(m->modelMat, poly.p2.pos, clipPoly.list[1].pos);
-			MultVec(m->modelMat, poly.p3.pos, clipPoly.list[2].pos);
+	// planes as structure of arrays, to test a vertex against all 4 at once
+	const __m128 pa = _mm_setr_ps(planes[0].a, planes[1].a, planes[2].a, planes[3].a);
+	const __m128 pb = _mm_setr_ps(planes[0].b, planes[1].b, planes[2].b, planes[3].b);
+	const __m128 pc = _mm_setr_ps(planes[0].c, planes[1].c, planes[2].c, planes[3].c);
+	const __m128 pd = _mm_setr_ps(planes[0].d, planes[1].d, planes[2].d, planes[3].d);
+#endif
 
-			clipPoly.count = 3;
+	for (int i = 0; i < count; i++) {
 
-			ClipPolygon(clipPoly, m_planes);
+		const float* verts[3] = { polys[i].p1.pos, polys[i].p2.pos, polys[i].p3.pos };
+		bool inside = true;
+
+		for (int j = 0; j < 3; j++) {
+
+			const float* in = verts[j];
+			float* out = clipPoly.list[j].pos;
+
+#ifdef NEW3D_USE_SSE
+			__m128 v = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(in[0]), m0),
+				_mm_mul_ps(_mm_set1_ps(in[1]), m1)),
+				_mm_mul_ps(_mm_set1_ps(in[2]), m2)),
+				_mm_mul_ps(_mm_set1_ps(in[3]), m3));
+
+			_mm_storeu_ps(out, v);
+
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(pa, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))),
+				_mm_mul_ps(pb, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)))),
+				_mm_mul_ps(pc, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)))),
+				pd);
+
+			if (_mm_movemask_ps(_mm_cmpge_ps(dist, _mm_setzero_ps())) != 0xF) {
+				inside = false;
+			}
+#else
+			MultVec(modelMat, in, out);
 
-			for (int j = 0; j < clipPoly.count; j++) {
-				if (clipPoly.list[j].pos[2] < 0) {
-					m_nfPairs[m_currentPriority].zNear = std::max(clipPoly.list[j].pos[2], m_nfPairs[m_currentPriority].zNear);
-					m_nfPairs[m_currentPriority].zFar  = std::min(clipPoly.list[j].pos[2], m_nfPairs[m_currentPriority].zFar);
+			for (int k = 0; k < 4; k++) {
+				if (!(planes[k].DistanceToPoint(out) >= 0)) {
+					inside = false;
 				}
 			}
+#endif
+		}
+
+		clipPoly.count = 3;
+
+		if (!inside) {
+			ClipPolygon(clipPoly, planes);
+		}
+
+		for (int j = 0; j < clipPoly.count; j++) {
+			if (clipPoly.list[j].pos[2] < 0) {
+				nfPair.zNear = std::max(clipPoly.list[j].pos[2], nfPair.zNear);
+				nfPair.zFar  = std::min(clipPoly.list[j].pos[2], nfPair.zFar);
+			}
 		}
 	}
 }
@@ -1636,6 +2446,21 @@ void CNew3D::SetSunClamp(bool enable)
 	m_sunClamp = enable;
 }
 
+const CNew3D::RomCacheStats& CNew3D::GetRomCacheStats(void) const
+{
+	return m_romStats;
+}
+
+bool CNew3D::GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions)
+{
+	const RomCacheStats& stats = GetRomCacheStats();
+
+	*hitRate		= stats.HitRate();
+	*residentPolys	= stats.residentPolys;
+	*evictions		= stats.evictions;
+	return true;
+}
+
 void CNew3D::SetSignedShade(bool enable)
 {
 	if (m_gameName == "swtrilgy") return;		// jtag has been patched out in star wars - todo fix this
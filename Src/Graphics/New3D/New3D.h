@@ -41,6 +41,12 @@
 #include "Vec.h"
 #include "R3DScrollFog.h"
 #include "PolyHeader.h"
+#include "ModelCache.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
 
 namespace New3D {
 
@@ -161,6 +167,42 @@ public:
 	*/
 	void SetSignedShade(bool enable);
 
+	// ROM model cache activity in the last frame rendered
+	struct RomCacheStats
+	{
+		UINT32	hits;				// instances of models found in the cache
+		UINT32	misses;				// models decoded
+		UINT32	evictions;			// models evicted to make room
+		UINT32	residentModels;
+		UINT32	residentPolys;
+
+		float HitRate() const { return (hits + misses) ? (float)hits / (hits + misses) : 1.0f; }
+	};
+
+	/*
+	* GetRomCacheStats(void);
+	*
+	* Returns:
+	*		ROM model cache statistics for the last frame rendered.
+	*/
+	const RomCacheStats& GetRomCacheStats(void) const;
+
+	/*
+	* GetModelCacheStats(hitRate, residentPolys, evictions);
+	*
+	* ROM model cache statistics for the last frame rendered, for the frame
+	* timings.
+	*
+	* Parameters:
+	*		hitRate			Set to the fraction of models found in the cache.
+	*		residentPolys	Set to the number of polys in the cache.
+	*		evictions		Set to the number of models evicted to make room.
+	*
+	* Returns:
+	*		Always true.
+	*/
+	bool GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions);
+
 	/*
 	* CRender3D(config):
 	* ~CRender3D(void):
@@ -193,15 +235,48 @@ private:
 	void DescendNodePtr(UINT32 nodeAddr);
 	void RenderViewport(UINT32 addr);
 
+	/*
+	* Scratch space used by CacheModel() to sort a model's polys into meshes
+	* (one per distinct PolyHeader::Hash()) before decoding them. It is reused
+	* from model to model so that caching doesn't allocate once it has grown.
+	*/
+	struct MeshBuckets
+	{
+		struct Bucket
+		{
+			UINT64	hash;
+			Mesh	mesh;
+			int		numTriangles;
+			int		next;			// where the next poly of this mesh goes in the poly buffer
+		};
+
+		std::vector<Bucket>	buckets;	// in order of first use
+		std::vector<int>	slots;		// open-addressed table of bucket indices, -1 if empty
+		std::vector<int>	polyBucket;	// bucket of each poly in the model
+		std::vector<int>	order;		// bucket indices sorted by hash
+
+		void	Clear();
+		int		Find(UINT64 hash, bool &created);
+	};
+
 	// building the scene
-	void SetMeshValues(SortingMesh *currentMesh, PolyHeader &ph);
-	void CacheModel(Model *m, const UINT32 *data);
-	void CopyVertexData(const R3DPoly& r3dPoly, std::vector<Poly>& polyArray);
+	void SetMeshValues(Mesh *currentMesh, PolyHeader &ph);
+	void CacheModel(const UINT32 *data, UINT32 colorTableAddr, std::vector<Mesh> &meshes, std::vector<Poly> &polyBuffer, int vboBase, MeshBuckets &mb);
+	void CacheDynamicModels();
+	void FlushRamPolys();				// empties the dynamic region and forgets the models in it
+	void RunModelJobs();
+	void RunTextureJobs();
+	void RunJobs(void (CNew3D::*jobs)(), bool parallel);	// on the render thread, and the workers too if parallel
+	void WorkerThread();
+	int  CopyVertexData(const R3DPoly& r3dPoly, Poly* polys);		// returns number of triangles written
 	void OffsetTexCoords(R3DPoly& r3dPoly, float offset[2]);
 
-	bool RenderScene(int priority, bool renderOverlay, bool alpha);		// returns if has overlay plane
+	void BuildDrawLists();
+	void PrepareTextures();		// decodes and uploads the textures the draw lists need that are missing
+	void RenderScene(int priority, bool renderOverlay, bool alpha);
 	float Determinant3x3(const float m[16]);
 	bool IsDynamicModel(UINT32 *data);				// check if the model has a colour palette
+	UINT64 HashModel(const UINT32 *data, UINT32 colorTableAddr);	// hash of everything CacheModel() reads
 	bool IsVROMModel(UINT32 modelAddr);
 	void DrawScrollFog();
 
@@ -247,8 +322,67 @@ private:
 
 	std::vector<Node> m_nodes;				// this represents the entire render frame
 	std::vector<Poly> m_polyBufferRam;		// dynamic polys
-	std::vector<Poly> m_polyBufferRom;		// rom polys
-	std::unordered_map<UINT32, std::shared_ptr<std::vector<Mesh>>> m_romMap;	// a hash table for all the ROM models. The meshes don't have model matrices or tex offsets yet
+	std::vector<Poly> m_polyBufferRom;		// copy of the ROM region of the VBO, for clipping
+	MeshBuckets m_romBuckets;				// for caching ROM models on the render thread
+
+	/*
+	* ROM models live in blocks of the first MAX_ROM_POLYS polys of the VBO,
+	* handed out first fit from a list of free blocks. When the region is full,
+	* models are evicted in order of the frame they were last drawn in, oldest
+	* first. Models drawn in the current frame are never evicted.
+	*/
+	struct PolyAllocator
+	{
+		std::map<int, int>	freeBlocks;		// offset -> size, in polys
+		int					used = 0;
+
+		void	Reset(int size);
+		int		Alloc(int size);			// returns offset, or -1 if no block is big enough
+		void	Free(int offset, int size);
+	};
+
+	struct RomModel
+	{
+		std::shared_ptr<std::vector<Mesh>> meshes;	// don't have model matrices or tex offsets yet
+		int		offset		= -1;		// in VBO
+		int		numPolys	= 0;
+		UINT32	lastUsed	= 0;		// frame last drawn in
+	};
+
+	std::unordered_map<UINT32, RomModel> m_romMap;	// a hash table for all the ROM models
+	PolyAllocator m_romAlloc;
+	std::vector<Poly> m_romDecode;					// scratch space for decoding a ROM model
+	std::vector<std::pair<int, int>> m_romUploads;	// offset and size of blocks to upload to the VBO this frame
+	RomCacheStats m_romStats;
+
+	void CacheRomModel(UINT32 modelAddr, const UINT32 *data, Model *m);
+	int  AllocRomPolys(int size);			// evicts models as needed, returns -1 if that still doesn't make room
+	void StoreRomPolys(int offset);			// copies m_romDecode to the ROM region and queues the upload
+
+	// ROM models decoded in earlier sessions, loaded on the first frame and saved on exit
+	ModelCache m_modelCache;
+	bool m_modelCacheEnabled;
+	bool m_modelCacheLoaded;
+
+	void LoadModelCache();
+
+	/*
+	* Dynamic models are kept from frame to frame, keyed by model and color
+	* table address, and only decoded again when the hash of their data changes.
+	* Their polys stay in m_polyBufferRam (and the VBO) until it is flushed.
+	*/
+	struct DynamicModel
+	{
+		UINT64 hash;
+		std::shared_ptr<std::vector<Mesh>> meshes;
+		UINT32 frame;		// frame in which the hash was last checked
+		UINT32 decoded;		// frame in which it was last decoded
+	};
+
+	std::unordered_map<UINT64, DynamicModel> m_dynamicMap;
+	UINT32 m_frameCount;
+	size_t m_polyBufferRamUploaded;		// polys at the start of m_polyBufferRam that are already in the VBO
+	bool m_polyBufferRamFull;			// polys were left out of the dynamic region this frame as they didn't fit
 
 	VBO m_vbo;								// large VBO to hold our poly data, start of VBO is ROM data, ram polys follow
 	R3DShader m_r3dShader;
@@ -270,12 +404,74 @@ private:
 	NFPair m_nfPairs[4];
 	int m_currentPriority;
 
+	/*
+	* The meshes drawn by each pass are listed once a frame, in the order they
+	* are drawn. Consecutive meshes of a model that draw with the same state
+	* are merged into one batch, submitted with a single (multi) draw call.
+	*/
+	struct MeshBatch
+	{
+		Node*			node;
+		const Model*	model;
+		const Mesh*		mesh;			// first mesh, the others have the same draw state
+		int				start;			// first range in DrawList firsts/counts
+		int				num;			// number of ranges
+	};
+
+	struct DrawList
+	{
+		std::vector<MeshBatch>	batches;
+		std::vector<GLint>		firsts;		// first vertex of each range
+		std::vector<GLsizei>	counts;		// vertices in each range
+	};
+
+	DrawList m_drawLists[4][2][2];		// priority, overlay, alpha
+	bool m_hasOverlay[4];				// priority has high priority polys
+
+	/*
+	* Dynamic models are found by the scene traversal but are decoded (and
+	* clipped to find the Z range) afterwards, as independent jobs that are
+	* shared out between the render thread and a pool of worker threads. Each
+	* job decodes into its own poly buffer and these are appended to
+	* m_polyBufferRam in traversal order, so the result is the same as decoding
+	* them one after the other.
+	*/
+	struct ModelJob
+	{
+		const UINT32 *data;
+		UINT32 colorTableAddr;
+		std::shared_ptr<std::vector<Mesh>> meshes;
+		std::vector<Poly> polys;	// vboOffsets of meshes are relative to this until merged
+		float modelMat[16];
+		Plane planes[4];
+		bool clip;
+		int priority;
+		NFPair nfPair;				// Z range of model if clipped
+	};
+
+	std::vector<ModelJob>		m_modelJobs;		// not shrunk, so that poly buffers keep their memory
+	size_t						m_numModelJobs;
+	std::atomic<size_t>			m_nextModelJob;
+	std::vector<std::thread>	m_workers;
+	std::mutex					m_workMutex;
+	std::condition_variable		m_workStart;
+	std::condition_variable		m_workDone;
+	void						(CNew3D::*m_workJobs)();	// what the workers are to run
+	unsigned					m_workGeneration;	// incremented to start workers on a frame's jobs
+	unsigned					m_workersBusy;
+	bool						m_workersExit;
+
+	std::vector<ModelJob>		m_clipJobs;			// further instances of models decoded this frame, clipped after merging
+	size_t						m_numClipJobs;
+
 	void CalcFrustumPlanes	(Plane p[4], const float* matrix);
 	void CalcBox			(float distance, BBox& box);
 	void TransformBox		(const float *m, BBox& box);
 	void MultVec			(const float matrix[16], const float in[4], float out[4]);
 	Clip ClipBox			(BBox& box, Plane planes[4]);
 	void ClipModel			(const Model *m);
+	void ClipMeshes			(const float modelMat[16], const std::vector<Mesh>& meshes, const std::vector<Poly>& polys, int vboBase, Plane planes[4], NFPair& nfPair);
+	void ClipTriangles		(const float modelMat[16], const Poly *polys, int count, Plane planes[4], NFPair& nfPair);
 	void ClipPolygon		(ClipPoly& clipPoly, Plane planes[4]);
 	void CalcBoxExtents		(const BBox& box);
 	void CalcViewport		(Viewport* vp, float near, float far);
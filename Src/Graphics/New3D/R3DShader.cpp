@@ -64,6 +64,12 @@ uniform bool	textureAlpha;
 uniform bool	alphaTest;
 uniform bool	discardAlpha;
 
+// texture atlas mode, where tex1 and tex2 are the whole texture sheet
+uniform bool	textureAtlas;
+uniform vec4	baseTexRect;		// x, y, width, height in sheet
+uniform vec2	baseTexMirror;		// 1.0 if mirrored
+uniform vec2	microTexPos;		// x, y in sheet
+
 // general
 uniform vec3	fogColour;
 uniform vec4	spotEllipse;		// spotlight ellipse position: .x=X position (screen coordinates), .y=Y position, .z=half-width, .w=half-height)
@@ -94,9 +100,63 @@ varying vec2	fsTexCoord;
 varying float	fsDiscard;
 varying float	fsFixedShade;
 
+// fetches a texel of a texture in the sheet, wrapping or mirroring the texel position
+vec4 AtlasTexel(sampler2D sheet, vec2 origin, vec2 size, vec2 mirror, vec2 texel)
+{
+	vec2 r = mod(texel, size);
+	vec2 m = mod(texel, size * 2.0);
+	vec2 w = mix(r, mix(m, size * 2.0 - 1.0 - m, step(size, m)), mirror);
+
+	return texture2D(sheet, (origin + w + 0.5) / 2048.0);
+}
+
+// bilinear sample of one mipmap level. These are stored in the sheet at fixed offsets from the base level.
+vec4 AtlasLevel(sampler2D sheet, vec4 rect, vec2 mirror, vec2 uv, float level)
+{
+	float	s		= exp2(level);
+	float	page	= floor(rect.y / 1024.0);
+	vec2	size	= max(rect.zw / s, 1.0);
+	vec2	origin	= vec2(2048.0 - 2048.0 / s + floor(rect.x / s), page * 1024.0 + 1024.0 - 1024.0 / s + floor((rect.y - page * 1024.0) / s));
+
+	vec2 t = uv * size - 0.5;
+	vec2 i = floor(t);
+	vec2 f = t - i;
+
+	vec4 a = AtlasTexel(sheet, origin, size, mirror, i);
+	vec4 b = AtlasTexel(sheet, origin, size, mirror, i + vec2(1.0, 0.0));
+	vec4 c = AtlasTexel(sheet, origin, size, mirror, i + vec2(0.0, 1.0));
+	vec4 d = AtlasTexel(sheet, origin, size, mirror, i + vec2(1.0, 1.0));
+
+	return mix(mix(a, b, f.x), mix(c, d, f.x), f.y);
+}
+
+// trilinear sample of a texture in the sheet
+vec4 AtlasTexture(sampler2D sheet, vec4 rect, vec2 mirror, vec2 uv)
+{
+	vec2	t			= uv * rect.zw;
+	float	maxLevel	= log2(min(rect.z, rect.w));
+	float	lod			= clamp(log2(max(length(dFdx(t)), length(dFdy(t)))), 0.0, maxLevel);
+	float	level		= floor(lod);
+
+	vec4 c0 = AtlasLevel(sheet, rect, mirror, uv, level);
+
+	if (lod == level) {
+		return c0;
+	}
+
+	return mix(c0, AtlasLevel(sheet, rect, mirror, uv, level + 1.0), lod - level);
+}
+
 vec4 GetTextureValue()
 {
-	vec4 tex1Data = texture2D( tex1, fsTexCoord.st);
+	vec4 tex1Data;
+
+	if (textureAtlas) {
+		tex1Data = AtlasTexture(tex1, baseTexRect, baseTexMirror, fsTexCoord.st);
+	}
+	else {
+		tex1Data = texture2D( tex1, fsTexCoord.st);
+	}
 
 	if(textureInverted) {
 		tex1Data.rgb = vec3(1.0) - vec3(tex1Data.rgb);
@@ -104,7 +164,13 @@ vec4 GetTextureValue()
 
 	if (microTexture) {
 		vec2 scale    = (baseTexSize / 128.0) * microTextureScale;
-		vec4 tex2Data = texture2D( tex2, fsTexCoord.st * scale);
+		vec4 tex2Data;
+		if (textureAtlas) {
+			tex2Data = AtlasTexture(tex2, vec4(microTexPos, 128.0, 128.0), vec2(0.0), fsTexCoord.st * scale);
+		}
+		else {
+			tex2Data = texture2D( tex2, fsTexCoord.st * scale);
+		}
 		tex1Data = (tex1Data+tex2Data)/2.0;
 	}
 
@@ -297,6 +363,7 @@ R3DShader::R3DShader(const Util::Config::Node &config)
 	m_shaderProgram		= 0;
 	m_vertexShader		= 0;
 	m_fragmentShader	= 0;
+	m_textureAtlas		= m_config["TextureAtlas"].ValueAsDefault<bool>(false);
 
 	Start();	// reset attributes
 }
@@ -320,6 +387,15 @@ void R3DShader::Start()
 	m_baseTexSize[0] = 0;
 	m_baseTexSize[1] = 0;
 
+	for (int i = 0; i < 4; i++) {
+		m_baseTexRect[i] = 0;
+	}
+
+	m_baseTexMirror[0]	= 0;
+	m_baseTexMirror[1]	= 0;
+	m_microTexPos[0]	= 0;
+	m_microTexPos[1]	= 0;
+
 	m_dirtyMesh		= true;			// dirty means all the above are dirty, ie first run
 	m_dirtyModel	= true;
 }
@@ -355,6 +431,10 @@ bool R3DShader::LoadShader(const char* vertexShader, const char* fragmentShader)
 	m_locMicroTexScale	= glGetUniformLocation(m_shaderProgram, "microTextureScale");
 	m_locBaseTexSize	= glGetUniformLocation(m_shaderProgram, "baseTexSize");
 	m_locTextureInverted= glGetUniformLocation(m_shaderProgram, "textureInverted");
+	m_locTextureAtlas	= glGetUniformLocation(m_shaderProgram, "textureAtlas");
+	m_locBaseTexRect	= glGetUniformLocation(m_shaderProgram, "baseTexRect");
+	m_locBaseTexMirror	= glGetUniformLocation(m_shaderProgram, "baseTexMirror");
+	m_locMicroTexPos	= glGetUniformLocation(m_shaderProgram, "microTexPos");
 
 	m_locFogIntensity	= glGetUniformLocation(m_shaderProgram, "fogIntensity");
 	m_locFogDensity		= glGetUniformLocation(m_shaderProgram, "fogDensity");
@@ -395,6 +475,7 @@ void R3DShader::SetShader(bool enable)
 		glUseProgram(m_shaderProgram);
 		Start();
 		DiscardAlpha(false);	// need some default
+		glUniform1i(m_locTextureAtlas, m_textureAtlas);
 	}
 	else {
 		glUseProgram(0);
@@ -521,6 +602,29 @@ void R3DShader::SetModelStates(const Model* model)
 	m_dirtyModel = false;
 }
 
+void R3DShader::SetAtlasPosition(int x, int y, const Mesh* m, int microX, int microY)
+{
+	float rect[4]	= { (float)x, (float)y, (float)m->width, (float)m->height };
+	float mirror[2]	= { m->mirrorU ? 1.0f : 0.0f, m->mirrorV ? 1.0f : 0.0f };
+
+	if (m_dirtyMesh || memcmp(rect, m_baseTexRect, sizeof(rect))) {
+		glUniform4fv(m_locBaseTexRect, 1, rect);
+		memcpy(m_baseTexRect, rect, sizeof(rect));
+	}
+
+	if (m_dirtyMesh || mirror[0] != m_baseTexMirror[0] || mirror[1] != m_baseTexMirror[1]) {
+		glUniform2fv(m_locBaseTexMirror, 1, mirror);
+		m_baseTexMirror[0] = mirror[0];
+		m_baseTexMirror[1] = mirror[1];
+	}
+
+	if (m_dirtyMesh || (m->microTexture && (m_microTexPos[0] != microX || m_microTexPos[1] != microY))) {
+		m_microTexPos[0] = (float)microX;
+		m_microTexPos[1] = (float)microY;
+		glUniform2fv(m_locMicroTexPos, 1, m_microTexPos);
+	}
+}
+
 void R3DShader::DiscardAlpha(bool discard)
 {
 	glUniform1i(m_locDiscardAlpha, discard);
@@ -20,11 +20,13 @@ public:
 	void	SetShader			(bool enable = true);
 	GLint	GetVertexAttribPos	(const char* attrib);
 	void	DiscardAlpha		(bool discard);				// use to remove alpha from texture alpha only polys for 1st pass
+	void	SetAtlasPosition	(int x, int y, const Mesh* m, int microX, int microY);	// texture position in sheet, atlas mode only. Call before SetMeshUniforms
 
 private:
 
 	// run-time config
 	const Util::Config::Node &m_config;
+	bool m_textureAtlas;		// textures are sampled from the whole texture sheet
 
 	// shader IDs
 	GLuint m_shaderProgram;
@@ -41,6 +43,10 @@ private:
 	GLint m_locMicroTexScale;
 	GLint m_locBaseTexSize;
 	GLint m_locTextureInverted;
+	GLint m_locTextureAtlas;
+	GLint m_locBaseTexRect;
+	GLint m_locBaseTexMirror;
+	GLint m_locMicroTexPos;
 
 	// cached mesh values
 	bool	m_textured1;
@@ -58,6 +64,9 @@ private:
 	float	m_microTexScale;
 	float	m_baseTexSize[2];
 	bool	m_textureInverted;
+	float	m_baseTexRect[4];
+	float	m_baseTexMirror[2];
+	float	m_microTexPos[2];
 	
 	// cached model values
 	float	m_modelScale;
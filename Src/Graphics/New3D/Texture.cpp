@@ -1,4 +1,5 @@
 #include "Texture.h"
+#include "Graphics/TextureDecode.h"
 #include <stdio.h>
 #include <math.h>
 #include <algorithm>
@@ -65,255 +66,62 @@ void Texture::SetWrapMode(bool mirrorU, bool mirrorV)
 	}
 }
 
-void Texture::UploadTextureMip(int level, const UINT16* src, UINT8* scratch, int format, int x, int y, int width, int height)
+int Texture::GetMipLevels(int x, int y, int width, int height, MipLevel levels[MAX_MIP_LEVELS])
 {
-	int		xi, yi, i;
-	int		subWidth, subHeight;
-	GLubyte	texel;
-	GLubyte	c, a;
-	
-	i = 0;
-
-	subWidth = width;
-	subHeight = height;
-
-	if (subWidth + x > 2048) {
-		subWidth = 2048 - x;
-	}
+	const int mipXBase[] = { 0, 1024, 1536, 1792, 1920, 1984, 2016, 2032, 2040, 2044, 2046, 2047 };
+	const int mipYBase[] = { 0, 512, 768, 896, 960, 992, 1008, 1016, 1020, 1022, 1023 };
+	const int mipDivisor[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
 
-	if (subHeight + y > 2048) {
-		subHeight = 2048 - y;
-	}
+	int page = y / 1024;
+
+	y -= (page * 1024);	// remove page from tex y
 
-	switch (format)
-	{
-	default:	// Debug texture
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				scratch[i++] = 255;	// R
-				scratch[i++] = 0;	// G
-				scratch[i++] = 0;	// B
-				scratch[i++] = 255;	// A
-			}
-		}
-		break;
-
-	case 0:	// T1RGB5 <- correct
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				scratch[i++] = ((src[yi * 2048 + xi] >> 10) & 0x1F) * 255 / 0x1F;	// R
-				scratch[i++] = ((src[yi * 2048 + xi] >> 5) & 0x1F) * 255 / 0x1F;	// G
-				scratch[i++] = ((src[yi * 2048 + xi] >> 0) & 0x1F) * 255 / 0x1F;	// B
-				scratch[i++] = ((src[yi * 2048 + xi] & 0x8000) ? 0 : 255);			// T
-			}
-		}
-		break;
-
-	case 1:	// Interleaved A4L4 (low byte)
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				// Interpret as A4L4
-				texel = src[yi * 2048 + xi] & 0xFF;
-				c = (texel & 0xF) * 17;
-				a = (texel >> 4) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = a;
-			}
-		}
-		break;
-
-	case 2:	// luminance alpha texture <- this one is correct
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] & 0xFF;
-				c = ((texel >> 4) & 0xF) * 17;
-				a = (texel & 0xF) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = a;
-			}
-		}
-		break;
-
-	case 3:	// 8-bit, A4L4 (high byte)
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] >> 8;
-				c = (texel & 0xF) * 17;
-				a = (texel >> 4) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = a;
-			}
-		}
-		break;
-
-	case 4: // 8-bit, L4A4 (high byte)
-
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] >> 8;
-				c = ((texel >> 4) & 0xF) * 17;
-				a = (texel & 0xF) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = a;
-			}
-		}
-		break;
-
-	case 5:	// 8-bit grayscale
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] & 0xFF;
-				scratch[i++] = texel;
-				scratch[i++] = texel;
-				scratch[i++] = texel;
-				scratch[i++] = (texel == 255 ? 0 : 255);
-			}
-		}
-		break;
-
-	case 6:	// 8-bit grayscale <-- this one is correct
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] >> 8;
-				scratch[i++] = texel;
-				scratch[i++] = texel;
-				scratch[i++] = texel;
-				scratch[i++] = (texel == 255 ? 0 : 255);
-			}
-		}
-		break;
-
-	case 7:	// RGBA4
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				scratch[i++] = ((src[yi * 2048 + xi] >> 12) & 0xF) * 17;// R
-				scratch[i++] = ((src[yi * 2048 + xi] >> 8) & 0xF) * 17;	// G
-				scratch[i++] = ((src[yi * 2048 + xi] >> 4) & 0xF) * 17;	// B
-				scratch[i++] = ((src[yi * 2048 + xi] >> 0) & 0xF) * 17;	// A
-			}
-		}
-		break;
-
-		//
-		// 4 bit texture types - all luminance textures (no alpha), only seem to be enabled when contour is enabled ( white = contour value )
-		//
-
-	case 8: // low byte, low nibble
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] & 0xFF;
-				c = (texel & 0xF) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = (c == 255 ? 0 : 255);
-			}
-		}
-		break;
-
-	case 9:	// low byte, high nibble
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] & 0xFF;
-				c = ((texel >> 4) & 0xF) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = (c == 255 ? 0 : 255);
-			}
-		}
-		break;
-
-	case 10:	// high byte, low nibble
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] >> 8;
-				c = (texel & 0xF) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = (c == 255 ? 0 : 255);
-			}
-		}
-		break;
-
-	case 11: // high byte, high nibble
-
-		for (yi = y; yi < (y + subHeight); yi++)
-		{
-			for (xi = x; xi < (x + subWidth); xi++)
-			{
-				texel = src[yi * 2048 + xi] >> 8;
-				c = ((texel >> 4) & 0xF) * 17;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = c;
-				scratch[i++] = (c == 255 ? 0 : 255);
-			}
-		}
-		break;
+	int count = 0;
+
+	for (int i = 0; width > 0 && height > 0 && i < MAX_MIP_LEVELS; i++) {
+
+		MipLevel& mip = levels[count++];
+
+		mip.x			= mipXBase[i] + (x / mipDivisor[i]);
+		mip.y			= mipYBase[i] + (y / mipDivisor[i]) + (page * 1024);
+		mip.width		= width;
+		mip.height		= height;
+		mip.subWidth	= std::min(width, 2048 - mip.x);
+		mip.subHeight	= std::min(height, 2048 - mip.y);
+
+		width /= 2;
+		height /= 2;
 	}
 
-	glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, subWidth, subHeight, GL_RGBA, GL_UNSIGNED_BYTE, scratch);
+	return count;
 }
 
 UINT32 Texture::UploadTexture(const UINT16* src, UINT8* scratch, int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height)
 {
-	const int mipXBase[] = { 0, 1024, 1536, 1792, 1920, 1984, 2016, 2032, 2040, 2044, 2046, 2047 };
-	const int mipYBase[] = { 0, 512, 768, 896, 960, 992, 1008, 1016, 1020, 1022, 1023 };
-	const int mipDivisor[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
-
 	if (!src || !scratch) {
 		return 0;		// sanity checking
 	}
 
-	DeleteTexture();	// free any existing texture
-	CreateTextureObject(format, mirrorU, mirrorV, x, y, width, height);
+	MipLevel levels[MAX_MIP_LEVELS];
+	int count = GetMipLevels(x, y, width, height, levels);
 
-	int page = y / 1024;
+	CreateTexture(format, mirrorU, mirrorV, x, y, width, height);
 
-	y -= (page * 1024);	// remove page from tex y
-
-	for (int i = 0; width > 0 && height > 0; i++) {
+	for (int i = 0; i < count; i++) {
+		DecodeTexelsRGBA8(scratch, src, format, levels[i].x, levels[i].y, levels[i].subWidth, levels[i].subHeight);
+		glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, levels[i].subWidth, levels[i].subHeight, GL_RGBA, GL_UNSIGNED_BYTE, scratch);
+	}
 
-		int xPos = mipXBase[i] + (x / mipDivisor[i]);
-		int yPos = mipYBase[i] + (y / mipDivisor[i]);
+	return m_textureID;
+}
 
-		UploadTextureMip(i, src, scratch, format, xPos, yPos + (page * 1024), width, height);
+UINT32 Texture::CreateTexture(int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height)
+{
+	DeleteTexture();	// free any existing texture
+	CreateTextureObject(format, mirrorU, mirrorV, x, y, width, height);
 
+	for (int i = 0; width > 0 && height > 0 && i < MAX_MIP_LEVELS; i++) {
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 		width /= 2;
 		height /= 2;
 	}
@@ -10,10 +10,21 @@ class Texture
 {
 public:
 
+	static const int MAX_MIP_LEVELS = 11;
+
+	// where a mipmap level comes from in texture RAM
+	struct MipLevel
+	{
+		int x, y;						// position in texture RAM
+		int width, height;				// size of level
+		int subWidth, subHeight;		// part of level inside texture RAM
+	};
+
 	Texture();
 	~Texture();
 
 	UINT32	UploadTexture	(const UINT16* src, UINT8* scratch, int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height);
+	UINT32	CreateTexture	(int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height);	// levels are allocated but not filled in
 	void	DeleteTexture	();
 	void	BindTexture		();
 	void	GetCoordinates	(UINT16 uIn, UINT16 vIn, float uvScale, float& uOut, float& vOut);
@@ -23,11 +34,11 @@ public:
 	bool	CheckMapPos		(int ax1, int ax2, int ay1, int ay2);				//check to see if textures overlap
 
 	static void GetCoordinates(int width, int height, UINT16 uIn, UINT16 vIn, float uvScale, float& uOut, float& vOut);
+	static int	GetMipLevels(int x, int y, int width, int height, MipLevel levels[MAX_MIP_LEVELS]);		// returns number of levels
 
 private:
 
 	void CreateTextureObject(int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height);
-	void UploadTextureMip(int level, const UINT16* src, UINT8* scratch, int format, int x, int y, int width, int height);
 	void Reset();
 
 	int m_x;
@@ -1,10 +1,31 @@
 #include "TextureSheet.h"
+#include "Graphics/TextureDecode.h"
+#include <algorithm>
 
 namespace New3D {
 
 TextureSheet::TextureSheet()
 {
 	m_temp.resize(1024 * 1024 * 4);	// temporay buffer for textures
+	m_atlasEnabled = false;
+
+	m_pixelBuffersSupported	= -1;
+	m_currentPixelBuffer	= 0;
+	m_uploadMapped			= false;
+	m_uploadPtr				= nullptr;
+	m_uploadSize			= 0;
+	m_nextUploadJob			= 0;
+}
+
+TextureSheet::~TextureSheet()
+{
+	for (auto &atlas : m_atlas) {
+		if (atlas.texID) {
+			glDeleteTextures(1, &atlas.texID);
+		}
+	}
+
+	DeletePixelBuffers();
 }
 
 int TextureSheet::ToIndex(int x, int y)
@@ -12,12 +33,26 @@ int TextureSheet::ToIndex(int x, int y)
 	return (y * 2048) + x;
 }
 
-std::shared_ptr<Texture> TextureSheet::BindTexture(const UINT16* src, int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height)
+std::shared_ptr<Texture> TextureSheet::FindTexture(int index, int format, int width, int height)
 {
-	//========
-	int	index;
-	//========
+	auto range = m_texMap.equal_range(index);
+
+	for (auto it = range.first; it != range.second; ++it) {
 
+		int x2, y2, width2, height2, format2;
+
+		it->second->GetDetails(x2, y2, width2, height2, format2);
+
+		if (width == width2 && height == height2 && format == format2) {
+			return it->second;
+		}
+	}
+
+	return nullptr;
+}
+
+std::shared_ptr<Texture> TextureSheet::BindTexture(const UINT16* src, int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height)
+{
 	x &= 2047;
 	y &= 2047;
 
@@ -25,46 +60,300 @@ std::shared_ptr<Texture> TextureSheet::BindTexture(const UINT16* src, int format
 		return nullptr;
 	}
 
-	index = ToIndex(x, y);
+	int index = ToIndex(x, y);
 
-	auto range = m_texMap.equal_range(index);
+	auto found = FindTexture(index, format, width, height);
 
-	if (range.first == range.second) {	
+	if (found) {
+		return found;
+	}
 
-		// nothing found so create a new texture 
+	// nothing found so create a new texture
+
+	std::shared_ptr<Texture> t(new Texture());
+	m_texMap.insert(std::pair<int, std::shared_ptr<Texture>>(index, t));
+	t->UploadTexture(src, m_temp.data(), format, mirrorU, mirrorV, x, y, width, height);
+	return t;
+}
+
+bool TextureSheet::QueueTexture(int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height)
+{
+	x &= 2047;
+	y &= 2047;
 
-		std::shared_ptr<Texture> t(new Texture());
-		m_texMap.insert(std::pair<int, std::shared_ptr<Texture>>(index, t));
-		t->UploadTexture(src, m_temp.data(), format, mirrorU, mirrorV, x, y, width, height);
-		return t;
+	if (width > 1024 || height > 1024) {
+		return false;
+	}
+
+	int index = ToIndex(x, y);
+
+	if (FindTexture(index, format, width, height)) {
+		return false;
 	}
-	else {
 
-		// iterate to try and find a match
+	Texture::MipLevel levels[Texture::MAX_MIP_LEVELS];
+	int count = Texture::GetMipLevels(x, y, width, height, levels);
 
-		for (auto it = range.first; it != range.second; ++it) {
+	size_t size = 0;
+	for (int i = 0; i < count; i++) {
+		size += levels[i].subWidth * levels[i].subHeight * 4;
+	}
 
-			int x2, y2, width2, height2, format2;
+	if (m_uploadSize + size > MAX_UPLOAD_SIZE) {
+		return false;
+	}
 
-			it->second->GetDetails(x2, y2, width2, height2, format2);
+	std::shared_ptr<Texture> t(new Texture());
+	m_texMap.insert(std::pair<int, std::shared_ptr<Texture>>(index, t));
+	t->CreateTexture(format, mirrorU, mirrorV, x, y, width, height);
 
-			if (width == width2 && height == height2 && format == format2) {
-				return it->second;
-			}
+	for (int i = 0; i < count; i++) {
+		m_uploadJobs.push_back({ t, i, format, levels[i], m_uploadSize });
+		m_uploadSize += levels[i].subWidth * levels[i].subHeight * 4;
+	}
+
+	return true;
+}
+
+bool TextureSheet::MapUploads()
+{
+	if (m_uploadJobs.empty()) {
+		return false;
+	}
+
+	if (m_pixelBuffersSupported < 0) {
+		m_pixelBuffersSupported = GLEW_VERSION_2_1 && (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range) && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+	}
+
+	m_nextUploadJob	= 0;
+	m_uploadMapped	= false;
+
+	if (m_pixelBuffersSupported) {
+
+		PixelBuffer& pb = m_pixelBuffers[m_currentPixelBuffer];
+
+		if (pb.fence) {
+			// normally signalled long ago, the buffer was last used NUM_PIXEL_BUFFERS frames back
+			while (glClientWaitSync(pb.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+			glDeleteSync(pb.fence);
+			pb.fence = 0;
+		}
+
+		if (!pb.bufferID) {
+			glGenBuffers(1, &pb.bufferID);
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pb.bufferID);
+
+		if (pb.size < m_uploadSize) {
+			pb.size = std::max(m_uploadSize, (size_t)4 * 1024 * 1024);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, pb.size, nullptr, GL_STREAM_DRAW);
 		}
 
-		// nothing found so create a new entry
+		m_uploadPtr = (UINT8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_uploadSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		m_uploadMapped = (m_uploadPtr != nullptr);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	if (!m_uploadMapped) {
+		if (m_uploadTemp.size() < m_uploadSize) {
+			m_uploadTemp.resize(m_uploadSize);
+		}
+		m_uploadPtr = m_uploadTemp.data();
+	}
+
+	return true;
+}
+
+void TextureSheet::DecodeUploads(const UINT16* src)
+{
+	size_t i;
+
+	while ((i = m_nextUploadJob++) < m_uploadJobs.size()) {
+		const UploadJob& job = m_uploadJobs[i];
+		DecodeTexelsRGBA8(m_uploadPtr + job.offset, src, job.format, job.mip.x, job.mip.y, job.mip.subWidth, job.mip.subHeight);
+	}
+}
+
+void TextureSheet::FinishUploads()
+{
+	const UINT8* base = m_uploadPtr;
+
+	if (m_uploadMapped) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[m_currentPixelBuffer].bufferID);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		base = nullptr;		// offsets into the bound buffer
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	for (const auto& job : m_uploadJobs) {
+		job.texture->BindTexture();
+		glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, 0, job.mip.subWidth, job.mip.subHeight, GL_RGBA, GL_UNSIGNED_BYTE, base + job.offset);
+	}
 
-		std::shared_ptr<Texture> t(new Texture());
-		m_texMap.insert(std::pair<int, std::shared_ptr<Texture>>(index, t));
-		t->UploadTexture(src, m_temp.data(), format, mirrorU, mirrorV, x, y, width, height);
-		return t;
+	if (m_uploadMapped) {
+		PixelBuffer& pb = m_pixelBuffers[m_currentPixelBuffer];
+		pb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		m_currentPixelBuffer = (m_currentPixelBuffer + 1) % NUM_PIXEL_BUFFERS;
+	}
+
+	m_uploadJobs.clear();
+	m_uploadSize	= 0;
+	m_uploadPtr		= nullptr;
+	m_uploadMapped	= false;
+}
+
+size_t TextureSheet::GetUploadSize() const
+{
+	return m_uploadSize;
+}
+
+void TextureSheet::DeletePixelBuffers()
+{
+	for (auto& pb : m_pixelBuffers) {
+		if (pb.fence) {
+			glDeleteSync(pb.fence);
+		}
+		if (pb.bufferID) {
+			glDeleteBuffers(1, &pb.bufferID);
+		}
+		pb = PixelBuffer();
 	}
 }
 
 void TextureSheet::Release()
 {
 	m_texMap.clear();
+	m_uploadJobs.clear();
+	m_uploadSize = 0;
+
+	for (auto &atlas : m_atlas) {
+		if (atlas.texID) {
+			glDeleteTextures(1, &atlas.texID);
+			atlas.texID = 0;
+		}
+	}
+}
+
+void TextureSheet::EnableAtlas(bool enable)
+{
+	m_atlasEnabled = enable;
+}
+
+bool TextureSheet::AtlasEnabled() const
+{
+	return m_atlasEnabled;
+}
+
+GLuint TextureSheet::GetAtlas(const UINT16* src, int format)
+{
+	if (format < 0 || format >= NUM_FORMATS || !src) {
+		return 0;
+	}
+
+	Atlas& atlas = m_atlas[format];
+
+	if (atlas.texID && !atlas.dirty) {
+		return atlas.texID;
+	}
+
+	// we get called while rendering, so leave the bound texture as it was
+	GLint boundTexture;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+
+	if (!atlas.texID) {
+
+		glGenTextures(1, &atlas.texID);
+		glBindTexture(GL_TEXTURE_2D, atlas.texID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);		// filtering and wrapping is done by the shader
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2048, 2048, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		for (auto &row : atlas.tiles) {
+			row = ~0ULL;
+		}
+	}
+	else {
+		glBindTexture(GL_TEXTURE_2D, atlas.texID);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// decode runs of dirty tiles, up to 16 rows of tiles at a time to fit the temp buffer
+	for (int row = 0; row < 64; row++) {
+
+		UINT64 bits = atlas.tiles[row];
+		atlas.tiles[row] = 0;
+
+		while (bits) {
+
+			int start = 0;
+			while (!(bits & (1ULL << start))) start++;
+
+			int end = start;
+			while (end < 64 && (bits & (1ULL << end))) end++;
+
+			int rows = 1;
+			UINT64 run = (end == 64 ? ~0ULL : ((1ULL << end) - 1)) & ~((1ULL << start) - 1);
+
+			while (rows < 16 && row + rows < 64 && (atlas.tiles[row + rows] & run) == run) {
+				atlas.tiles[row + rows] &= ~run;
+				rows++;
+			}
+
+			int x		= start * 32;
+			int y		= row * 32;
+			int width	= (end - start) * 32;
+			int height	= rows * 32;
+
+			DecodeTexelsRGBA8(m_temp.data(), src, format, x, y, width, height);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, m_temp.data());
+
+			bits &= ~run;
+		}
+	}
+
+	atlas.dirty = false;
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+
+	return atlas.texID;
+}
+
+void TextureSheet::InvalidateAtlas(int x, int y, int width, int height)
+{
+	int x1 = std::max(x, 0) / 32;
+	int y1 = std::max(y, 0) / 32;
+	int x2 = std::min(x + width, 2048) - 1;
+	int y2 = std::min(y + height, 2048) - 1;
+
+	if (x2 < 0 || y2 < 0) {
+		return;
+	}
+
+	x2 /= 32;
+	y2 /= 32;
+
+	UINT64 bits = (x2 == 63 ? ~0ULL : ((1ULL << (x2 + 1)) - 1)) & ~((1ULL << x1) - 1);
+
+	for (auto &atlas : m_atlas) {
+
+		if (!atlas.texID) {
+			continue;		// will be decoded in full when created
+		}
+
+		for (int row = y1; row <= y2; row++) {
+			atlas.tiles[row] |= bits;
+		}
+
+		atlas.dirty = true;
+	}
 }
 
 void TextureSheet::Invalidate(int x, int y, int width, int height)
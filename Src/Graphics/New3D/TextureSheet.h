@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <atomic>
 #include "Texture.h"
 
 namespace New3D {
@@ -13,6 +14,7 @@ class TextureSheet
 {
 public:
 	TextureSheet();
+	~TextureSheet();
 
 	std::shared_ptr<Texture>	BindTexture		(const UINT16* src, int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height);
 	void						Invalidate		(int x, int y, int width, int height); // release parts of the memory
@@ -20,8 +22,77 @@ public:
 	int							GetTexFormat	(int originalFormat, bool contour);
 	void						GetMicrotexPos	(int basePage, int id, int& x, int& y);
 
+	// Atlas mode, where the shader samples textures straight from a copy of the whole texture sheet
+	void						EnableAtlas		(bool enable);
+	bool						AtlasEnabled	() const;
+	GLuint						GetAtlas		(const UINT16* src, int format);			// decodes any invalidated tiles first
+	void						InvalidateAtlas	(int x, int y, int width, int height);	// texture RAM has been written
+
+	// Uploads ahead of drawing. Queued textures are created straight away, then decoded into a pixel buffer (which
+	// several threads may do at once) and uploaded together, so that BindTexture finds them ready.
+	bool						QueueTexture	(int format, bool mirrorU, bool mirrorV, int x, int y, int width, int height);	// false if already there or no room
+	bool						MapUploads		();							// false if nothing is queued
+	void						DecodeUploads	(const UINT16* src);		// thread safe, returns once all levels have been taken
+	void						FinishUploads	();
+	size_t						GetUploadSize	() const;
+
 private:
 
+	/*
+	* An atlas is the whole 2048x2048 texture sheet (both pages, mipmaps
+	* included) decoded in one format. They are created as formats get used and
+	* updated in 32x32 tiles as texture RAM is written.
+	*/
+	struct Atlas
+	{
+		GLuint	texID = 0;
+		bool	dirty = false;		// any tiles to update
+		UINT64	tiles[64];			// dirty tile bits, a row of 64 tiles per word
+	};
+
+	static const int NUM_FORMATS = 12;
+
+	bool	m_atlasEnabled;
+	Atlas	m_atlas[NUM_FORMATS];
+
+	/*
+	* Queued texture levels are decoded into one of a ring of pixel buffers,
+	* mapped unsynchronized. A fence placed after the uploads from a buffer
+	* tells us the GPU is done with it before it comes round again. Without
+	* pixel buffer support, levels are decoded into m_uploadTemp instead.
+	*/
+	struct UploadJob
+	{
+		std::shared_ptr<Texture>	texture;
+		int							level;
+		int							format;
+		Texture::MipLevel			mip;
+		size_t						offset;		// into the upload buffer
+	};
+
+	struct PixelBuffer
+	{
+		GLuint	bufferID = 0;
+		size_t	size = 0;
+		GLsync	fence = 0;
+	};
+
+	static const int	NUM_PIXEL_BUFFERS	= 3;
+	static const size_t	MAX_UPLOAD_SIZE		= 32 * 1024 * 1024;	// per frame, anything more is decoded by BindTexture
+
+	int						m_pixelBuffersSupported;		// -1 until checked
+	PixelBuffer				m_pixelBuffers[NUM_PIXEL_BUFFERS];
+	int						m_currentPixelBuffer;
+	bool					m_uploadMapped;
+	UINT8*					m_uploadPtr;
+	std::vector<UINT8>		m_uploadTemp;
+	std::vector<UploadJob>	m_uploadJobs;
+	size_t					m_uploadSize;
+	std::atomic<size_t>		m_nextUploadJob;
+
+	std::shared_ptr<Texture> FindTexture(int index, int format, int width, int height);
+	void DeletePixelBuffers();
+
 	int ToIndex(int x, int y);
 	void CropTile(int oldX, int oldY, int &newX, int &newY, int &newWidth, int &newHeight);
 
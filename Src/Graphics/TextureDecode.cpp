@@ -0,0 +1,231 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * TextureDecode.cpp
+ *
+ * Conversion of Real3D texture RAM to 8-bit RGBA.
+ *
+ * Every texel is written as 4 bytes, R first, regardless of host byte order.
+ * The 8-bit formats (and the 4-bit formats derived from them) have only 256
+ * possible inputs, so each has a table holding the finished RGBA word. The
+ * 16-bit formats are expanded channel by channel: 5-bit channels to
+ * v*255/31 (rounded down, as the new engine always did) and 4-bit channels to
+ * v*17. With SSE2, 8 texels are converted at a time; otherwise 5-bit
+ * channels go through a 32-entry table.
+ */
+
+#include "TextureDecode.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTUREDECODE_USE_SSE2
+#endif
+
+
+/******************************************************************************
+ Lookup Tables
+******************************************************************************/
+
+namespace
+{
+	struct DecodeTables
+	{
+		UINT32	byteFormat[12][256];	// RGBA words for formats with 8-bit input
+		UINT8	expand5[32];			// 5-bit channel -> 8-bit
+
+		DecodeTables()
+		{
+			for (int v = 0; v < 32; v++)
+				expand5[v] = (UINT8) (v * 255 / 31);
+
+			memset(byteFormat, 0, sizeof(byteFormat));
+			for (int t = 0; t < 256; t++)
+			{
+				UINT8 lo = t & 0xF;
+				UINT8 hi = t >> 4;
+
+				// A4L4: luminance in low nibble
+				byteFormat[1][t] = byteFormat[3][t] = Pack(lo * 17, hi * 17);
+
+				// L4A4: luminance in high nibble
+				byteFormat[2][t] = byteFormat[4][t] = Pack(hi * 17, lo * 17);
+
+				// 8-bit grayscale, 0xFF is transparent
+				byteFormat[5][t] = byteFormat[6][t] = Pack(t, t == 0xFF ? 0 : 255);
+
+				// 4-bit contour formats, 0xF is transparent
+				byteFormat[8][t] = byteFormat[10][t] = Pack(lo * 17, lo == 0xF ? 0 : 255);
+				byteFormat[9][t] = byteFormat[11][t] = Pack(hi * 17, hi == 0xF ? 0 : 255);
+			}
+		}
+
+		static UINT32 Pack(UINT8 c, UINT8 a)
+		{
+			UINT8	rgba[4] = { c, c, c, a };
+			UINT32	word;
+			memcpy(&word, rgba, 4);
+			return word;
+		}
+	};
+
+	const DecodeTables &GetTables()
+	{
+		static const DecodeTables tables;
+		return tables;
+	}
+}
+
+
+/******************************************************************************
+ Row Decoders
+******************************************************************************/
+
+// Formats 1-6 and 8-11: one table lookup per texel
+static void DecodeRowByte(UINT8 *dest, const UINT16 *src, int width, const UINT32 *table, int shift)
+{
+	for (int i = 0; i < width; i++)
+	{
+		UINT32 word = table[(src[i] >> shift) & 0xFF];
+		memcpy(&dest[i * 4], &word, 4);
+	}
+}
+
+// Format 0: T1RGB5
+static void DecodeRowT1RGB5(UINT8 *dest, const UINT16 *src, int width, const UINT8 *expand5)
+{
+	int i = 0;
+
+#ifdef TEXTUREDECODE_USE_SSE2
+	// v*255/31 == (v*2106)>>8 for all 5-bit v, and v*2106 fits in 16 bits
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i scale = _mm_set1_epi16(2106);
+	const __m128i mask8 = _mm_set1_epi16(0xFF);
+
+	for (; i + 8 <= width; i += 8)
+	{
+		__m128i t = _mm_loadu_si128((const __m128i *) &src[i]);
+		__m128i r = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(t, 10), mask5), scale), 8);
+		__m128i g = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(t, 5), mask5), scale), 8);
+		__m128i b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(t, mask5), scale), 8);
+		__m128i a = _mm_andnot_si128(_mm_srai_epi16(t, 15), mask8);	// bit 15 set -> transparent
+		__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+		__m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+		_mm_storeu_si128((__m128i *) &dest[i * 4], _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128((__m128i *) &dest[i * 4 + 16], _mm_unpackhi_epi16(rg, ba));
+	}
+#endif
+
+	for (; i < width; i++)
+	{
+		UINT16 t = src[i];
+		dest[i * 4 + 0] = expand5[(t >> 10) & 0x1F];
+		dest[i * 4 + 1] = expand5[(t >> 5) & 0x1F];
+		dest[i * 4 + 2] = expand5[t & 0x1F];
+		dest[i * 4 + 3] = (t & 0x8000) ? 0 : 255;
+	}
+}
+
+// Format 7: RGBA4
+static void DecodeRowRGBA4(UINT8 *dest, const UINT16 *src, int width)
+{
+	int i = 0;
+
+#ifdef TEXTUREDECODE_USE_SSE2
+	// Pack two nibbles per 16-bit lane, one in each byte, then v*17 == v|(v<<4)
+	const __m128i mask4 = _mm_set1_epi16(0x0F);
+
+	for (; i + 8 <= width; i += 8)
+	{
+		__m128i t = _mm_loadu_si128((const __m128i *) &src[i]);
+		__m128i rg = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(t, 12), mask4), _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(t, 8), mask4), 8));
+		__m128i ba = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(t, 4), mask4), _mm_slli_epi16(_mm_and_si128(t, mask4), 8));
+		rg = _mm_or_si128(rg, _mm_slli_epi16(rg, 4));
+		ba = _mm_or_si128(ba, _mm_slli_epi16(ba, 4));
+		_mm_storeu_si128((__m128i *) &dest[i * 4], _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128((__m128i *) &dest[i * 4 + 16], _mm_unpackhi_epi16(rg, ba));
+	}
+#endif
+
+	for (; i < width; i++)
+	{
+		UINT16 t = src[i];
+		dest[i * 4 + 0] = ((t >> 12) & 0xF) * 17;
+		dest[i * 4 + 1] = ((t >> 8) & 0xF) * 17;
+		dest[i * 4 + 2] = ((t >> 4) & 0xF) * 17;
+		dest[i * 4 + 3] = (t & 0xF) * 17;
+	}
+}
+
+static void DecodeRowInvalid(UINT8 *dest, int width)
+{
+	for (int i = 0; i < width; i++)
+	{
+		dest[i * 4 + 0] = 255;
+		dest[i * 4 + 1] = 0;
+		dest[i * 4 + 2] = 0;
+		dest[i * 4 + 3] = 255;
+	}
+}
+
+
+/******************************************************************************
+ Interface
+******************************************************************************/
+
+void DecodeTexelsRGBA8(UINT8 *dest, const UINT16 *src, int format, int x, int y, int width, int height)
+{
+	const DecodeTables &tables = GetTables();
+
+	for (int yi = 0; yi < height; yi++)
+	{
+		const UINT16	*row = &src[(y + yi) * 2048 + x];
+		UINT8			*out = &dest[yi * width * 4];
+
+		switch (format)
+		{
+		case 0:
+			DecodeRowT1RGB5(out, row, width, tables.expand5);
+			break;
+		case 7:
+			DecodeRowRGBA4(out, row, width);
+			break;
+		case 1:
+		case 2:
+		case 5:
+		case 8:
+		case 9:
+			DecodeRowByte(out, row, width, tables.byteFormat[format], 0);
+			break;
+		case 3:
+		case 4:
+		case 6:
+		case 10:
+		case 11:
+			DecodeRowByte(out, row, width, tables.byteFormat[format], 8);
+			break;
+		default:
+			DecodeRowInvalid(out, width);
+			break;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * TextureDecode.h
+ *
+ * Conversion of Real3D texture RAM to 8-bit RGBA, shared by both 3D engines.
+ */
+
+#ifndef INCLUDED_TEXTUREDECODE_H
+#define INCLUDED_TEXTUREDECODE_H
+
+#include "Types.h"
+
+/*
+ * DecodeTexelsRGBA8(dest, src, format, x, y, width, height):
+ *
+ * Decodes a rectangle of texture RAM to 8-bit RGBA. Formats 0-7 are those
+ * found in the polygon header:
+ *
+ *		0	T1RGB5
+ *		1	A4L4 (low byte)
+ *		2	L4A4 (low byte)
+ *		3	A4L4 (high byte)
+ *		4	L4A4 (high byte)
+ *		5	8-bit grayscale (low byte)
+ *		6	8-bit grayscale (high byte)
+ *		7	RGBA4
+ *
+ * Formats 8-11 are the 4-bit contour formats used by the new engine (low
+ * byte low nibble, low byte high nibble, high byte low nibble, high byte high
+ * nibble). Any other format produces solid red.
+ *
+ * The 16-bit formats are converted with SSE2 where available, the 8-bit
+ * formats through 256-entry lookup tables.
+ *
+ * Parameters:
+ *		dest	Output buffer of width*height*4 bytes. Rows are packed.
+ *		src		Texture RAM (2048x2048 texels).
+ *		format	Texel format (see above).
+ *		x		X position of the rectangle in texture RAM.
+ *		y		Y position.
+ *		width	Width in texels.
+ *		height	Height in texels.
+ */
+extern void DecodeTexelsRGBA8(UINT8 *dest, const UINT16 *src, int format, int x, int y, int width, int height);
+
+
+#endif	// INCLUDED_TEXTUREDECODE_H
@@ -421,17 +421,15 @@ void CDSB1::SendCommand(UINT8 data)
 #endif
 }
 
-void CDSB1::RunFrame(INT16 *audioL, INT16 *audioR)
+void CDSB1::RunFrame(void)
 {
 	int		cycles;
-	UINT8	v;
 	
 	if (!m_config["EmulateDSB"].ValueAs<bool>())
 	{
-		// DSB code applies SCSP volume, too, so we must still mix
+		// DSB code applies SCSP volume, too, so we must still mix (silence)
 		memset(mpegL, 0, (32000/60+2)*sizeof(INT16));
 		memset(mpegR, 0, (32000/60+2)*sizeof(INT16));
-		retainedSamples = Resampler.UpSampleAndMix(audioL, audioR, mpegL, mpegR, 0, 0, 44100/60, 32000/60+2, 44100, 32000);
 		return;
 	}
 	
@@ -448,12 +446,19 @@ void CDSB1::RunFrame(INT16 *audioL, INT16 *audioR)
 	
 	//printf("VOLUME=%02X STEREO=%02X\n", volume, stereo);
 	
-	// Convert volume from 0x00-0x7F -> 0x00-0xFF
-	v = (UINT8) ((float) 255.0f * (float) volume /127.0f);
-	
 	// Decode MPEG for this frame
 	INT16 *mpegFill[2] = { &mpegL[retainedSamples], &mpegR[retainedSamples] };
 	MPEG_Decode(mpegFill, 32000/60-retainedSamples+2);
+}
+
+void CDSB1::MixFrame(INT16 *audioL, INT16 *audioR)
+{
+	UINT8	v = 0;
+	
+	// Convert volume from 0x00-0x7F -> 0x00-0xFF
+	if (m_config["EmulateDSB"].ValueAs<bool>())
+		v = (UINT8) ((float) 255.0f * (float) volume /127.0f);
+	
 	retainedSamples = Resampler.UpSampleAndMix(audioL, audioR, mpegL, mpegR, v, v, 44100/60, 32000/60+2, 44100, 32000);
 }
 
@@ -981,14 +986,13 @@ void CDSB2::SendCommand(UINT8 data)
 }
 	
 
-void CDSB2::RunFrame(INT16 *audioL, INT16 *audioR)
+void CDSB2::RunFrame(void)
 {
 	if (!m_config["EmulateDSB"].ValueAs<bool>())
 	{
-		// DSB code applies SCSP volume, too, so we must still mix
+		// DSB code applies SCSP volume, too, so we must still mix (silence)
 		memset(mpegL, 0, (32000/60+2)*sizeof(INT16));
 		memset(mpegR, 0, (32000/60+2)*sizeof(INT16));
-		retainedSamples = Resampler.UpSampleAndMix(audioL, audioR, mpegL, mpegR, volume[0], volume[1], 44100/60, 32000/60+2, 44100, 32000);
 		return;
 	}
 
@@ -1016,6 +1020,10 @@ void CDSB2::RunFrame(INT16 *audioL, INT16 *audioR)
 	// Decode MPEG for this frame
 	INT16 *mpegFill[2] = { &mpegL[retainedSamples], &mpegR[retainedSamples] };
 	MPEG_Decode(mpegFill, 32000/60-retainedSamples+2);
+}
+
+void CDSB2::MixFrame(INT16 *audioL, INT16 *audioR)
+{
 	retainedSamples = Resampler.UpSampleAndMix(audioL, audioR, mpegL, mpegR, volume[0], volume[1], 44100/60, 32000/60+2, 44100, 32000);
 }
 
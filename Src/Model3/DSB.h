@@ -98,16 +98,25 @@ public:
 	virtual void SendCommand(UINT8 data) = 0;
 	
 	/*
-	 * RunFrame(audioL, audioR):
+	 * RunFrame(void):
 	 *
-	 * Runs one frame and updates the MPEG audio. Audio is mixed into the
-	 * supplied buffers (they are assumed to already contain audio data).
+	 * Runs one frame and decodes the frame's MPEG audio, which is then mixed
+	 * in by MixFrame(). This does not touch the sound board, so it may be run
+	 * on another thread while the SCSPs generate their audio.
+	 */
+	virtual void RunFrame(void) = 0;
+	
+	/*
+	 * MixFrame(audioL, audioR):
+	 *
+	 * Mixes the MPEG audio of the last frame run into the supplied buffers
+	 * (they are assumed to already contain audio data).
 	 *
 	 * Parameters:
 	 *		audioL	Left audio channel, one frame (44 KHz, 1/60th second).
 	 *		audioR	Right audio channel.
 	 */
-	virtual void RunFrame(INT16 *audioL, INT16 *audioR) = 0;
+	virtual void MixFrame(INT16 *audioL, INT16 *audioR) = 0;
 	
 	/*
 	 * Reset(void):
@@ -180,7 +189,8 @@ public:
 	
 	// DSB interface (see CDSB definition)
 	void 	SendCommand(UINT8 data);
-	void 	RunFrame(INT16 *audioL, INT16 *audioR);
+	void 	RunFrame(void);
+	void 	MixFrame(INT16 *audioL, INT16 *audioR);
 	void 	Reset(void);
 	void	SaveState(CBlockFile *StateFile);
 	void	LoadState(CBlockFile *StateFile);
@@ -257,7 +267,8 @@ public:
 	
 	// DSB interface (see definition of CDSB)
 	void 	SendCommand(UINT8 data);
-	void 	RunFrame(INT16 *audioL, INT16 *audioR);
+	void 	RunFrame(void);
+	void 	MixFrame(INT16 *audioL, INT16 *audioR);
 	void 	Reset(void);
 	void	SaveState(CBlockFile *StateFile);
 	void	LoadState(CBlockFile *StateFile);
@@ -809,6 +809,7 @@ void CModel3::SetCROMBank(unsigned idx)
   cromBankReg = idx;
   idx = (~idx) & 0xF;
   cromBank = &crom[0x800000 + (idx*0x800000)];
+  ppc_map_memory(0xFF000000, 0xFF7FFFFF, cromBank, false);
   DebugLog("CROM bank setting: %d (%02X), PC=%08X, LR=%08X\n", idx, cromBankReg, ppc_get_pc(), ppc_get_lr());
 }
 
@@ -849,6 +850,12 @@ void CModel3::WriteSystemRegister(unsigned reg, UINT8 data)
   case 0x18:  // IRQ acknowledge
     IRQ.Deassert(data);
     DebugLog("IRQ ACK? %02X=%02X\n", reg, data);
+    // A MIDI interrupt that has been acknowledged does not need to be held any longer (see RunMainBoardFrame())
+    if ((data & 0x40) && m_scheduler.Cancel(EventMIDIIRQEnd))
+    {
+      m_scheduler.Schedule(EventMIDIIRQEnd, ppc_total_cycles());
+      ppc_end_slice();
+    }
     break;
   case 0x0C:  // JTAG Test Access Port
   {
@@ -1363,6 +1370,7 @@ void CModel3::Write8(UINT32 addr, UINT8 data)
   if (addr < 0x00800000)
   {
     ram[addr^3] = data;
+    ppc_code_write(addr);
     return;
   }
 
@@ -1523,6 +1531,7 @@ void CModel3::Write16(UINT32 addr, UINT16 data)
   if (addr < 0x00800000)
   {
     *(UINT16 *) &ram[addr^2] = data;
+    ppc_code_write(addr);
     return;
   }
 
@@ -1616,6 +1625,7 @@ void CModel3::Write32(UINT32 addr, UINT32 data)
   if (addr<0x00800000)
   {
     *(UINT32 *) &ram[addr] = data;
+    ppc_code_write(addr);
     return;
   }
 
@@ -1986,10 +1996,13 @@ void CModel3::RunFrame(void)
     if (!StartThreads())
       goto ThreadError;
 
-    // Wake threads for PPC main board (if multi-threading GPU), sound board (if sync'd) and drive board (if attached) so they can process a frame
+    // Wake threads for PPC main board (if multi-threading GPU), sound board (if sync'd) and drive board (if attached) so they can process a frame.
+    // If multi-threading GPU, the PPC main board thread syncs the GPU snapshots itself at the end of its frame and publishes them without waiting
+    // for the render below, which draws those published at the end of the previous frame.
     if ((m_gpuMultiThreaded       && !ppcBrdThreadSync->Post()) || 
         (syncSndBrdThread         && !sndBrdThreadSync->Post()) || 
-        (DriveBoard.IsAttached()  && !drvBrdThreadSync->Post()))
+        (DriveBoard.IsAttached()  && !drvBrdThreadSync->Post()) ||
+        (netBrdFramePending       && !netBrdThreadSync->Post()))
       goto ThreadError;
 
     // If not multi-threading GPU, then run PPC main board for a frame and sync GPUs now in this thread
@@ -2006,10 +2019,11 @@ void CModel3::RunFrame(void)
     if (!notifyLock->Lock())
       goto ThreadError;
 
-    // Wait for PPC main board, sound board and drive board threads to finish their work (if they are running and haven't finished already)
+    // Wait for PPC main board, sound board, drive board and net board threads to finish their work (if they are running and haven't finished already)
     while ((m_gpuMultiThreaded      && !ppcBrdThreadDone) || 
            (syncSndBrdThread        && !sndBrdThreadDone) || 
-           (DriveBoard.IsAttached() && !drvBrdThreadDone))
+           (DriveBoard.IsAttached() && !drvBrdThreadDone) ||
+           (netBrdFramePending      && !netBrdThreadDone))
     {
       if (!notifySync->Wait(notifyLock))
         goto ThreadError;
@@ -2017,17 +2031,17 @@ void CModel3::RunFrame(void)
     ppcBrdThreadDone = false;
     sndBrdThreadDone = false;
     drvBrdThreadDone = false;
+    netBrdThreadDone = false;
 
     // Leave notify wait critical section
     if (!notifyLock->Unlock())
       goto ThreadError;
 
-    // If multi-threading GPU, then sync GPUs last while PPC main board thread is waiting
-    if (m_gpuMultiThreaded)
-      SyncGPUs();
-	
-	/*if (NetBoard.IsAttached())
-		RunNetBoardFrame();*/
+#ifdef NET_BOARD
+    // With the PPC main board idle, interrupt it for the net board here. The net board thread then runs its frame
+    // alongside the next one, so it still follows the interrupt as in single-threaded mode.
+    netBrdFramePending = (netBrdThread != NULL) && PrepareNetBoardFrame();
+#endif
   }
   else
   {
@@ -2039,24 +2053,14 @@ void CModel3::RunFrame(void)
     if (DriveBoard.IsAttached())
       RunDriveBoardFrame();
 #ifdef NET_BOARD
-	if (NetBoard.IsAttached() && (m_config["EmulateNet"].ValueAs<bool>()) && ((*(UINT16 *)&netBuffer[(0xc00100C0 & 0x3FFFF)] == 0xFFFF) || (netBuffer[(0xc00100C0 & 0x3FFFF)] == 0xFF) || (*(UINT16 *)&netBuffer[(0xc00100C0 & 0x3FFFF)] == 0x0001)) && (NetBoard.CodeReady == true))
-	{
-		// ppc irq network needed ? no effect, is it really active/needed ? 
-		//RunNetBoardFrame();
-		IRQ.Assert(0x10);
-		ppc_execute(200); // give PowerPC time to acknowledge IRQ
-		//RunNetBoardFrame();
-		IRQ.Deassert(0x10);
-		ppc_execute(200); // acknowledge that IRQ was deasserted (TODO: is this really needed?)
+	if (PrepareNetBoardFrame())
 		RunNetBoardFrame();
-		// Hum hum, if runnetboardframe is called at 1st place or between ppc irq assert/deassert, spikout freezes just after the gate with net error
-		// if runnetboardframe is called after ppc irq assert/deassert, spikout works
-	}
 #endif	
   }
 
 #ifndef __LIBRETRO__
   timings.frameTicks = CThread::GetTicks() - start;
+  GetAudioStats(&timings.audioUnderRuns, &timings.audioOverRuns);
 #endif
 
   return;
@@ -2073,6 +2077,8 @@ void CModel3::RunMainBoardFrame(void)
     return;
   
   UINT32 start = CThread::GetTicks();
+  UINT64 idleStart = ppc_get_idle_cycles();
+  UINT64 fetchMissStart = ppc_get_fetch_misses();
 
   /*
    * Display timing is assumed to be driven by the System 24 tile generator
@@ -2192,6 +2198,8 @@ void CModel3::RunMainBoardFrame(void)
   IRQ.Deassert(0x0C);
 
   timings.ppcTicks = CThread::GetTicks() - start;
+  timings.ppcIdleCycles = (UINT32) (ppc_get_idle_cycles() - idleStart);
+  timings.ppcFetchMisses = (UINT32) (ppc_get_fetch_misses() - fetchMissStart);
 }
 #endif
 
@@ -2199,6 +2207,8 @@ void CModel3::RunMainBoardFrame(void)
 void CModel3::RunMainBoardFrame(void)
 {
   UINT32 start = CThread::GetTicks();
+  UINT64 idleStart = ppc_get_idle_cycles();
+  UINT64 fetchMissStart = ppc_get_fetch_misses();
 
   // Compute display and VBlank timings
   unsigned ppcCycles   = m_config["PowerPCFrequency"].ValueAs<unsigned>() * 1000000;
@@ -2230,68 +2240,111 @@ void CModel3::RunMainBoardFrame(void)
   else
     statusCycles = (unsigned)((float)frameCycles * 48.0f/100.0f);
 
-  // VBlank
+  /*
+   * The frame is run as a sequence of events, with the PowerPC executing
+   * exactly up to each one:
+   *
+   *    VBlank start (IRQ 0x02)
+   *    ... vblCycles later, MIDI interrupts (see below), then
+   *    VBlank end (IRQ 0x0D)
+   *    ... active display until the frame has lasted frameCycles
+   *
+   * The Real3D status bit changes statusCycles after VBlank start. Games poll
+   * it in loops that idle skipping fast-forwards through, so it is an event
+   * as well: the slice, and any skipping, stops exactly where the bit
+   * changes.
+   *
+   * Sound:
+   *
+   * Bit 0x20 of the MIDI control port appears to enable periodic interrupts,
+   * which are used to send MIDI commands. Often games will write 0x27, send
+   * a series of commands, and write 0x06 to stop. Other games, like Star
+   * Wars Trilogy and Sega Rally 2, will enable interrupts at the beginning
+   * by writing 0x37 and will disable/enable interrupts to control command
+   * output. The PowerPC is given up to midiIRQCycles to acknowledge each
+   * interrupt and as long again after it is deasserted (TODO: is this really
+   * needed?). Writing the IRQ acknowledge register ends the time slice (see
+   * WriteSystemRegister()), so an interrupt the game acknowledges quickly is
+   * not held for the full midiIRQCycles. The interrupts continue for as long
+   * as the game keeps them enabled, up to a limit per frame.
+   *
+   * If the GPUs are not ready yet, there is no VBlank and only the active
+   * display part of the frame is run.
+   */
+  const unsigned midiIRQCycles = 200;
+  int midiIRQCount = 0;
+  UINT64 now = ppc_total_cycles();
+  m_scheduler.Clear();
   if (gpusReady)
   {
-    TileGen.BeginVBlank();
-    GPU.BeginVBlank(statusCycles);
-    IRQ.Assert(0x02);
-    ppc_execute(vblCycles);
-    //printf("PC=%08X LR=%08X\n", ppc_get_pc(), ppc_get_lr());
-  
-    /*
-     * Sound:
-     *
-     * Bit 0x20 of the MIDI control port appears to enable periodic interrupts,
-     * which are used to send MIDI commands. Often games will write 0x27, send
-     * a series of commands, and write 0x06 to stop. Other games, like Star
-     * Wars Trilogy and Sega Rally 2, will enable interrupts at the beginning
-     * by writing 0x37 and will disable/enable interrupts to control command
-     * output.
-     */
-    //printf("\t-- BEGIN (Ctrl=%02X, IRQEn=%02X, IRQPend=%02X) --\n", midiCtrlPort, IRQ.ReadIRQEnable()&0x40, IRQ.ReadIRQState());
-    int irqCount = 0;
-    while ((midiCtrlPort&0x20))
-    //while (midiCtrlPort == 0x27)  // 27 triggers IRQ sequence, 06 stops it
+    m_scheduler.Schedule(EventVBlankStart, now);
+    m_scheduler.Schedule(EventMIDIIRQ, now + vblCycles);
+    m_scheduler.Schedule(EventFrameEnd, now + frameCycles);
+  }
+  else
+    m_scheduler.Schedule(EventFrameEnd, now + dispCycles);
+
+  bool frameDone = false;
+  while (!frameDone)
+  {
+    // The slice may end early (or, with idle skipping or a block-based engine, slightly late)
+    UINT64 next = m_scheduler.NextTime();
+    if (next > now)
     {
-      // Don't waste time firing MIDI interrupts if game has disabled them
-      if ((IRQ.ReadIRQEnable()&0x40) == 0)
-        break;
-        
-      // Process MIDI interrupt
-      IRQ.Assert(0x40);
-      ppc_execute(200); // give PowerPC time to acknowledge IRQ
-      IRQ.Deassert(0x40);
-      ppc_execute(200); // acknowledge that IRQ was deasserted (TODO: is this really needed?)
-      dispCycles -= 400;
+      ppc_execute((int) (next - now));
+      now = ppc_total_cycles();
+    }
 
-      ++irqCount;
-      if (irqCount > 128)
+    switch (m_scheduler.Pop())
+    {
+    case EventVBlankStart:
+      TileGen.BeginVBlank();
+      GPU.BeginVBlank(statusCycles);
+      IRQ.Assert(0x02);
+      m_scheduler.Schedule(EventReal3DStatus, now + statusCycles);
+      break;
+
+    case EventReal3DStatus:
+      // Nothing to do: the status bit is derived from the cycle count (see CReal3D::ReadRegister())
+      break;
+
+    case EventMIDIIRQ:
+      // Don't waste time firing MIDI interrupts if game has disabled them
+      if ((midiCtrlPort&0x20) && (IRQ.ReadIRQEnable()&0x40) && midiIRQCount <= 128)
       {
-        //printf("\tMIDI FIFO OVERFLOW! (IRQEn=%02X, IRQPend=%02X)\n", IRQ.ReadIRQEnable()&0x40, IRQ.ReadIRQState());
-        break;
+        IRQ.Assert(0x40);
+        m_scheduler.Schedule(EventMIDIIRQEnd, now + midiIRQCycles);
       }
+      else
+      {
+        //if (midiIRQCount > 128)
+        //  printf("\tMIDI FIFO OVERFLOW! (IRQEn=%02X, IRQPend=%02X)\n", IRQ.ReadIRQEnable()&0x40, IRQ.ReadIRQState());
+        m_scheduler.Schedule(EventVBlankEnd, now);
+      }
+      break;
+
+    case EventMIDIIRQEnd:
+      IRQ.Deassert(0x40);
+      ++midiIRQCount;
+      m_scheduler.Schedule(EventMIDIIRQ, now + midiIRQCycles);
+      break;
+
+    case EventVBlankEnd:
+      GPU.EndVBlank();
+      TileGen.EndVBlank();
+      IRQ.Assert(0x0D);
+      break;
+
+    case EventFrameEnd:
+      frameDone = true;
+      break;
     }
-    //printf("\t-- END --\n");
-    //printf("PC=%08X LR=%08X\n", ppc_get_pc(), ppc_get_lr());
-    
-    // End VBlank
-    GPU.EndVBlank();
-    TileGen.EndVBlank();
-    IRQ.Assert(0x0D);
-  }
-
-  // Run the PowerPC for the active display part of the frame
-  ppc_execute(dispCycles);
-  // MAME believes 0x0C should occur on every scanline 
-  //for (int i = 0; i < 384; i++)
-  //{
-  //  ppc_execute(dispCycles / 384);
-  //  IRQ.Assert(0x0C);
-  //}
+  }
   //printf("PC=%08X LR=%08X\n", ppc_get_pc(), ppc_get_lr());
 
   timings.ppcTicks = CThread::GetTicks() - start;
+  timings.ppcIdleCycles = (UINT32) (ppc_get_idle_cycles() - idleStart);
+  timings.ppcFetchMisses = (UINT32) (ppc_get_fetch_misses() - fetchMissStart);
 }
 #endif
 
@@ -2299,7 +2352,13 @@ void CModel3::SyncGPUs(void)
 {
   UINT32 start = CThread::GetTicks();
 
-  timings.syncSize = GPU.SyncSnapshots() + TileGen.SyncSnapshots();
+  // Both GPUs update their snapshots for the same frame number, which is then published once for the two of them, so
+  // that the render thread always draws the 2D layers, 3D scene and texture uploads from the same frame
+  UINT32 gpuRanges, tileGenRanges;
+  unsigned frame = gpuFramePublished.load(std::memory_order_relaxed) + 1;
+  timings.syncSize = GPU.SyncSnapshots(frame, gpuRanges) + TileGen.SyncSnapshots(frame, tileGenRanges);
+  timings.syncRanges = gpuRanges + tileGenRanges;
+  gpuFramePublished.store(frame, std::memory_order_release);
   gpusReady = true;
 
   timings.syncTicks = CThread::GetTicks() - start;
@@ -2312,15 +2371,25 @@ void CModel3::RenderFrame(void)
   // Call OSD video callbacks
   if (BeginFrameVideo() && gpusReady)
   {
-    // Render frame
-    TileGen.BeginFrame();
-    GPU.BeginFrame();
+    // Render frame from the snapshots of the last frame published
+    unsigned frame = gpuFramePublished.load(std::memory_order_acquire);
+    TileGen.BeginFrame(frame);
+    GPU.BeginFrame(frame);
     TileGen.PreRenderFrame();
     TileGen.RenderFrameBottom();
     GPU.RenderFrame();
     TileGen.RenderFrameTop();
     GPU.EndFrame();
     TileGen.EndFrame();
+
+    float hitRate;
+    unsigned residentPolys, evictions;
+    if (GPU.GetModelCacheStats(&hitRate, &residentPolys, &evictions))
+    {
+      timings.romCacheHitRate = (UINT32) (hitRate * 100.0f + 0.5f);
+      timings.romCachePolys = residentPolys;
+      timings.romCacheEvictions = evictions;
+    }
   }
 
   EndFrameVideo();
@@ -2331,9 +2400,44 @@ void CModel3::RenderFrame(void)
 bool CModel3::RunSoundBoardFrame(void)
 {
   UINT32 start = CThread::GetTicks();
-  bool bufferFull = SoundBoard.RunFrame();
+  bool bufferFull;
+
+  // If there is a DSB thread, then have the DSB run its frame while the SCSPs run here and mix it in once both are done
+  if (m_multiThreaded && dsbThread != NULL)
+  {
+    if (!dsbThreadSync->Post())
+      goto ThreadError;
+
+    SoundBoard.RunSCSPFrame();
+
+    // Enter notify wait critical section
+    if (!notifyLock->Lock())
+      goto ThreadError;
+
+    // Wait for DSB thread to finish its frame
+    while (!dsbThreadDone)
+    {
+      if (!notifySync->Wait(notifyLock))
+        goto ThreadError;
+    }
+    dsbThreadDone = false;
+
+    // Leave notify wait critical section
+    if (!notifyLock->Unlock())
+      goto ThreadError;
+
+    bufferFull = SoundBoard.OutputFrame();
+  }
+  else
+    bufferFull = SoundBoard.RunFrame();
+
   timings.sndTicks = CThread::GetTicks() - start;
   return bufferFull;
+
+ThreadError:
+  ErrorLog("Threading error in CModel3::RunSoundBoardFrame: %s\nSwitching back to single-threaded mode.\n", CThread::GetLastError());
+  m_multiThreaded = false;
+  return true;
 }
 
 void CModel3::RunDriveBoardFrame(void)
@@ -2344,9 +2448,27 @@ void CModel3::RunDriveBoardFrame(void)
 }
 
 #ifdef NET_BOARD
+bool CModel3::PrepareNetBoardFrame(void)
+{
+	if (!(NetBoard.IsAttached() && (m_config["EmulateNet"].ValueAs<bool>()) && ((*(UINT16 *)&netBuffer[(0xc00100C0 & 0x3FFFF)] == 0xFFFF) || (netBuffer[(0xc00100C0 & 0x3FFFF)] == 0xFF) || (*(UINT16 *)&netBuffer[(0xc00100C0 & 0x3FFFF)] == 0x0001)) && (NetBoard.CodeReady == true)))
+		return false;
+
+	// ppc irq network needed ? no effect, is it really active/needed ? 
+	IRQ.Assert(0x10);
+	ppc_execute(200); // give PowerPC time to acknowledge IRQ
+	IRQ.Deassert(0x10);
+	ppc_execute(200); // acknowledge that IRQ was deasserted (TODO: is this really needed?)
+
+	// Hum hum, if runnetboardframe is called at 1st place or between ppc irq assert/deassert, spikout freezes just after the gate with net error
+	// if runnetboardframe is called after ppc irq assert/deassert, spikout works
+	return true;
+}
+
 void CModel3::RunNetBoardFrame(void)
 {
+	UINT32 start = CThread::GetTicks();
 	NetBoard.RunFrame();
+	timings.netTicks = CThread::GetTicks() - start;
 }
 #endif
 
@@ -2377,6 +2499,20 @@ bool CModel3::StartThreads(void)
     if (drvBrdThreadSync == NULL)
       goto ThreadError;
   }
+  if (DSB != NULL)
+  {
+    dsbThreadSync = CThread::CreateSemaphore(0);
+    if (dsbThreadSync == NULL)
+      goto ThreadError;
+  }
+#ifdef NET_BOARD
+  if (NetBoard.IsAttached())
+  {
+    netBrdThreadSync = CThread::CreateSemaphore(0);
+    if (netBrdThreadSync == NULL)
+      goto ThreadError;
+  }
+#endif
   notifyLock = CThread::CreateMutex();
   if (notifyLock == NULL)
     goto ThreadError;
@@ -2387,6 +2523,7 @@ bool CModel3::StartThreads(void)
   // Reset thread flags
   pauseThreads = false;
   stopThreads = false;
+  netBrdFramePending = false;
 
   // Create PPC main board thread, if multi-threading GPU
   if (m_gpuMultiThreaded)
@@ -2412,6 +2549,24 @@ bool CModel3::StartThreads(void)
       goto ThreadError;
   }
 
+  // Create DSB thread, if DSB is attached (each board's CPU has its own context so they can all run at once)
+  if (DSB != NULL)
+  {
+    dsbThread = CThread::CreateThread(StartDSBThread, this);
+    if (dsbThread == NULL)
+      goto ThreadError;
+  }
+
+#ifdef NET_BOARD
+  // Create net board thread, if net board is attached
+  if (NetBoard.IsAttached())
+  {
+    netBrdThread = CThread::CreateThread(StartNetBoardThread, this);
+    if (netBrdThread == NULL)
+      goto ThreadError;
+  }
+#endif
+
   // Set audio callback if sound board thread is unsync'd
   if (!syncSndBrdThread)
   {
@@ -2439,7 +2594,7 @@ bool CModel3::PauseThreads(void)
 
   // Let threads know that they should pause and wait for all of them to do so
   pauseThreads = true;
-  while (ppcBrdThreadRunning || sndBrdThreadRunning || drvBrdThreadRunning)
+  while (ppcBrdThreadRunning || sndBrdThreadRunning || drvBrdThreadRunning || netBrdThreadRunning)
   {
     if (!notifySync->Wait(notifyLock))
       goto ThreadError;
@@ -2494,7 +2649,7 @@ bool CModel3::StopThreads(void)
 
   // Let threads know that they should pause and wait for all of them to do so
   pauseThreads = true;
-  while (ppcBrdThreadRunning || sndBrdThreadRunning || drvBrdThreadRunning)
+  while (ppcBrdThreadRunning || sndBrdThreadRunning || drvBrdThreadRunning || netBrdThreadRunning)
   {
     if (!notifySync->Wait(notifyLock))
       goto ThreadError;
@@ -2531,6 +2686,16 @@ bool CModel3::StopThreads(void)
     if (drvBrdThreadSync->Post())
       drvBrdThread->Wait();
   }
+  if (dsbThread != NULL)
+  {
+    if (dsbThreadSync->Post())
+      dsbThread->Wait();
+  }
+  if (netBrdThread != NULL)
+  {
+    if (netBrdThreadSync->Post())
+      netBrdThread->Wait();
+  }
 
   // Delete all thread and synchronization objects
   DeleteThreadObjects();
@@ -2561,6 +2726,16 @@ void CModel3::DeleteThreadObjects(void)
     delete drvBrdThread;
     drvBrdThread = NULL;
   }
+  if (dsbThread != NULL)
+  {
+    delete dsbThread;
+    dsbThread = NULL;
+  }
+  if (netBrdThread != NULL)
+  {
+    delete netBrdThread;
+    netBrdThread = NULL;
+  }
 
 
   // Delete synchronization objects
@@ -2579,6 +2754,16 @@ void CModel3::DeleteThreadObjects(void)
     delete drvBrdThreadSync;
     drvBrdThreadSync = NULL;
   }
+  if (dsbThreadSync != NULL)
+  {
+    delete dsbThreadSync;
+    dsbThreadSync = NULL;
+  }
+  if (netBrdThreadSync != NULL)
+  {
+    delete netBrdThreadSync;
+    netBrdThreadSync = NULL;
+  }
 
 
   if (sndBrdNotifyLock != NULL)
@@ -2605,10 +2790,12 @@ void CModel3::DeleteThreadObjects(void)
 
 void CModel3::DumpTimings(void)
 {
-  printf("PPC:%3ums%c render:%3ums%c sync:%4uK%c%3ums%c snd:%3ums%c drv:%3ums%c frame:%3ums%c\n",
+  printf("PPC:%3ums%c idle:%5uK, fetch:%5u, render:%3ums%c rom:%3u%%/%4uK/%3u, sync:%4uK/%4u%c%3ums%c snd:%3ums%c drv:%3ums%c frame:%3ums%c xruns:%u/%u\n",
     timings.ppcTicks, (timings.ppcTicks > timings.renderTicks ? '!' : ','),
+    timings.ppcIdleCycles / 1000, timings.ppcFetchMisses,
     timings.renderTicks, (timings.renderTicks > timings.ppcTicks ? '!' : ','), 
-    timings.syncSize / 1024, (timings.syncSize / 1024 > 128 ? '!' : ','), 
+    timings.romCacheHitRate, timings.romCachePolys / 1000, timings.romCacheEvictions,
+    timings.syncSize / 1024, timings.syncRanges, (timings.syncSize / 1024 > 128 ? '!' : ','), 
     timings.syncTicks, (timings.syncTicks > 1 ? '!' : ','),
     timings.sndTicks, (timings.sndTicks > 10 ? '!' : ','),
     timings.drvTicks, (timings.drvTicks > 10 ? '!' : ','),
@@ -2616,9 +2803,10 @@ void CModel3::DumpTimings(void)
 	timings.netTicks, (timings.netTicks > 10 ? '!' : ','),
 #endif
 #ifdef __LIBRETRO__
-    16, ' ');
+    16, ' ', 0, 0);
 #else
-    timings.frameTicks, (timings.frameTicks > 16 ? '!' : ' '));
+    timings.frameTicks, (timings.frameTicks > 16 ? '!' : ' '),
+    timings.audioUnderRuns, timings.audioOverRuns);
 #endif
 }
 
@@ -2655,6 +2843,20 @@ int CModel3::StartDriveBoardThread(void *data)
   return model3->RunDriveBoardThread();
 }
 
+int CModel3::StartDSBThread(void *data)
+{
+  // Call method on CModel3 to run DSB thread
+  CModel3 *model3 = (CModel3*)data;
+  return model3->RunDSBThread();
+}
+
+int CModel3::StartNetBoardThread(void *data)
+{
+  // Call method on CModel3 to run net board thread
+  CModel3 *model3 = (CModel3*)data;
+  return model3->RunNetBoardThread();
+}
+
 
 int CModel3::RunMainBoardThread(void)
 {
@@ -2688,8 +2890,9 @@ int CModel3::RunMainBoardThread(void)
     if (exit)
       return 0;
 
-    // Process a single frame for PPC main board
+    // Process a single frame for PPC main board and hand over the GPU state to the render thread
     RunMainBoardFrame();
+    SyncGPUs();
 
     // Enter notify critical section
     if (!notifyLock->Lock())
@@ -2953,6 +3156,110 @@ ThreadError:
   return 1;
 }
 
+int CModel3::RunDSBThread(void)
+{
+  for (;;)
+  {
+    bool exit;
+
+    // Wait on DSB thread semaphore (posted by the sound board thread, so there is no need to check for pausing here)
+    if (!dsbThreadSync->Wait())
+      goto ThreadError;
+
+    // Enter notify critical section
+    if (!notifyLock->Lock())
+      goto ThreadError;
+
+    // Check thread is not being stopped
+    exit = stopThreads;
+
+    // Leave notify critical section
+    if (!notifyLock->Unlock())
+      goto ThreadError;
+    if (exit)
+      return 0;
+
+    // Process a single frame for DSB
+    DSB->RunFrame();
+
+    // Enter notify critical section
+    if (!notifyLock->Lock())
+      goto ThreadError;
+
+    // Let sound board thread know processing has finished
+    dsbThreadDone = true;
+    if (!notifySync->SignalAll())
+      goto ThreadError;
+
+    // Leave notify critical section
+    if (!notifyLock->Unlock())
+      goto ThreadError;
+  }
+
+ThreadError:
+  ErrorLog("Threading error in RunDSBThread: %s\nSwitching back to single-threaded mode.\n", CThread::GetLastError());
+  m_multiThreaded = false;
+  return 1;
+}
+
+int CModel3::RunNetBoardThread(void)
+{
+  for (;;)
+  {
+    bool wait = true; 
+    bool exit = false;
+    while (wait && !exit)
+    {
+      // Wait on net board thread semaphore
+      if (!netBrdThreadSync->Wait())
+        goto ThreadError;
+
+      // Enter notify critical section
+      if (!notifyLock->Lock())
+        goto ThreadError;
+
+      // Check threads are not being stopped or paused
+      if (stopThreads)
+        exit = true;
+      else if (!pauseThreads)
+      {
+        wait = false;
+        netBrdThreadRunning = true;
+      }
+  
+      // Leave notify critical section
+      if (!notifyLock->Unlock())
+        goto ThreadError;
+    }
+    if (exit)
+      return 0;
+
+#ifdef NET_BOARD
+    // Process a single frame for net board
+    RunNetBoardFrame();
+#endif
+
+    // Enter notify critical section
+    if (!notifyLock->Lock())
+      goto ThreadError;
+
+    // Let other threads know processing has finished
+    netBrdThreadRunning = false;
+    netBrdThreadDone = true;
+    if (!notifySync->SignalAll())
+      goto ThreadError;
+
+    // Leave notify critical section
+    if (!notifyLock->Unlock())
+      goto ThreadError;
+  }
+
+ThreadError:
+  ErrorLog("Threading error in RunNetBoardThread: %s\nSwitching back to single-threaded mode.\n", CThread::GetLastError());
+  m_multiThreaded = false;
+  return 1;
+}
+
 
 
 void CModel3::Reset(void)
@@ -2995,11 +3302,18 @@ void CModel3::Reset(void)
   m_cryptoDevice.Reset();
 
   gpusReady = false;
+  gpuFramePublished = 0;
 
   timings.ppcTicks = 0;
+  timings.ppcIdleCycles = 0;
+  timings.ppcFetchMisses = 0;
   timings.syncSize = 0;
+  timings.syncRanges = 0;
   timings.syncTicks = 0;
   timings.renderTicks = 0;
+  timings.romCacheHitRate = 0;
+  timings.romCachePolys = 0;
+  timings.romCacheEvictions = 0;
   timings.sndTicks = 0;
   timings.drvTicks = 0;
 #ifdef NET_BOARD
@@ -3009,6 +3323,8 @@ void CModel3::Reset(void)
 #ifndef __LIBRETRO__
   timings.frameTicks = 0;
 #endif
+  timings.audioUnderRuns = 0;
+  timings.audioOverRuns = 0;
   
   DebugLog("Model 3 reset\n");
 }
@@ -3130,6 +3446,17 @@ bool CModel3::LoadGame(const Game &game, const ROMSet &rom_set)
     ErrorLog("Cannot configure Model 3 because game uses unrecognized stepping (%s).", game.stepping.c_str());
     return FAIL;
   }
+  std::string ppcEngine = m_config["PowerPCEngine"].ValueAsDefault<std::string>("interpreter");
+  if (ppcEngine == "recompiler")
+    ppc_config.engine = PPC_ENGINE_RECOMPILER;
+  else if (ppcEngine == "threaded")
+    ppc_config.engine = PPC_ENGINE_THREADED;
+  else
+  {
+    if (ppcEngine != "interpreter")
+      ErrorLog("Unknown PowerPC engine '%s'. Using interpreter instead.", ppcEngine.c_str());
+    ppc_config.engine = PPC_ENGINE_INTERPRETER;
+  }
   ppc_init(&ppc_config);
   ppc_attach_bus(this);
   PPCFetchRegions[0].start = 0; 
@@ -3142,6 +3469,27 @@ bool CModel3::LoadGame(const Game &game, const ROMSet &rom_set)
   PPCFetchRegions[2].end = 0;
   PPCFetchRegions[2].ptr = NULL;
   ppc_set_fetch(PPCFetchRegions);
+
+  // Memory that the PowerPC can access directly, bypassing the handlers above
+  // (banked CROM is mapped by SetCROMBank())
+  ppc_map_memory(0x00000000, 0x007FFFFF, ram, true);
+  ppc_map_memory(0xFF800000, 0xFFFFFFFF, crom, false);
+  ppc_map_memory(0xF00C0000, 0xF00DFFFF, backupRAM, true);
+  ppc_map_memory(0xFE0C0000, 0xFE0DFFFF, backupRAM, true);
+
+  // Idle loop skipping. Polling loops may only read RAM, ROM, and the Real3D
+  // status register, which changes at a scheduled point in the frame.
+  PPCIdleRegions[0].start = 0;
+  PPCIdleRegions[0].end = 0x007FFFFF;
+  PPCIdleRegions[1].start = 0x84000000;
+  PPCIdleRegions[1].end = 0x8400003F;
+  PPCIdleRegions[2].start = 0xFF000000;
+  PPCIdleRegions[2].end = 0xFFFFFFFF;
+  ppc_set_idle_regions(PPCIdleRegions, 3);
+  if (m_config["PowerPCIdleSkip"].ValueAsDefault<bool>(true))
+    ppc_set_idle_skip(game.idle_loop_detect, game.idle_loops.data(), game.idle_loops.size());
+  else
+    ppc_set_idle_skip(false, NULL, 0);
   
   // Initialize Real3D 
   int stepping = ((game.stepping[0] - '0') << 4) | (game.stepping[2] - '0');
@@ -3276,7 +3624,7 @@ bool CModel3::Init(void)
   EEPROM.Init();
   if (OKAY != TileGen.Init(&IRQ))
     return FAIL;
-  if (OKAY != GPU.Init(vrom,this,&IRQ,0x100)) // same for Real3D DMA interrupt
+  if (OKAY != GPU.Init(vrom,ram,0x800000,this,&IRQ,0x100)) // same for Real3D DMA interrupt
     return FAIL;
   if (OKAY != SoundBoard.Init(soundROM,sampleROM))
     return FAIL;
@@ -3350,12 +3698,16 @@ CModel3::CModel3(const Util::Config::Node &config)
   
   securityPtr = 0;
   
+  gpusReady = false;
+  gpuFramePublished = 0;
   startedThreads = false;
   pauseThreads = false;
   stopThreads = false;
   ppcBrdThread = NULL;
   sndBrdThread = NULL; 
   drvBrdThread = NULL;
+  dsbThread = NULL;
+  netBrdThread = NULL;
   
   ppcBrdThreadRunning = false;
   ppcBrdThreadDone = false;
@@ -3363,11 +3715,17 @@ CModel3::CModel3(const Util::Config::Node &config)
   sndBrdThreadDone = false;
   drvBrdThreadRunning = false;
   drvBrdThreadDone = false;
+  dsbThreadDone = false;
+  netBrdThreadRunning = false;
+  netBrdThreadDone = false;
+  netBrdFramePending = false;
   
   syncSndBrdThread = false;
   ppcBrdThreadSync = NULL;
   sndBrdThreadSync = NULL;
   drvBrdThreadSync = NULL;
+  dsbThreadSync = NULL;
+  netBrdThreadSync = NULL;
   
   notifyLock = NULL;
   notifySync = NULL;
@@ -31,7 +31,9 @@
 #include "Model3/IEmulator.h"
 #include "Model3/JTAG.h"
 #include "Model3/Crypto.h"
+#include "Model3/Scheduler.h"
 #include "Util/NewConfig.h"
+#include <atomic>
 
 /*
  * FrameTimings
@@ -41,15 +43,23 @@
 struct FrameTimings
 {
   UINT32 ppcTicks;
-  UINT32 syncSize;
+  UINT32 ppcIdleCycles;   // PowerPC cycles skipped in idle loops
+  UINT32 ppcFetchMisses;  // PowerPC branches to a different fetch region
+  UINT32 syncSize;        // bytes copied to GPU snapshots
+  UINT32 syncRanges;      // separate memory ranges copied to GPU snapshots
   UINT32 syncTicks;
   UINT32 renderTicks;
+  UINT32 romCacheHitRate;   // percentage of ROM models found already decoded (new 3D engine)
+  UINT32 romCachePolys;     // polys resident in the ROM model cache
+  UINT32 romCacheEvictions; // ROM models evicted to make room
   UINT32 sndTicks;
   UINT32 drvTicks;
 #ifdef NET_BOARD
   UINT32 netTicks;
 #endif
   UINT32 frameTicks;
+  unsigned audioUnderRuns;  // audio buffer under-runs and over-runs since audio was opened
+  unsigned audioOverRuns;
 };
 
 /*
@@ -189,11 +199,23 @@ private:
   UINT8     ReadSystemRegister(unsigned reg);
   void      WriteSystemRegister(unsigned reg, UINT8 data);
 
+  // Main board events (see RunMainBoardFrame())
+  enum MainBoardEvent
+  {
+    EventVBlankStart,
+    EventVBlankEnd,
+    EventReal3DStatus,
+    EventMIDIIRQ,
+    EventMIDIIRQEnd,
+    EventFrameEnd
+  };
+
   void RunMainBoardFrame(void);                       // Runs PPC main board for a frame
-  void SyncGPUs(void);                                // Sync's up GPUs in preparation for rendering - must be called when PPC is not running
-  bool RunSoundBoardFrame(void);                      // Runs sound board for a frame
+  void SyncGPUs(void);                                // Sync's up GPUs in preparation for rendering - must be called from the PPC thread at the end of a frame
+  bool RunSoundBoardFrame(void);                      // Runs sound board for a frame (and DSB, on its own thread if multi-threaded)
   void RunDriveBoardFrame(void);                      // Runs drive board for a frame
 #ifdef NET_BOARD
+  bool PrepareNetBoardFrame(void);                    // Interrupts the PPC for the net board and returns true if the net board should run a frame
   void RunNetBoardFrame(void);						  // Runs net board for a frame
 #endif
 
@@ -205,6 +227,8 @@ private:
   static int StartSoundBoardThread(void *data);       // Callback to start sound board thread (unsync'd)
   static int StartSoundBoardThreadSyncd(void *data);  // Callback to start sound board thread (sync'd)
   static int StartDriveBoardThread(void *data);       // Callback to start drive board thread
+  static int StartDSBThread(void *data);              // Callback to start DSB thread
+  static int StartNetBoardThread(void *data);         // Callback to start net board thread
 
   static void AudioCallback(void *data);              // Audio buffer callback
   
@@ -213,6 +237,8 @@ private:
   int     RunSoundBoardThread(void);                  // Runs sound board thread (not sync'd in step with render thread, ie running at full speed)
   int     RunSoundBoardThreadSyncd(void);             // Runs sound board thread (sync'd in step with render thread)
   int     RunDriveBoardThread(void);                  // Runs drive board thread (sync'd in step with render thread)
+  int     RunDSBThread(void);                         // Runs DSB thread (sync'd in step with sound board thread)
+  int     RunNetBoardThread(void);                    // Runs net board thread (sync'd in step with render thread)
 
   // Runtime configuration
   const Util::Config::Node &m_config;
@@ -263,9 +289,11 @@ private:
   
   // PowerPC
   PPC_FETCH_REGION  PPCFetchRegions[3];
+  PPC_IDLE_REGION   PPCIdleRegions[3];
 
   // Multiple threading
-  bool        gpusReady;           // True if GPUs are ready to render
+  std::atomic<bool> gpusReady;     // True if GPUs are ready to render
+  std::atomic<unsigned> gpuFramePublished;  // Last frame whose Real3D and tile generator snapshots were both published (0 if none yet)
   bool        startedThreads;      // True if threads have been created and started
   bool        pauseThreads;        // True if threads should pause
   bool        stopThreads;         // True if threads should stop
@@ -273,6 +301,8 @@ private:
   CThread     *ppcBrdThread;       // PPC main board thread
   CThread     *sndBrdThread;       // Sound board thread
   CThread     *drvBrdThread;       // Drive board thread
+  CThread     *dsbThread;          // DSB thread (runs alongside the sound board's SCSPs)
+  CThread     *netBrdThread;       // Net board thread
   bool        ppcBrdThreadRunning; // Flag to indicate PPC main board thread is currently processing
   bool        ppcBrdThreadDone;    // Flag to indicate PPC main board thread has finished processing
   bool        sndBrdThreadRunning; // Flag to indicate sound board thread is currently processing
@@ -280,6 +310,10 @@ private:
   bool        sndBrdWakeNotify;    // Flag to indicate that sound board thread has been woken by audio callback (when not sync'd with render thread)
   bool        drvBrdThreadRunning; // Flag to indicate drive board thread is currently processing
   bool        drvBrdThreadDone;    // Flag to indicate drive board thread has finished processing
+  bool        dsbThreadDone;       // Flag to indicate DSB thread has finished processing
+  bool        netBrdThreadRunning; // Flag to indicate net board thread is currently processing
+  bool        netBrdThreadDone;    // Flag to indicate net board thread has finished processing
+  bool        netBrdFramePending;  // Flag to indicate net board thread should run a frame next time the threads are woken
 
   // Thread synchronization objects
   CSemaphore  *ppcBrdThreadSync;
@@ -287,11 +321,16 @@ private:
   CMutex      *sndBrdNotifyLock;
   CCondVar    *sndBrdNotifySync;
   CSemaphore  *drvBrdThreadSync;
+  CSemaphore  *dsbThreadSync;
+  CSemaphore  *netBrdThreadSync;
   CMutex      *notifyLock;
   CCondVar    *notifySync;  
   
   // Frame timings
   FrameTimings timings;
+
+  // Main board event queue (times in PowerPC cycles)
+  CScheduler m_scheduler;
   
   // Other devices
   CIRQ        IRQ;            // Model 3 IRQ controller
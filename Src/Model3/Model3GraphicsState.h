@@ -72,8 +72,8 @@ public:
   void RenderFrame(void) override
   {
     BeginFrameVideo();
-    m_tileGen.BeginFrame();
-    m_real3D.BeginFrame();
+    m_tileGen.BeginFrame(0);  // snapshots are loaded with the state, nothing is published
+    m_real3D.BeginFrame(0);
     m_real3D.RenderFrame();
     m_real3D.EndFrame();
     m_tileGen.EndFrame();
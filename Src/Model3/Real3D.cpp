@@ -46,12 +46,18 @@
 #include "Util/BMPFile.h"
 #include <cstring>
 #include <algorithm>
+#ifdef __linux__
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 // Macros that divide memory regions into pages and mark them as dirty when they are written to
 #define PAGE_WIDTH 12
 #define PAGE_SIZE (1<<PAGE_WIDTH)
 #define DIRTY_SIZE(arraySize) (1+(arraySize-1)/(8*PAGE_SIZE))
 #define MARK_DIRTY(dirtyArray, addr) dirtyArray[addr>>(PAGE_WIDTH+3)] |= 1<<((addr>>PAGE_WIDTH)&7)
+#define IS_DIRTY(dirtyArray, page) (dirtyArray[(page)>>3] & (1<<((page)&7)))
 
 // Offsets of memory regions within Real3D memory pool
 #define OFFSET_8C           0x0000000 // 4 MB, culling RAM low (at 0x8C000000)
@@ -65,16 +71,69 @@
 #define OFFSET_98_RO        0x1700000 // 4 MB, polygon RAM (at 0x98000000)      [read-only snapshot]
 #define OFFSET_TEXRAM_RO    0x1B00000 // 8 MB, texture RAM                      [read-only snapshot]
 #define MEM_POOL_SIZE_RO    (0x400000+0x100000+0x400000+0x800000)
-#define OFFSET_8C_DIRTY     0x2300000
+#define NUM_SNAPSHOTS       2         // second snapshot follows first
+#define OFFSET_8C_DIRTY     0x3400000 // dirty page arrays for real memory, followed by those of each snapshot
 #define OFFSET_8E_DIRTY     (OFFSET_8C_DIRTY+DIRTY_SIZE(0x400000))
 #define OFFSET_98_DIRTY     (OFFSET_8E_DIRTY+DIRTY_SIZE(0x100000))
 #define OFFSET_TEXRAM_DIRTY (OFFSET_98_DIRTY+DIRTY_SIZE(0x400000))
 #define MEM_POOL_SIZE_DIRTY (DIRTY_SIZE(MEM_POOL_SIZE_RO))
-#define MEMORY_POOL_SIZE  (MEM_POOL_SIZE_RW+MEM_POOL_SIZE_RO+MEM_POOL_SIZE_DIRTY)
+#define MEMORY_POOL_SIZE  (MEM_POOL_SIZE_RW+NUM_SNAPSHOTS*MEM_POOL_SIZE_RO+(1+NUM_SNAPSHOTS)*MEM_POOL_SIZE_DIRTY)
 
 static void UpdateRenderConfig(IRender3D *Render3D, uint64_t internalRenderConfig[]);
 
 
+/******************************************************************************
+ Write Fault Tracking
+
+ With GPUWriteFaults (Linux only, multi-threaded GPU), the write handlers do
+ not mark pages dirty. Instead, live culling, polygon and texture RAM is kept
+ read-only between snapshot updates. The first write to a page faults, and the
+ handler marks the page dirty and makes it writable again. SyncSnapshots()
+ protects everything again once the dirty pages have been passed on to the
+ snapshots. Only one Real3D object exists at a time.
+******************************************************************************/
+
+#ifdef __linux__
+
+static uint8_t * volatile s_faultBase = NULL;   // live memory being tracked (NULL if none)
+static uint8_t * volatile s_faultDirty = NULL;  // dirty page arrays of live memory
+static size_t             s_osPageSize = PAGE_SIZE;
+static struct sigaction   s_prevSegvAction;
+
+static void WriteFaultHandler(int sig, siginfo_t *info, void *context)
+{
+  uint8_t *base = s_faultBase;
+  uint8_t *addr = (uint8_t *) info->si_addr;
+  if (base != NULL && addr >= base && addr < base + OFFSET_TEXFIFO)
+  {
+    // Mark all of our pages in the OS page, which may be larger
+    size_t start = (size_t) (addr - base) & ~(s_osPageSize - 1);
+    for (size_t offset = start; offset < start + s_osPageSize; offset += PAGE_SIZE)
+      MARK_DIRTY(s_faultDirty, offset);
+    if (mprotect(base + start, s_osPageSize, PROT_READ | PROT_WRITE) == 0)
+      return;
+  }
+
+  // Not ours: pass on to previous handler or let the faulting instruction crash when it is retried
+  if ((s_prevSegvAction.sa_flags & SA_SIGINFO) && s_prevSegvAction.sa_sigaction != NULL)
+    s_prevSegvAction.sa_sigaction(sig, info, context);
+  else if (!(s_prevSegvAction.sa_flags & SA_SIGINFO) && s_prevSegvAction.sa_handler != SIG_DFL && s_prevSegvAction.sa_handler != SIG_IGN)
+    s_prevSegvAction.sa_handler(sig);
+  else
+    signal(SIGSEGV, SIG_DFL);
+}
+
+#endif
+
+void CReal3D::ProtectMemory(bool readOnly)
+{
+#ifdef __linux__
+  if (m_writeFaults)
+    mprotect(memoryPool, OFFSET_TEXFIFO, readOnly ? PROT_READ : (PROT_READ | PROT_WRITE));
+#endif
+}
+
+
 /******************************************************************************
  Save States
 ******************************************************************************/
@@ -116,11 +175,18 @@ void CReal3D::LoadState(CBlockFile *SaveState)
     return;
   }
   
+  ProtectMemory(false);
   SaveState->Read(memoryPool, MEM_POOL_SIZE_RW);
 
   // If multi-threaded, update read-only snapshots too
   if (m_gpuMultiThreaded)
-    UpdateSnapshots(true);
+  {
+    uint32_t ranges = 0;
+    for (unsigned n = 0; n < NUM_SNAPSHOTS; n++)
+      UpdateSnapshots(true, n, ranges);
+    memset(cullingRAMLoDirty, 0, MEM_POOL_SIZE_DIRTY);
+    ProtectMemory(true);
+  }
   Render3D->UploadTextures(0, 0, 0, 2048, 2048);
   SaveState->Read(&fifoIdx, sizeof(fifoIdx));
   SaveState->Read(&m_vromTextureFIFO, sizeof(m_vromTextureFIFO));
@@ -182,8 +248,10 @@ void CReal3D::EndVBlank(void)
   error = false;  // clear error (just needs to be done once per frame)
 }
 
-uint32_t CReal3D::SyncSnapshots(void)
+uint32_t CReal3D::SyncSnapshots(unsigned frame, uint32_t &ranges)
 {
+  ranges = 0;
+
   // Update read-only copy of command port flag
   commandPortWrittenRO = commandPortWritten;
 #ifndef NEW_FRAME_TIMING
@@ -193,15 +261,45 @@ uint32_t CReal3D::SyncSnapshots(void)
   if (!m_gpuMultiThreaded)
     return 0;
 
-  // Update read-only queue
-  queuedUploadTexturesRO = queuedUploadTextures;
-  queuedUploadTextures.clear();
+  // Snapshots alternate with the frame number, so this uses the one not
+  // published last. The render thread only switches to the last published one
+  // in BeginFrame() and this is called once per frame rendered, so the other
+  // one cannot be in use.
+  unsigned n = frame % NUM_SNAPSHOTS;
 
-  // Update read-only snapshots
-  return UpdateSnapshots(false);
+  // Pages written this frame are dirty in both snapshots (the dirty page
+  // arrays of each region are contiguous)
+  for (unsigned i = 0; i < MEM_POOL_SIZE_DIRTY; i++)
+  {
+    for (unsigned s = 0; s < NUM_SNAPSHOTS; s++)
+      m_snapshot[s].cullingRAMLoDirty[i] |= cullingRAMLoDirty[i];
+  }
+  memset(cullingRAMLoDirty, 0, MEM_POOL_SIZE_DIRTY);
+  ProtectMemory(true);  // if tracking write faults, first write to each page from now on faults again
+
+  // Update read-only snapshot (the caller then publishes the frame to the render thread)
+  uint32_t copied = UpdateSnapshots(false, n, ranges);
+
+  // Pass on queued uploads, adding them to any the render thread has not performed yet
+  if (!queuedUploadTextures.empty())
+  {
+    for (auto &it : queuedUploadTextures)
+      it.frame = frame;
+    std::lock_guard<std::mutex> lock(m_publishedUploadsLock);
+    m_publishedUploads.insert(m_publishedUploads.end(), queuedUploadTextures.begin(), queuedUploadTextures.end());
+    queuedUploadTextures.clear();
+  }
+  return copied;
 }
 
-uint32_t CReal3D::UpdateSnapshot(bool copyWhole, uint8_t *src, uint8_t *dst, unsigned size, uint8_t *dirty)
+bool CReal3D::GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions)
+{
+  if (NULL == Render3D)
+    return false;
+  return Render3D->GetModelCacheStats(hitRate, residentPolys, evictions);
+}
+
+uint32_t CReal3D::UpdateSnapshot(bool copyWhole, uint8_t *src, uint8_t *dst, unsigned size, uint8_t *dirty, uint32_t &ranges)
 {
   unsigned dirtySize = DIRTY_SIZE(size);
   if (copyWhole)
@@ -209,66 +307,95 @@ uint32_t CReal3D::UpdateSnapshot(bool copyWhole, uint8_t *src, uint8_t *dst, uns
     // If updating whole region, then just copy all data in one go
     memcpy(dst, src, size);
     memset(dirty, 0, dirtySize);
+    ++ranges;
     return size;
   }
   else
   {
-    // Otherwise, loop through dirty pages array to find out what needs to be updated and copy only those parts
+    // Otherwise, scan dirty pages array for runs of dirty pages and copy each run in one go
     uint32_t copied = 0;
-    uint8_t *pSrc = src;
-    uint8_t *pDst = dst;
-    for (unsigned i = 0; i < dirtySize; i++)
+    unsigned numPages = dirtySize * 8;
+    unsigned page = 0;
+    while (page < numPages)
     {
-      uint8_t d = dirty[i];
-      if (d)
+      // Skip clean pages 64 (then 8) at a time
+      if ((page & 63) == 0 && page + 64 <= numPages)
       {
-        for (unsigned j = 0; j < 8; j++)
+        uint64_t d;
+        memcpy(&d, &dirty[page >> 3], sizeof(d));
+        if (!d)
         {
-          if (d&1)
-          {
-            // If not at very end of region, then copy an extra 4 bytes to allow for a possible 32-bit overlap
-            uint32_t toCopy = (i < dirtySize - 1 || j < 7 ? PAGE_SIZE + 4 : PAGE_SIZE);
-            memcpy(pDst, pSrc, toCopy);
-            copied += toCopy;
-          }
-          d >>= 1;
-          pSrc += PAGE_SIZE;  
-          pDst += PAGE_SIZE;
+          page += 64;
+          continue;
         }
-        dirty[i] = 0;
       }
-      else
+      if ((page & 7) == 0 && !dirty[page >> 3])
+      {
+        page += 8;
+        continue;
+      }
+      if (!IS_DIRTY(dirty, page))
       {
-        pSrc += 8 * PAGE_SIZE;  
-        pDst += 8 * PAGE_SIZE;
+        ++page;
+        continue;
       }
+
+      // Find end of run
+      unsigned end = page + 1;
+      while (end < numPages && IS_DIRTY(dirty, end))
+        ++end;
+
+      // If not at very end of region, then copy an extra 4 bytes to allow for a possible 32-bit overlap
+      unsigned start = page * PAGE_SIZE;
+      unsigned toCopy = std::min(end * PAGE_SIZE + 4, size) - start;
+      memcpy(dst + start, src + start, toCopy);
+      copied += toCopy;
+      ++ranges;
+      page = end;
     }
+    memset(dirty, 0, dirtySize);
     return copied;
   }
 }
 
-uint32_t CReal3D::UpdateSnapshots(bool copyWhole)
+uint32_t CReal3D::UpdateSnapshots(bool copyWhole, unsigned n, uint32_t &ranges)
 {
   // Update all memory region snapshots
-  uint32_t cullLoCopied  = UpdateSnapshot(copyWhole, (uint8_t*)cullingRAMLo, (uint8_t*)cullingRAMLoRO, 0x400000, cullingRAMLoDirty);
-  uint32_t cullHiCopied  = UpdateSnapshot(copyWhole, (uint8_t*)cullingRAMHi, (uint8_t*)cullingRAMHiRO, 0x100000, cullingRAMHiDirty);
-  uint32_t polyCopied    = UpdateSnapshot(copyWhole, (uint8_t*)polyRAM,      (uint8_t*)polyRAMRO,      0x400000, polyRAMDirty);
-  uint32_t textureCopied = UpdateSnapshot(copyWhole, (uint8_t*)textureRAM,   (uint8_t*)textureRAMRO,   0x800000, textureRAMDirty);
+  Snapshot &s = m_snapshot[n];
+  uint32_t cullLoCopied  = UpdateSnapshot(copyWhole, (uint8_t*)cullingRAMLo, (uint8_t*)s.cullingRAMLo, 0x400000, s.cullingRAMLoDirty, ranges);
+  uint32_t cullHiCopied  = UpdateSnapshot(copyWhole, (uint8_t*)cullingRAMHi, (uint8_t*)s.cullingRAMHi, 0x100000, s.cullingRAMHiDirty, ranges);
+  uint32_t polyCopied    = UpdateSnapshot(copyWhole, (uint8_t*)polyRAM,      (uint8_t*)s.polyRAM,      0x400000, s.polyRAMDirty, ranges);
+  uint32_t textureCopied = UpdateSnapshot(copyWhole, (uint8_t*)textureRAM,   (uint8_t*)s.textureRAM,   0x800000, s.textureRAMDirty, ranges);
   //printf("Read3D copied - cullLo:%4uK, cullHi:%4uK, poly:%4uK, texture:%4uK\n", cullLoCopied / 1024, cullHiCopied / 1024, polyCopied / 1024, textureCopied / 1024);
   return cullLoCopied + cullHiCopied + polyCopied + textureCopied;
 }
 
-void CReal3D::BeginFrame(void)
+void CReal3D::BeginFrame(unsigned frame)
 {
-  // If multi-threaded, perform now any queued texture uploads to renderer before rendering begins
-  if (m_gpuMultiThreaded)
+  if (m_gpuMultiThreaded && frame > 0)
   {
-  for (const auto &it : queuedUploadTexturesRO) {
-      Render3D->UploadTextures(it.level, it.x, it.y, it.width, it.height);
-  }
+    // Switch renderer over to the snapshot of the given frame
+    int n = frame % NUM_SNAPSHOTS;
+    if (n != m_snapshotFront)
+    {
+      const Snapshot &s = m_snapshot[n];
+      Render3D->AttachMemory(s.cullingRAMLo, s.cullingRAMHi, s.polyRAM, vrom, s.textureRAM);
+      m_snapshotFront = n;
+    }
+
+    // Take the texture uploads made up to that frame (later ones are for a snapshot not published yet)
+    {
+      std::lock_guard<std::mutex> lock(m_publishedUploadsLock);
+      auto end = std::find_if(m_publishedUploads.begin(), m_publishedUploads.end(), [frame](const QueuedUploadTextures &it) { return it.frame > frame; });
+      m_frameUploads.assign(m_publishedUploads.begin(), end);
+      m_publishedUploads.erase(m_publishedUploads.begin(), end);
+    }
 
-  // done syncing data
-  queuedUploadTexturesRO.clear();
+    // Perform them now before rendering begins
+    for (const auto &it : m_frameUploads) {
+      Render3D->UploadTextures(it.level, it.x, it.y, it.width, it.height);
+    }
+    m_frameUploads.clear();
   }
 
   Render3D->BeginFrame();
@@ -351,6 +478,9 @@ void CReal3D::StoreTexture(unsigned level, unsigned xPos, unsigned yPos, unsigne
   uint32_t tileX = (std::min)(8u, width);
   uint32_t tileY = (std::min)(8u, height);
 
+  // Dirty pages are marked once per line of a tile rather than for every texel. A line is at most 8 texels, so
+  // marking its first and last texels covers every page it touches.
+
   texDataOffset = 0;
 
   if (sixteenBit)  // 16-bit textures
@@ -364,10 +494,13 @@ void CReal3D::StoreTexture(unsigned level, unsigned xPos, unsigned yPos, unsigne
         uint32_t destOffset = y * 2048 + x;
         for (uint32_t yy = 0; yy < tileY; yy++)
         {
+          if (m_gpuMultiThreaded && !m_writeFaults)
+          {
+            MARK_DIRTY(textureRAMDirty, destOffset * 2);
+            MARK_DIRTY(textureRAMDirty, (destOffset + tileX - 1) * 2);
+          }
           for (uint32_t xx = 0; xx < tileX; xx++)
           { 
-            if (m_gpuMultiThreaded)
-              MARK_DIRTY(textureRAMDirty, destOffset * 2);
             if (tileX == 1) texData -= tileY;
             if (tileY == 1) texData -= tileX;
             if (tileX == 8)
@@ -409,11 +542,14 @@ void CReal3D::StoreTexture(unsigned level, unsigned xPos, unsigned yPos, unsigne
         uint32_t destOffset = y * 2048 + x;
         for (uint32_t yy = 0; yy < tileY; yy++)
         {
+          if (m_gpuMultiThreaded && !m_writeFaults && (writeLSB | writeMSB))
+          {
+            MARK_DIRTY(textureRAMDirty, destOffset * 2);
+            MARK_DIRTY(textureRAMDirty, (destOffset + tileX - 1) * 2);
+          }
           for (uint32_t xx = 0; xx < tileX; xx++)
           {
             if (writeLSB | writeMSB) {
-              if (m_gpuMultiThreaded)
-                MARK_DIRTY(textureRAMDirty, destOffset * 2);
               textureRAM[destOffset] &= byteMask[byteSelect];
               const uint8_t shift = (8 * ((xx & 1) ^ 1));
               const uint8_t index = (yy ^ 1) * tileX + (xx ^ 1) - (tileX & 1);
@@ -453,6 +589,7 @@ void CReal3D::StoreTexture(unsigned level, unsigned xPos, unsigned yPos, unsigne
     upl.y = yPos;
     upl.width = width;
     upl.height = height;
+    upl.frame = 0;  // set when passed on to render thread
     queuedUploadTextures.push_back(upl);
   }
   else
@@ -536,10 +673,91 @@ void CReal3D::UploadTexture(uint32_t header, const uint16_t *texData)
   IRQ:  IRQ pending.
 ******************************************************************************/
 
+/*
+ * Copies from RAM to Real3D memory without going through the bus, which is
+ * the common case. Must give the same result as writing each word with
+ * Bus->Write32(), which flips the endianness of words written to the Real3D
+ * (so byte reversed transfers are stored as they are in RAM). Returns false,
+ * without copying anything, if the transfer is not entirely from RAM into a
+ * single Real3D memory region.
+ */
+bool CReal3D::DMACopyDirect(void)
+{
+  if (ram == NULL || dmaLength == 0 || ((dmaSrc | dmaDest) & 3) || dmaLength > (ramSize / 4))
+    return false;
+  uint32_t numBytes = dmaLength * 4;
+  if (dmaSrc > ramSize - numBytes)
+    return false;
+  if (((dmaDest + numBytes - 1) >> 24) != (dmaDest >> 24))
+    return false;
+
+  // Find destination
+  uint32_t *dest;
+  uint8_t *dirty = NULL;
+  uint32_t offset;
+  switch (dmaDest >> 24)
+  {
+  case 0x8C:  // low culling RAM
+    offset = dmaDest & 0x3FFFFF;
+    if (offset + numBytes > 0x400000)
+      return false;
+    dest = &cullingRAMLo[offset / 4];
+    dirty = cullingRAMLoDirty;
+    break;
+  case 0x8E:  // high culling RAM
+    offset = dmaDest & 0xFFFFF;
+    if (offset + numBytes > 0x100000)
+      return false;
+    dest = &cullingRAMHi[offset / 4];
+    dirty = cullingRAMHiDirty;
+    break;
+  case 0x98:  // polygon RAM
+    offset = dmaDest & 0x3FFFFF;
+    if (offset + numBytes > 0x400000)
+      return false;
+    dest = &polyRAM[offset / 4];
+    dirty = polyRAMDirty;
+    break;
+  case 0x94:  // texture FIFO (all words are written to the FIFO regardless of address)
+    if (fifoIdx + dmaLength > (0x100000/4))
+      return false; // let WriteTextureFIFO() report the overflow
+    offset = 0;
+    dest = &textureFIFO[fifoIdx];
+    fifoIdx += dmaLength;
+    break;
+  default:
+    return false;
+  }
+
+  // Mark every page touched as dirty
+  if (m_gpuMultiThreaded && !m_writeFaults && dirty != NULL)
+  {
+    for (uint32_t addr = offset & ~(PAGE_SIZE - 1); addr < offset + numBytes; addr += PAGE_SIZE)
+      MARK_DIRTY(dirty, addr);
+  }
+
+  // Copy, flipping the endianness of each word unless transfer is byte reversed
+  const uint32_t *src = (const uint32_t *) &ram[dmaSrc];
+  if ((dmaConfig&0x80))
+    memcpy(dest, src, numBytes);
+  else
+  {
+    for (uint32_t i = 0; i < dmaLength; i++)
+      dest[i] = FLIPENDIAN32(src[i]);
+  }
+
+  dmaSrc += numBytes;
+  dmaDest += numBytes;
+  dmaLength = 0;
+  return true;
+}
+
 void CReal3D::DMACopy(void)
 {
   DebugLog("Real3D DMA copy (PC=%08X, LR=%08X): %08X -> %08X, %X %s\n", ppc_get_pc(), ppc_get_lr(), dmaSrc, dmaDest, dmaLength*4, (dmaConfig&0x80)?"(byte reversed)":"");
   //printf("Real3D DMA copy (PC=%08X, LR=%08X): %08X -> %08X, %X %s\n", ppc_get_pc(), ppc_get_lr(), dmaSrc, dmaDest, dmaLength*4, (dmaConfig&0x80)?"(byte reversed)":""); 
+  if (DMACopyDirect())
+    return;
   if ((dmaConfig&0x80)) // reverse bytes
   {
     while (dmaLength != 0)
@@ -728,21 +946,21 @@ void CReal3D::WriteTexturePort(unsigned reg, uint32_t data)
 
 void CReal3D::WriteLowCullingRAM(uint32_t addr, uint32_t data)
 {
-  if (m_gpuMultiThreaded)
+  if (m_gpuMultiThreaded && !m_writeFaults)
     MARK_DIRTY(cullingRAMLoDirty, addr);
   cullingRAMLo[addr/4] = data;
 }
 
 void CReal3D::WriteHighCullingRAM(uint32_t addr, uint32_t data)
 {
-  if (m_gpuMultiThreaded)
+  if (m_gpuMultiThreaded && !m_writeFaults)
     MARK_DIRTY(cullingRAMHiDirty, addr);
   cullingRAMHi[addr/4] = data;
 }
 
 void CReal3D::WritePolygonRAM(uint32_t addr, uint32_t data)
 {
-  if (m_gpuMultiThreaded)
+  if (m_gpuMultiThreaded && !m_writeFaults)
     MARK_DIRTY(polyRAMDirty, addr);
   polyRAM[addr/4] = data;
 }
@@ -827,7 +1045,10 @@ void CReal3D::Reset(void)
   commandPortWrittenRO = false;
 
   queuedUploadTextures.clear();
-  queuedUploadTexturesRO.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_publishedUploadsLock);
+    m_publishedUploads.clear();
+  }
 
   fifoIdx = 0;
   m_vromTextureFIFOIdx = 0;
@@ -835,7 +1056,9 @@ void CReal3D::Reset(void)
   dmaUnknownReg = 0;
   
   unsigned memSize = (m_gpuMultiThreaded ? MEMORY_POOL_SIZE : MEM_POOL_SIZE_RW);
+  ProtectMemory(false);
   memset(memoryPool, 0, memSize);
+  ProtectMemory(true);
   memset(m_vromTextureFIFO, 0, sizeof(m_vromTextureFIFO));
   memset(m_internalRenderConfig, 0, sizeof(m_internalRenderConfig));
 
@@ -853,7 +1076,10 @@ void CReal3D::AttachRenderer(IRender3D *Render3DPtr)
 
   // If mult-threaded, attach read-only snapshots to renderer instead of real ones
   if (m_gpuMultiThreaded)
-    Render3D->AttachMemory(cullingRAMLoRO, cullingRAMHiRO, polyRAMRO, vrom, textureRAMRO);
+  {
+    const Snapshot &s = m_snapshot[m_snapshotFront];
+    Render3D->AttachMemory(s.cullingRAMLo, s.cullingRAMHi, s.polyRAM, vrom, s.textureRAM);
+  }
   else
     Render3D->AttachMemory(cullingRAMLo, cullingRAMHi, polyRAM, vrom, textureRAM);
 
@@ -926,7 +1152,7 @@ void CReal3D::SetStepping(int stepping)
   DebugLog("Real3D set to Step %d.%d\n", (step>>4)&0xF, step&0xF);
 }
 
-bool CReal3D::Init(const uint8_t *vromPtr, IBus *BusObjectPtr, CIRQ *IRQObjectPtr, unsigned dmaIRQBit)
+bool CReal3D::Init(const uint8_t *vromPtr, const uint8_t *ramPtr, uint32_t ramSizeBytes, IBus *BusObjectPtr, CIRQ *IRQObjectPtr, unsigned dmaIRQBit)
 {
   uint32_t memSize = (m_config["GPUMultiThreaded"].ValueAs<bool>() ? MEMORY_POOL_SIZE : MEM_POOL_SIZE_RW);
   float  memSizeMB = (float)memSize/(float)0x100000;
@@ -935,9 +1161,19 @@ bool CReal3D::Init(const uint8_t *vromPtr, IBus *BusObjectPtr, CIRQ *IRQObjectPt
   Bus = BusObjectPtr; 
   IRQ = IRQObjectPtr;
   dmaIRQ = dmaIRQBit;
+  ram = ramPtr;
+  ramSize = ramSizeBytes;
     
-  // Allocate all Real3D RAM regions
-  memoryPool = new(std::nothrow) uint8_t[memSize];
+  // Allocate all Real3D RAM regions (page aligned if it is to be write protected)
+#ifdef __linux__
+  if (m_writeFaults)
+  {
+    void *pool = mmap(NULL, memSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    memoryPool = (pool == MAP_FAILED) ? NULL : (uint8_t *) pool;
+  }
+  else
+#endif
+    memoryPool = new(std::nothrow) uint8_t[memSize];
   if (NULL == memoryPool)
     return ErrorLog("Insufficient memory for Real3D object (needs %1.1f MB).", memSizeMB);
   
@@ -951,15 +1187,47 @@ bool CReal3D::Init(const uint8_t *vromPtr, IBus *BusObjectPtr, CIRQ *IRQObjectPt
   // If multi-threaded, set up pointers for read-only snapshots and dirty page arrays too
   if (m_gpuMultiThreaded)
   {
-    cullingRAMLoRO = (uint32_t *) &memoryPool[OFFSET_8C_RO];
-    cullingRAMHiRO = (uint32_t *) &memoryPool[OFFSET_8E_RO];
-    polyRAMRO = (uint32_t *) &memoryPool[OFFSET_98_RO];
-    textureRAMRO = (uint16_t *) &memoryPool[OFFSET_TEXRAM_RO];
     cullingRAMLoDirty = (uint8_t *) &memoryPool[OFFSET_8C_DIRTY];
     cullingRAMHiDirty = (uint8_t *) &memoryPool[OFFSET_8E_DIRTY];
     polyRAMDirty = (uint8_t *) &memoryPool[OFFSET_98_DIRTY];
     textureRAMDirty = (uint8_t *) &memoryPool[OFFSET_TEXRAM_DIRTY];
+    for (unsigned n = 0; n < NUM_SNAPSHOTS; n++)
+    {
+      Snapshot &s = m_snapshot[n];
+      unsigned roOffset = n * MEM_POOL_SIZE_RO;
+      unsigned dirtyOffset = (n + 1) * MEM_POOL_SIZE_DIRTY;
+      s.cullingRAMLo = (uint32_t *) &memoryPool[OFFSET_8C_RO + roOffset];
+      s.cullingRAMHi = (uint32_t *) &memoryPool[OFFSET_8E_RO + roOffset];
+      s.polyRAM = (uint32_t *) &memoryPool[OFFSET_98_RO + roOffset];
+      s.textureRAM = (uint16_t *) &memoryPool[OFFSET_TEXRAM_RO + roOffset];
+      s.cullingRAMLoDirty = (uint8_t *) &memoryPool[OFFSET_8C_DIRTY + dirtyOffset];
+      s.cullingRAMHiDirty = (uint8_t *) &memoryPool[OFFSET_8E_DIRTY + dirtyOffset];
+      s.polyRAMDirty = (uint8_t *) &memoryPool[OFFSET_98_DIRTY + dirtyOffset];
+      s.textureRAMDirty = (uint8_t *) &memoryPool[OFFSET_TEXRAM_DIRTY + dirtyOffset];
+    }
+  }
+
+#ifdef __linux__
+  // Install write fault handler and protect live memory
+  if (m_writeFaults)
+  {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_sigaction = WriteFaultHandler;
+    action.sa_flags = SA_SIGINFO;
+    s_osPageSize = std::max<size_t>(sysconf(_SC_PAGESIZE), PAGE_SIZE);
+    s_faultDirty = cullingRAMLoDirty;
+    s_faultBase = memoryPool;
+    if (sigaction(SIGSEGV, &action, &s_prevSegvAction) != 0)
+    {
+      s_faultBase = NULL;
+      return ErrorLog("Unable to install Real3D write fault handler.");
+    }
+    ProtectMemory(true);
+    InfoLog("Real3D dirty pages tracked by write faults.");
   }
+#endif
   
   // VROM pointer passed to us
   vrom = (uint32_t *) vromPtr;
@@ -970,8 +1238,12 @@ bool CReal3D::Init(const uint8_t *vromPtr, IBus *BusObjectPtr, CIRQ *IRQObjectPt
 
 CReal3D::CReal3D(const Util::Config::Node &config)
   : m_config(config),
-    m_gpuMultiThreaded(config["GPUMultiThreaded"].ValueAs<bool>())
+    m_gpuMultiThreaded(config["GPUMultiThreaded"].ValueAs<bool>()),
+    m_writeFaults(false)
 { 
+#ifdef __linux__
+  m_writeFaults = m_gpuMultiThreaded && config["GPUWriteFaults"].ValueAsDefault<bool>(false);
+#endif
   Render3D = NULL;
   memoryPool = NULL;
   cullingRAMLo = NULL;
@@ -980,6 +1252,8 @@ CReal3D::CReal3D(const Util::Config::Node &config)
   textureRAM = NULL;
   textureFIFO = NULL;
   vrom = NULL;
+  ram = NULL;
+  ramSize = 0;
   error = false;
   fifoIdx = 0;
   m_vromTextureFIFO[0] = 0;
@@ -987,6 +1261,7 @@ CReal3D::CReal3D(const Util::Config::Node &config)
   m_vromTextureFIFOIdx = 0;
   m_internalRenderConfig[0] = 0;
   m_internalRenderConfig[1] = 0;
+  m_snapshotFront = 0;
   DebugLog("Built Real3D\n");
 }
 
@@ -1043,7 +1318,19 @@ Util::WriteSurfaceToBMP<Util::A1RGB5>("textures.bmp", reinterpret_cast<uint8_t *
   Render3D = NULL;
   if (memoryPool != NULL)
   {
-    delete [] memoryPool;
+#ifdef __linux__
+    if (m_writeFaults)
+    {
+      if (s_faultBase == memoryPool)
+      {
+        s_faultBase = NULL;
+        sigaction(SIGSEGV, &s_prevSegvAction, NULL);
+      }
+      munmap(memoryPool, MEMORY_POOL_SIZE);
+    }
+    else
+#endif
+      delete [] memoryPool;
     memoryPool = NULL;
   }
   cullingRAMLo = NULL;
@@ -31,6 +31,8 @@
 
 #include <cstdint>
 #include <map>
+#include <mutex>
+#include <vector>
 
 /* 
  * QueuedUploadTextures:
@@ -46,6 +48,7 @@ struct QueuedUploadTextures
   unsigned y;
   unsigned width;
   unsigned height;
+  unsigned frame;   // frame whose snapshot holds the texture data
 };
 
 /*
@@ -109,24 +112,59 @@ public:
   void EndVBlank(void);
 
   /*
-   * SyncSnapshots(void):
+   * SyncSnapshots(frame, ranges):
    *
-   * Syncs the read-only memory snapshots with the real ones so that rendering
-   * of the current frame can begin in the render thread.  Must be called at the
-   * end of each frame when both the render thread and the PPC thread have finished
-   * their work.  If multi-threaded rendering is not enabled, then this method does
-   * nothing.
+   * Copies the pages written during the frame into the read-only snapshot for
+   * the given frame number, which is not in use by the render thread, and
+   * passes on the texture uploads made during it.  Must be called by the PPC
+   * thread at the end of each frame, and may run while the render thread is
+   * still drawing the previous snapshot.  If multi-threaded rendering is not
+   * enabled, then this method does nothing.
+   *
+   * Snapshots are paired per frame: the caller publishes the frame number
+   * only once both this and the tile generator's snapshots are updated, and
+   * the render thread passes the same number to both BeginFrame() calls.
+   *
+   * Runs of adjacent dirty pages are copied together.
+   *
+   * Parameters:
+   *    frame   Frame number, counting from 1.
+   *    ranges  Set to the number of separate memory ranges copied.
+   *
+   * Returns:
+   *    Number of bytes copied.
+   */
+  uint32_t SyncSnapshots(unsigned frame, uint32_t &ranges);
+
+  /*
+   * GetModelCacheStats(hitRate, residentPolys, evictions):
+   *
+   * Gets the attached renderer's model cache statistics for the last frame
+   * rendered.  Must be called by the render thread.
+   *
+   * Parameters:
+   *    hitRate       Set to the fraction of models found in the cache.
+   *    residentPolys Set to the number of polys in the cache.
+   *    evictions     Set to the number of models evicted to make room.
+   *
+   * Returns:
+   *    False if there is no renderer or it has no model cache.
    */
-  uint32_t SyncSnapshots(void);
+  bool GetModelCacheStats(float *hitRate, unsigned *residentPolys, unsigned *evictions);
 
   /*
-   * BeginFrame(void):
+   * BeginFrame(frame):
    *
    * Prepares to render a new frame.  Must be called once per frame prior to
    * drawing anything and must only access read-only snapshots and variables
-   * since it may be running in a separate thread.
+   * since it may be running in a separate thread.  If multi-threaded, switches
+   * the renderer over to the snapshot of the given frame and performs the
+   * texture uploads made up to it.
+   *
+   * Parameters:
+   *    frame   Most recently published frame number (0 if none yet).
    */
-  void BeginFrame(void);
+  void BeginFrame(unsigned frame);
   
   /*
    * RenderFrame(void):
@@ -365,7 +403,7 @@ public:
   void SetStepping(int stepping);
   
   /*
-   * Init(vromPtr, BusObjectPtr, IRQObjectPtr, dmaIRQBit):
+   * Init(vromPtr, ramPtr, ramSize, BusObjectPtr, IRQObjectPtr, dmaIRQBit):
    *
    * One-time initialization of the context. Must be called prior to all
    * other members. Connects the Real3D device to its video ROM and allocates
@@ -374,6 +412,10 @@ public:
    * Parameters:
    *    vromPtr       A pointer to video ROM (with each 32-bit word in
    *                  its native little endian format).
+   *    ramPtr        A pointer to PowerPC RAM at address 0, as seen through
+   *                  BusObjectPtr's Read32(). DMA copies from it are done
+   *                  directly rather than through the bus. May be NULL.
+   *    ramSize       Size of RAM in bytes.
    *    BusObjectPtr  Pointer to the bus that the 53C810 has control
    *                  over. Used to read/write memory.
    *    IRQObjectPtr  Pointer to the IRQ controller. Used to trigger SCSI
@@ -385,7 +427,7 @@ public:
    *    OKAY if successful otherwise FAIL (not enough memory). Prints own
    *    errors.
    */
-  bool Init(const uint8_t *vromPtr, IBus *BusObjectPtr, CIRQ *IRQObjectPtr, unsigned dmaIRQBit);
+  bool Init(const uint8_t *vromPtr, const uint8_t *ramPtr, uint32_t ramSize, IBus *BusObjectPtr, CIRQ *IRQObjectPtr, unsigned dmaIRQBit);
    
   /*
    * CReal3D(config):
@@ -403,18 +445,21 @@ public:
 private:
   // Private member functions
   void      DMACopy(void);
+  bool      DMACopyDirect(void);
   void      InsertBit(uint8_t *buf, unsigned bitNum, unsigned bit);
   void      InsertID(uint32_t id, unsigned startBit);
   unsigned  Shift(uint8_t *data, unsigned numBits);
   void      StoreTexture(unsigned level, unsigned xPos, unsigned yPos, unsigned width, unsigned height, const uint16_t *texData, bool sixteenBit, bool writeLSB, bool writeMSB, uint32_t &texDataOffset);
 
   void      UploadTexture(uint32_t header, const uint16_t *texData);
-  uint32_t  UpdateSnapshots(bool copyWhole);
-  uint32_t  UpdateSnapshot(bool copyWhole, uint8_t *src, uint8_t *dst, unsigned size, uint8_t *dirty);
+  uint32_t  UpdateSnapshots(bool copyWhole, unsigned n, uint32_t &ranges);
+  uint32_t  UpdateSnapshot(bool copyWhole, uint8_t *src, uint8_t *dst, unsigned size, uint8_t *dirty, uint32_t &ranges);
+  void      ProtectMemory(bool readOnly);
 
   // Config 
   const Util::Config::Node &m_config;
   const bool                m_gpuMultiThreaded;
+  bool                      m_writeFaults;  // dirty pages of live memory found by write faults rather than marked by write handlers
 
   // Renderer attached to the Real3D
   IRender3D *Render3D;
@@ -438,12 +483,6 @@ private:
   uint32_t  m_vromTextureFIFO[2];
   uint32_t  m_vromTextureFIFOIdx;
   
-  // Read-only snapshots
-  uint32_t  *cullingRAMLoRO;    // 4MB of culling RAM at 8C000000 [read-only snapshot]
-  uint32_t  *cullingRAMHiRO;    // 1MB of culling RAM at 8E000000 [read-only snapshot]
-  uint32_t  *polyRAMRO;         // 4MB of polygon RAM at 98000000 [read-only snapshot]
-  uint16_t  *textureRAMRO;      // 8MB of internal texture RAM    [read-only snapshot]
-  
   // Arrays to keep track of dirty pages in memory regions
   uint8_t   *cullingRAMLoDirty;
   uint8_t   *cullingRAMHiDirty;
@@ -452,10 +491,43 @@ private:
 
   // Queued texture uploads
   std::vector<QueuedUploadTextures> queuedUploadTextures;
-  std::vector<QueuedUploadTextures> queuedUploadTexturesRO;  // Read-only copy of queue
+
+  /*
+   * Read-only snapshots. There are two of them so that the PPC thread can
+   * update one at the end of a frame while the render thread is still drawing
+   * the other. Each keeps its own record of the pages that have changed since
+   * it was last updated, because it misses every other frame.
+   */
+  struct Snapshot
+  {
+    uint32_t  *cullingRAMLo;    // 4MB of culling RAM at 8C000000 [read-only snapshot]
+    uint32_t  *cullingRAMHi;    // 1MB of culling RAM at 8E000000 [read-only snapshot]
+    uint32_t  *polyRAM;         // 4MB of polygon RAM at 98000000 [read-only snapshot]
+    uint16_t  *textureRAM;      // 8MB of internal texture RAM    [read-only snapshot]
+    uint8_t   *cullingRAMLoDirty;
+    uint8_t   *cullingRAMHiDirty;
+    uint8_t   *polyRAMDirty;
+    uint8_t   *textureRAMDirty;
+  };
+  Snapshot          m_snapshot[2];
+  int               m_snapshotFront;  // snapshot attached to renderer [render thread only]
+
+  /*
+   * Texture uploads passed on with the snapshots that the render thread has
+   * not performed yet, in frame order. BeginFrame() only takes those up to
+   * the frame it is given, so uploads are never left behind when a render is
+   * skipped, nor performed before the snapshot holding their texture data.
+   */
+  std::vector<QueuedUploadTextures> m_publishedUploads;  // [guarded by m_publishedUploadsLock]
+  std::mutex                        m_publishedUploadsLock;
+  std::vector<QueuedUploadTextures> m_frameUploads;      // uploads being performed [render thread only]
   
   // Big endian bus object for DMA memory access
   IBus  *Bus;
+
+  // PowerPC RAM for direct DMA access
+  const uint8_t *ram;
+  uint32_t      ramSize;
   
   // IRQ handling
   CIRQ    *IRQ;   // IRQ controller
@@ -0,0 +1,63 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011-2017 Bart Trzynadlowski, Nik Henson, Ian Curtis
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free 
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+ 
+/*
+ * Scheduler.cpp
+ * 
+ * Implementation of the CScheduler class: a queue of timed events.
+ */
+
+#include "Model3/Scheduler.h"
+#include <algorithm>
+
+
+void CScheduler::Schedule(unsigned id, uint64_t time)
+{
+  // Insert before all events due at the same time or later so that among
+  // events due at the same time, the one scheduled first is popped first
+  auto it = std::find_if(m_events.begin(), m_events.end(), [time](const Event &e) { return e.time <= time; });
+  m_events.insert(it, { time, id });
+}
+
+bool CScheduler::Cancel(unsigned id)
+{
+  auto it = std::remove_if(m_events.begin(), m_events.end(), [id](const Event &e) { return e.id == id; });
+  bool found = it != m_events.end();
+  m_events.erase(it, m_events.end());
+  return found;
+}
+
+void CScheduler::Clear(void)
+{
+  m_events.clear();
+}
+
+uint64_t CScheduler::NextTime(void) const
+{
+  return m_events.back().time;
+}
+
+unsigned CScheduler::Pop(void)
+{
+  unsigned id = m_events.back().id;
+  m_events.pop_back();
+  return id;
+}
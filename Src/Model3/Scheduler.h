@@ -0,0 +1,109 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011-2017 Bart Trzynadlowski, Nik Henson, Ian Curtis
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free 
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+ 
+/*
+ * Scheduler.h
+ * 
+ * Header file defining the CScheduler class: a queue of timed events.
+ */
+
+#ifndef INCLUDED_SCHEDULER_H
+#define INCLUDED_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * CScheduler:
+ *
+ * Keeps events ordered by the time at which they are due. Times are absolute
+ * and in whatever unit the owner uses (the main board uses PowerPC cycles, as
+ * returned by ppc_total_cycles()), so that a CPU can be run exactly up to the
+ * next event. Events due at the same time are returned in the order they were
+ * scheduled. What an event does is up to the owner; the scheduler only tracks
+ * its identifier.
+ */
+class CScheduler
+{
+public:
+  /*
+   * Schedule(id, time):
+   *
+   * Adds an event. An event with the same identifier may already be pending,
+   * in which case both will be returned.
+   *
+   * Parameters:
+   *    id    Identifier of event.
+   *    time  Time at which event is due.
+   */
+  void Schedule(unsigned id, uint64_t time);
+
+  /*
+   * Cancel(id):
+   *
+   * Removes all pending events with the given identifier.
+   *
+   * Returns:
+   *    True if any were pending.
+   */
+  bool Cancel(unsigned id);
+
+  /*
+   * Clear(void):
+   *
+   * Removes all pending events.
+   */
+  void Clear(void);
+
+  /*
+   * NextTime(void):
+   *
+   * Returns:
+   *    Time at which the earliest pending event is due. Must not be called if
+   *    the queue is empty.
+   */
+  uint64_t NextTime(void) const;
+
+  /*
+   * Pop(void):
+   *
+   * Removes the earliest pending event. Must not be called if the queue is
+   * empty.
+   *
+   * Returns:
+   *    Identifier of event.
+   */
+  unsigned Pop(void);
+
+private:
+  struct Event
+  {
+    uint64_t time;
+    unsigned id;
+  };
+
+  // Sorted by time, latest first, so that the earliest event can be popped
+  // off the end. Only a handful of events are ever pending at once.
+  std::vector<Event> m_events;
+};
+
+
+#endif  // INCLUDED_SCHEDULER_H
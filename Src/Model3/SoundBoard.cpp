@@ -337,7 +337,15 @@ void CSoundBoard::WriteMIDIPort(UINT8 data)
 
 bool CSoundBoard::RunFrame(void)
 {
-	// Run sound board first to generate SCSP audio
+	// Run sound board first to generate SCSP audio, then DSB
+	RunSCSPFrame();
+	if (NULL != DSB)
+		DSB->RunFrame();
+	return OutputFrame();
+}
+
+void CSoundBoard::RunSCSPFrame(void)
+{
 	if (m_config["EmulateSound"].ValueAs<bool>())
 	{
 		M68KSetContext(&M68K);
@@ -349,10 +357,13 @@ bool CSoundBoard::RunFrame(void)
 		memset(audioL, 0, 44100/60*sizeof(INT16));
 		memset(audioR, 0, 44100/60*sizeof(INT16));
 	}
-	
-	// Run DSB and mix with existing audio
+}
+
+bool CSoundBoard::OutputFrame(void)
+{
+	// Mix DSB with existing audio
 	if (NULL != DSB)
-		DSB->RunFrame(audioL, audioR);
+		DSB->MixFrame(audioL, audioR);
 
 	// Output the audio buffers
 	bool bufferFull = OutputAudio(44100/60, audioL, audioR, m_config["FlipStereo"].ValueAs<bool>());
@@ -109,9 +109,33 @@ public:
 	 * RunFrame(void):
 	 *
 	 * Runs the sound board for one frame, updating sound in the process.
+	 * Equivalent to RunSCSPFrame(), running the DSB (if attached) and then
+	 * OutputFrame().
+	 *
+	 * Returns:
+	 *		True if the audio output buffer is full.
 	 */
 	bool RunFrame(void);
 	
+	/*
+	 * RunSCSPFrame(void):
+	 *
+	 * Runs the sound board 68K and SCSPs for one frame, generating the SCSP
+	 * audio. The DSB may run its own frame concurrently on another thread.
+	 */
+	void RunSCSPFrame(void);
+	
+	/*
+	 * OutputFrame(void):
+	 *
+	 * Mixes in the DSB audio (if attached) and outputs the frame's audio. Must
+	 * be called once both RunSCSPFrame() and the DSB's frame have finished.
+	 *
+	 * Returns:
+	 *		True if the audio output buffer is full.
+	 */
+	bool OutputFrame(void);
+	
 	/*
 	 * Reset(void):
 	 *
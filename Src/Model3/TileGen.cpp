@@ -50,6 +50,7 @@
  *   manually reverse the data. This keeps with the convention for VRAM.
  */
 
+#include <algorithm>
 #include <cstring>
 #include "Supermodel.h"
 
@@ -58,6 +59,7 @@
 #define PAGE_SIZE (1<<PAGE_WIDTH)
 #define DIRTY_SIZE(arraySize) (1+(arraySize-1)/(8*PAGE_SIZE))
 #define MARK_DIRTY(dirtyArray, addr) dirtyArray[addr>>(PAGE_WIDTH+3)] |= 1<<((addr>>PAGE_WIDTH)&7)
+#define IS_DIRTY(dirtyArray, page) (dirtyArray[(page)>>3] & (1<<((page)&7)))
 
 // Offsets of memory regions within TileGen memory pool
 #define OFFSET_VRAM         0x000000	// VRAM and palette data
@@ -70,12 +72,14 @@
 #define OFFSET_PAL_RO_B		0x2A0000
 #define MEM_POOL_SIZE_RO    (0x120000+0x040000)
 
-#define OFFSET_VRAM_DIRTY   0x2C0000
+#define NUM_SNAPSHOTS       2           // second snapshot follows first
+
+#define OFFSET_VRAM_DIRTY   0x420000	// dirty page arrays for real memory, followed by those of each snapshot
 #define OFFSET_PAL_A_DIRTY  (OFFSET_VRAM_DIRTY+DIRTY_SIZE(0x120000))
 #define OFFSET_PAL_B_DIRTY	(OFFSET_PAL_A_DIRTY+DIRTY_SIZE(0x20000))
 #define MEM_POOL_SIZE_DIRTY (DIRTY_SIZE(0x120000)+2*DIRTY_SIZE(0x20000))	// VRAM + 2 palette dirty buffers
 
-#define MEMORY_POOL_SIZE	(MEM_POOL_SIZE_RW+MEM_POOL_SIZE_RO+MEM_POOL_SIZE_DIRTY)
+#define MEMORY_POOL_SIZE	(MEM_POOL_SIZE_RW+NUM_SNAPSHOTS*MEM_POOL_SIZE_RO+(1+NUM_SNAPSHOTS)*MEM_POOL_SIZE_DIRTY)
 
 
 /******************************************************************************
@@ -112,7 +116,12 @@ void CTileGen::LoadState(CBlockFile *SaveState)
 	
 	// If multi-threaded, update read-only snapshots too
 	if (m_gpuMultiThreaded)
-		UpdateSnapshots(true);
+	{
+		UINT32 ranges = 0;
+		for (unsigned n = 0; n < NUM_SNAPSHOTS; n++)
+			UpdateSnapshots(true, n, ranges);
+		memset(vramDirty, 0, MEM_POOL_SIZE_DIRTY);
+	}
 }
 
 
@@ -160,8 +169,10 @@ void CTileGen::RecomputePalettes(void)
 	}
 }
 
-UINT32 CTileGen::SyncSnapshots(void)
+UINT32 CTileGen::SyncSnapshots(unsigned frame, UINT32 &ranges)
 {
+	ranges = 0;
+
 	// Good time to recompute the palettes
 	if (recomputePalettes)
 	{
@@ -171,12 +182,24 @@ UINT32 CTileGen::SyncSnapshots(void)
 	
 	if (!m_gpuMultiThreaded)
 		return 0;
-	
-	// Update read-only snapshots
-	return UpdateSnapshots(false);
+
+	// Use the snapshot that was not published last (they alternate with the frame number)
+	unsigned n = frame % NUM_SNAPSHOTS;
+
+	// Pages written this frame are dirty in both snapshots (the dirty page
+	// arrays of each region are contiguous)
+	for (unsigned i = 0; i < MEM_POOL_SIZE_DIRTY; i++)
+	{
+		for (unsigned s = 0; s < NUM_SNAPSHOTS; s++)
+			m_snapshot[s].vramDirty[i] |= vramDirty[i];
+	}
+	memset(vramDirty, 0, MEM_POOL_SIZE_DIRTY);
+
+	// Update read-only snapshot (the caller then publishes the frame to the render thread)
+	return UpdateSnapshots(false, n, ranges);
 }
 
-UINT32 CTileGen::UpdateSnapshot(bool copyWhole, UINT8 *src, UINT8 *dst, unsigned size, UINT8 *dirty)
+UINT32 CTileGen::UpdateSnapshot(bool copyWhole, UINT8 *src, UINT8 *dst, unsigned size, UINT8 *dirty, UINT32 &ranges)
 {
 	unsigned dirtySize = DIRTY_SIZE(size);
 	if (copyWhole)
@@ -184,61 +207,90 @@ UINT32 CTileGen::UpdateSnapshot(bool copyWhole, UINT8 *src, UINT8 *dst, unsigned
 		// If updating whole region, then just copy all data in one go
 		memcpy(dst, src, size);
 		memset(dirty, 0, dirtySize);
+		++ranges;
 		return size;
 	}
 	else
 	{
-		// Otherwise, loop through dirty pages array to find out what needs to be updated and copy only those parts
+		// Otherwise, scan dirty pages array for runs of dirty pages and copy each run in one go
 		UINT32 copied = 0;
-		UINT8 *pSrc = src;
-		UINT8 *pDst = dst;
-		for (unsigned i = 0; i < dirtySize; i++)
+		unsigned numPages = dirtySize * 8;
+		unsigned page = 0;
+		while (page < numPages)
 		{
-			UINT8 d = dirty[i];
-			if (d)
+			// Skip clean pages 64 (then 8) at a time
+			if ((page & 63) == 0 && page + 64 <= numPages)
 			{
-				for (unsigned j = 0; j < 8; j++)
+				UINT64 d;
+				memcpy(&d, &dirty[page >> 3], sizeof(d));
+				if (!d)
 				{
-					if (d&1)
-					{
-						// If not at very end of region, then copy an extra 4 bytes to allow for a possible 32-bit overlap
-						UINT32 toCopy = (i < dirtySize - 1 || j < 7 ? PAGE_SIZE + 4 : PAGE_SIZE);
-						memcpy(pDst, pSrc, toCopy);
-						copied += toCopy;
-					}
-					d >>= 1;
-					pSrc += PAGE_SIZE;	
-					pDst += PAGE_SIZE;
+					page += 64;
+					continue;
 				}
-				dirty[i] = 0;
 			}
-			else
+			if ((page & 7) == 0 && !dirty[page >> 3])
+			{
+				page += 8;
+				continue;
+			}
+			if (!IS_DIRTY(dirty, page))
 			{
-				pSrc += 8 * PAGE_SIZE;	
-				pDst += 8 * PAGE_SIZE;
+				++page;
+				continue;
 			}
+
+			// Find end of run
+			unsigned end = page + 1;
+			while (end < numPages && IS_DIRTY(dirty, end))
+				++end;
+
+			// If not at very end of region, then copy an extra 4 bytes to allow for a possible 32-bit overlap
+			unsigned start = page * PAGE_SIZE;
+			unsigned toCopy = std::min(end * PAGE_SIZE + 4, size) - start;
+			memcpy(dst + start, src + start, toCopy);
+			copied += toCopy;
+			++ranges;
+			page = end;
 		}
+		memset(dirty, 0, dirtySize);
 		return copied;
 	}
 }
 
-UINT32 CTileGen::UpdateSnapshots(bool copyWhole)
+UINT32 CTileGen::UpdateSnapshots(bool copyWhole, unsigned n, UINT32 &ranges)
 {
 	// Update all memory region snapshots
-	UINT32 palACopied  = UpdateSnapshot(copyWhole, (UINT8*)pal[0],  (UINT8*)palRO[0],  0x020000, palDirty[0]);
-	UINT32 palBCopied  = UpdateSnapshot(copyWhole, (UINT8*)pal[1],  (UINT8*)palRO[1],  0x020000, palDirty[1]);
-	UINT32 vramCopied = UpdateSnapshot(copyWhole, (UINT8*)vram, (UINT8*)vramRO, 0x120000, vramDirty);
-	memcpy(regsRO, regs, sizeof(regs)); // Always copy whole of regs buffer
+	Snapshot &s = m_snapshot[n];
+	UINT32 palACopied  = UpdateSnapshot(copyWhole, (UINT8*)pal[0],  (UINT8*)s.pal[0],  0x020000, s.palDirty[0], ranges);
+	UINT32 palBCopied  = UpdateSnapshot(copyWhole, (UINT8*)pal[1],  (UINT8*)s.pal[1],  0x020000, s.palDirty[1], ranges);
+	UINT32 vramCopied = UpdateSnapshot(copyWhole, (UINT8*)vram, (UINT8*)s.vram, 0x120000, s.vramDirty, ranges);
+	memcpy(s.regs, regs, sizeof(regs)); // Always copy whole of regs buffer
+	++ranges;
 	//printf("TileGen copied - palA:%4uK, palB:%4uK, vram:%4uK, regs:%uK\n", palACopied / 1024, palBCopied / 1024, vramCopied / 1024, sizeof(regs) / 1024);
 	return palACopied + palBCopied + vramCopied + sizeof(regs);
 }
 
-void CTileGen::BeginFrame(void)
+void CTileGen::BeginFrame(unsigned frame)
 {
 	// NOTE: Render2D->WriteVRAM(addr, data) is no longer being called for RAM addresses that are written
 	// to and instead this class relies upon the fact that Render2D currently marks everything as dirty
 	// with every frame.  If this were to change in the future then code to handle marking the correct
 	// parts of the renderer as dirty would need to be added here.
+
+	// If multi-threaded, switch renderer over to the snapshot of the given frame
+	if (m_gpuMultiThreaded && frame > 0)
+	{
+		int n = frame % NUM_SNAPSHOTS;
+		if (n != m_snapshotFront)
+		{
+			Snapshot &s = m_snapshot[n];
+			Render2D->AttachVRAM(s.vram);
+			Render2D->AttachPalette((const UINT32 **)s.pal);
+			Render2D->AttachRegisters(s.regs);
+			m_snapshotFront = n;
+		}
+	}
 	
 	Render2D->BeginFrame();
 }
@@ -335,8 +387,11 @@ void CTileGen::InitPalette(void)
 		WritePalette(i, *(UINT32 *) &vram[0x100000 + i*4]);
 		if (m_gpuMultiThreaded)
 		{
-			palRO[0][i] = pal[0][i];
-			palRO[1][i] = pal[1][i];
+			for (unsigned n = 0; n < NUM_SNAPSHOTS; n++)
+			{
+				m_snapshot[n].pal[0][i] = pal[0][i];
+				m_snapshot[n].pal[1][i] = pal[1][i];
+			}
 		}
 	}
 }
@@ -447,7 +502,8 @@ void CTileGen::Reset(void)
 	unsigned memSize = (m_gpuMultiThreaded ? MEMORY_POOL_SIZE : MEM_POOL_SIZE_RW);
 	memset(memoryPool, 0, memSize);
 	memset(regs, 0, sizeof(regs));
-	memset(regsRO, 0, sizeof(regsRO));
+	for (unsigned n = 0; n < NUM_SNAPSHOTS; n++)
+		memset(m_snapshot[n].regs, 0, sizeof(m_snapshot[n].regs));
 	
 	InitPalette();
 	recomputePalettes = false;
@@ -467,9 +523,10 @@ void CTileGen::AttachRenderer(CRender2D *Render2DPtr)
 	// If multi-threaded, attach read-only snapshots to renderer instead of real ones
 	if (m_gpuMultiThreaded)
 	{
-		Render2D->AttachVRAM(vramRO);
-		Render2D->AttachPalette((const UINT32 **)palRO);
-		Render2D->AttachRegisters(regsRO);
+		Snapshot &s = m_snapshot[m_snapshotFront];
+		Render2D->AttachVRAM(s.vram);
+		Render2D->AttachPalette((const UINT32 **)s.pal);
+		Render2D->AttachRegisters(s.regs);
 	}
 	else
 	{
@@ -500,12 +557,21 @@ bool CTileGen::Init(CIRQ *IRQObjectPtr)
 	// If multi-threaded, set up pointers for read-only snapshots and dirty page arrays too
 	if (m_gpuMultiThreaded)
 	{
-		vramRO = (UINT8 *) &memoryPool[OFFSET_VRAM_RO];
-		palRO[0] = (UINT32 *) &memoryPool[OFFSET_PAL_RO_A];
-		palRO[1] = (UINT32 *) &memoryPool[OFFSET_PAL_RO_B];
 		vramDirty = (UINT8 *) &memoryPool[OFFSET_VRAM_DIRTY];
 		palDirty[0] = (UINT8 *) &memoryPool[OFFSET_PAL_A_DIRTY];
 		palDirty[1] = (UINT8 *) &memoryPool[OFFSET_PAL_B_DIRTY];
+		for (unsigned n = 0; n < NUM_SNAPSHOTS; n++)
+		{
+			Snapshot &s = m_snapshot[n];
+			unsigned roOffset = n * MEM_POOL_SIZE_RO;
+			unsigned dirtyOffset = (n + 1) * MEM_POOL_SIZE_DIRTY;
+			s.vram = (UINT8 *) &memoryPool[OFFSET_VRAM_RO + roOffset];
+			s.pal[0] = (UINT32 *) &memoryPool[OFFSET_PAL_RO_A + roOffset];
+			s.pal[1] = (UINT32 *) &memoryPool[OFFSET_PAL_RO_B + roOffset];
+			s.vramDirty = (UINT8 *) &memoryPool[OFFSET_VRAM_DIRTY + dirtyOffset];
+			s.palDirty[0] = (UINT8 *) &memoryPool[OFFSET_PAL_A_DIRTY + dirtyOffset];
+			s.palDirty[1] = (UINT8 *) &memoryPool[OFFSET_PAL_B_DIRTY + dirtyOffset];
+		}
 	}
 
 	// Hook up the IRQ controller
@@ -521,6 +587,7 @@ CTileGen::CTileGen(const Util::Config::Node &config)
 {
 	IRQ = NULL;
 	memoryPool = NULL;
+	m_snapshotFront = 0;
 	DebugLog("Built Tile Generator\n");
 }
 
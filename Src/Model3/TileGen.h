@@ -73,26 +73,41 @@ public:
 	void EndVBlank(void);
 
 	/*
-	 * SyncSnapshots(void):
+	 * SyncSnapshots(frame, ranges):
 	 *
-	 * Syncs the read-only memory snapshots with the real ones so that rendering
-	 * of the current frame can begin in the render thread.  Must be called at the
-	 * end of each frame when both the render thread and the PPC thread have finished
-	 * their work.  If multi-threaded rendering is not enabled, then this method does
-	 * nothing.
+	 * Copies the pages written during the frame into the read-only snapshot
+	 * for the given frame number, which is not in use by the render thread.
+	 * Must be called by the PPC thread at the end of each frame, and may run
+	 * while the render thread is still drawing the previous snapshot.  If
+	 * multi-threaded rendering is not enabled, then this method only
+	 * recomputes the palettes if needed.  Snapshots are paired per frame with
+	 * those of the Real3D (see CReal3D::SyncSnapshots()).
+	 *
+	 * Runs of adjacent dirty pages are copied together.
+	 *
+	 * Parameters:
+	 *		frame	Frame number, counting from 1.
+	 *		ranges	Set to the number of separate memory ranges copied.
+	 *
+	 * Returns:
+	 *		Number of bytes copied.
 	 */
-	UINT32 SyncSnapshots(void);
+	UINT32 SyncSnapshots(unsigned frame, UINT32 &ranges);
 
 	/*
-	 * BeginFrame(void):
+	 * BeginFrame(frame):
 	 *
 	 * Prepares to render a new frame.  Must be called once per frame prior to
 	 * drawing anything and must only access read-only snapshots and variables
-   * since it may be running in a separate thread.
+   * since it may be running in a separate thread.  If multi-threaded,
+   * switches the renderer over to the snapshot of the given frame.
    *
    * Invokes the underlying 2D renderer.
+   *
+   * Parameters:
+   *    frame   Most recently published frame number (0 if none yet).
 	 */
-	void BeginFrame(void);
+	void BeginFrame(unsigned frame);
 
   /*
    * PreRenderFrame(void):
@@ -255,8 +270,8 @@ private:
 	void		RecomputePalettes(void);
 	void		InitPalette(void);
 	void		WritePalette(unsigned color, UINT32 data);
-	UINT32		UpdateSnapshots(bool copyWhole);
-	UINT32		UpdateSnapshot(bool copyWhole, UINT8 *src, UINT8 *dst, unsigned size, UINT8 *dirty);
+	UINT32		UpdateSnapshots(bool copyWhole, unsigned n, UINT32 &ranges);
+	UINT32		UpdateSnapshot(bool copyWhole, UINT8 *src, UINT8 *dst, unsigned size, UINT8 *dirty, UINT32 &ranges);
 
   const Util::Config::Node &m_config;
   const bool m_gpuMultiThreaded;
@@ -274,18 +289,28 @@ private:
 	UINT32	*pal[2];			// 2 x 0x20000 byte (32K colors) palette
 	bool	recomputePalettes;	// whether to recompute palettes A/A' and B/B' during sync
 
-	// Read-only snapshots
-	UINT8   *vramRO;        // 1.125MB of VRAM                       [read-only snapshot]	
-	UINT32  *palRO[2];      // 2 x 0x20000 byte (32K colors) palette [read-only snapshot]
-	
 	// Arrays to keep track of dirty pages in memory regions
 	UINT8   *vramDirty;
 	UINT8   *palDirty[2];	// one for each palette
 
 	// Registers
 	UINT32	regs[64];
-	UINT32  regsRO[64];     // Read-only copy of registers
-	
+
+	/*
+	 * Read-only snapshots, double buffered in the same way as those of the
+	 * Real3D (see CReal3D::SyncSnapshots()).
+	 */
+	struct Snapshot
+	{
+		UINT8   *vram;          // 1.125MB of VRAM                       [read-only snapshot]
+		UINT32  *pal[2];        // 2 x 0x20000 byte (32K colors) palette [read-only snapshot]
+		UINT8   *vramDirty;     // pages changed since snapshot was last updated
+		UINT8   *palDirty[2];
+		UINT32  regs[64];       // Read-only copy of registers
+	};
+	Snapshot			m_snapshot[2];
+	int					m_snapshotFront;	// snapshot attached to renderer [render thread only]
+
 };
 
 
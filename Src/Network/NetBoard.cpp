@@ -1307,6 +1307,7 @@ bool CNetBoard::RunFrame(void)
 		return true;
 	}
 	
+	std::lock_guard<std::mutex> lock(m_cpuLock);
 	M68KSetContext(&M68K);
 	
 	/*if (int5 == false)
@@ -1369,6 +1370,7 @@ void CNetBoard::Reset(void)
 	Util::FlipEndian16(netRAM, 0x8000);*/
 
 	
+	std::lock_guard<std::mutex> lock(m_cpuLock);
 	M68KSetContext(&M68K);
 	printf("RESET NetBoard PC=%06X\n", M68KGetPC());
 	M68KReset();
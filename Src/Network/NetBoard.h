@@ -7,6 +7,7 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <thread>
+#include <mutex>
 #include "UDPSend.h"
 #include "UDPReceive.h"
 
@@ -47,6 +48,7 @@ private:
 	const Util::Config::Node &m_config;
 	// 68K CPU
 	M68KCtx		M68K;
+	std::mutex	m_cpuLock;		// RunFrame() runs on the net board thread, Reset() on the PPC thread
 
 	// Sound board memory
 	UINT8		*netRAM;		// 128Kb RAM (passed in from parent object)
@@ -34,6 +34,13 @@ extern void SetAudioCallback(AudioCallbackFPtr callback, void *data);
 
 extern void SetAudioEnabled(bool enabled);
 
+/*
+ * GetAudioStats(numUnderRuns, numOverRuns)
+ *
+ * Returns the number of times the audio buffer has run dry and overflowed since it was opened.
+ */
+extern void GetAudioStats(unsigned *numUnderRuns, unsigned *numOverRuns);
+
 /*
  * OpenAudio()
  *
@@ -37,6 +37,7 @@
 
 #include <cmath>
 #include <algorithm>
+#include <atomic>
 
 // Model3 audio output is 44.1KHz 2-channel sound and frame rate is 60fps
 #define SAMPLE_RATE 44100
@@ -49,22 +50,48 @@
 
 #define MAX_LATENCY 100
 
+// Resampling step is 16.16 fixed point and may differ from 1.0 by at most this (1/200, well below audible pitch change)
+#define RESAMPLE_ONE		0x10000
+#define RESAMPLE_MAX_ADJUST	(RESAMPLE_ONE / 200)
+
+// Most samples a frame can grow to when resampled
+#define MAX_RESAMPLED_PER_FRAME (SAMPLES_PER_FRAME + SAMPLES_PER_FRAME / 100 + 2)
+
 static bool enabled = true;         // True if sound output is enabled
 static unsigned latency = 20;       // Audio latency to use (ie size of audio buffer) as percentage of max buffer size
-static bool underRunLoop = true;    // True if should loop back to beginning of buffer on under-run, otherwise sound is just skipped
 
 static unsigned playSamples = 512;  // Size (in samples) of callback play buffer
 
-static UINT32 audioBufferSize = 0;  // Size (in bytes) of audio buffer
-static INT8	*audioBuffer = NULL;    // Audio buffer
+/*
+ * The audio buffer is a single-producer (OutputAudio, on the sound board
+ * thread) single-consumer (PlayCallback, on the SDL audio thread) ring of
+ * samples. The read and write indices count samples and run freely, wrapping
+ * at 2^32; the ring size is a power of two so that they can simply be masked.
+ * Each side only ever stores its own index, publishing the samples it has
+ * written or freed with release ordering, so neither needs to lock the other
+ * out.
+ *
+ * Rather than moving the play position around when the buffer runs dry or
+ * fills up, OutputAudio resamples each frame very slightly to steer the fill
+ * level towards targetFill. After an under-run, PlayCallback plays silence
+ * until the buffer has filled back up to the target.
+ */
+static INT16 *audioBuffer = NULL;   // Audio buffer (interleaved samples)
+static UINT32 bufferMask = 0;       // Size (in samples) of audio buffer minus one
+static UINT32 maxFill = 0;          // Number of samples the buffer may hold
+static UINT32 targetFill = 0;       // Number of buffered samples aimed for
 
-static UINT32 writePos = 0;         // Current position at which writing into buffer
-static UINT32 playPos = 0;          // Current position at which playing data in buffer via callback
+alignas(64) static std::atomic<UINT32> writeIndex(0);  // Samples written so far (only stored by OutputAudio)
+alignas(64) static std::atomic<UINT32> readIndex(0);   // Samples played so far (only stored by PlayCallback)
+static bool priming = true;         // True while PlayCallback is waiting for the buffer to reach targetFill
 
-static bool writeWrapped = false;   // True if write position has wrapped around at end of buffer but play position has not done so yet
+static UINT32 resamplePos = 0;      // Fractional position of next output sample (16.16, relative to the last sample of the previous frame)
+static INT16 lastLeft = 0;          // Last sample of the previous frame, left channel
+static INT16 lastRight = 0;         // Right channel
+static double averageFill = 0;      // Buffer fill level, averaged over recent frames
 
-static unsigned underRuns = 0;      // Number of buffer under-runs that have occured
-static unsigned overRuns = 0;       // Number of buffer over-runs that have occured
+static std::atomic<unsigned> underRuns(0); // Number of buffer under-runs that have occured
+static std::atomic<unsigned> overRuns(0);  // Number of buffer over-runs that have occured
 
 static AudioCallbackFPtr callback = NULL; // Pointer to audio callback that is called when audio buffer is less than half empty
 static void *callbackData = NULL;         // Pointer to data to be passed to audio callback when it is called
@@ -85,111 +112,81 @@ void SetAudioEnabled(bool newEnabled)
 	enabled = newEnabled;
 }
 
+void GetAudioStats(unsigned *numUnderRuns, unsigned *numOverRuns)
+{
+	*numUnderRuns = underRuns.load(std::memory_order_relaxed);
+	*numOverRuns = overRuns.load(std::memory_order_relaxed);
+}
+
 static void PlayCallback(void *data, Uint8 *stream, int len)
 {
-	//printf("PlayCallback(%d) [writePos = %u, writeWrapped = %s, playPos = %u, audioBufferSize = %u]\n", 
-	//	len, writePos, (writeWrapped ? "true" : "false"), playPos, audioBufferSize);
-	
-	// Get current write position and adjust it if write has wrapped but play position has not
-	UINT32 adjWritePos = writePos;
-	if (writeWrapped)
-		adjWritePos += audioBufferSize;
+	UINT32 numSamples = len / BYTES_PER_SAMPLE;
+	INT16 *dst = (INT16*)stream;
 
-	// Check if play position overlaps write position (ie buffer under-run)
-	if (playPos + len > adjWritePos)
+	// Samples written by OutputAudio are visible once its write index is
+	UINT32 readPos = readIndex.load(std::memory_order_relaxed);
+	UINT32 available = writeIndex.load(std::memory_order_acquire) - readPos;
+
+	// Check if play region overlaps write position (ie buffer under-run)
+	if (!priming && available < numSamples)
 	{
-		underRuns++;
+		underRuns.fetch_add(1, std::memory_order_relaxed);
+		priming = true;
+	}
 
-		//printf("Audio buffer under-run #%u in PlayCallback(%d) [writePos = %u, writeWrapped = %s, playPos = %u, audioBufferSize = %u]\n",
-		//	underRuns, len, writePos, (writeWrapped ? "true" : "false"), playPos, audioBufferSize);
-		
-		// See what action to take on under-run
-		if (underRunLoop)
-		{
-			// If loop, then move play position back to beginning of data in buffer
-			playPos = adjWritePos + BYTES_PER_FRAME;
-
-			// Check if play position has moved past end of buffer
-			if (playPos >= audioBufferSize)
-				// If so, wrap it around to beginning again (but keep write wrapped flag as before)
-				playPos -= audioBufferSize;
-			else 
-				// Otherwise, set write wrapped flag as will now appear as if write has wrapped but play position has not
-				writeWrapped = true;
-		}
+	// Wait for buffer to fill up to target again before resuming play
+	if (priming)
+	{
+		if (available >= targetFill && available >= numSamples)
+			priming = false;
 		else
 		{
-			// Otherwise, just copy silence to audio output stream and exit
 			memset(stream, 0, len);
+			if (callback)
+				callback(callbackData);
 			return;
 		}
 	}
-	
-	INT8* src1;
-	INT8* src2;
-	UINT32 len1;
-	UINT32 len2;
-
-	// Check if play region extends past end of buffer
-	if (playPos + len > audioBufferSize)
-	{
-		// If so, split play region into two
-		src1 = audioBuffer + playPos;
-		src2 = audioBuffer;
-		len1 = audioBufferSize - playPos;
-		len2 = len - len1;
-	}
-	else
-	{
-		// Otherwise, just copy whole region
-		src1 = audioBuffer + playPos;
-		src2 = 0;
-		len1 = len;
-		len2 = 0;
-	}
 
-	// Check if audio is enabled
+	// Copy play region into audio output stream (or silence if audio is disabled), in two parts if it wraps
 	if (enabled)
 	{
-		// If so, copy play region into audio output stream
-		memcpy(stream, src1, len1);
-		
-		// Also, if not looping on under-runs then blank region out
-		if (!underRunLoop)
-			memset(src1, 0, len1);
-
-		if (len2)
-		{
-			// If region was split into two, copy second half into audio output stream as well
-			memcpy(stream + len1, src2, len2);
-
-			// Also, if not looping on under-runs then blank region out
-			if (!underRunLoop)
-				memset(src2, 0, len2);
-		}
+		UINT32 start = readPos & bufferMask;
+		UINT32 len1 = std::min(numSamples, bufferMask + 1 - start);
+		memcpy(dst, audioBuffer + start * NUM_CHANNELS, len1 * BYTES_PER_SAMPLE);
+		memcpy(dst + len1 * NUM_CHANNELS, audioBuffer, (numSamples - len1) * BYTES_PER_SAMPLE);
 	}
 	else
-		// Otherwise, just copy silence to audio output stream
 		memset(stream, 0, len);
 
-	// Move play position forward for next time
-	playPos += len;
-
-	bool bufferFull = adjWritePos + 2 * BYTES_PER_FRAME > playPos + audioBufferSize;
-
-	// Check if play position has moved past end of buffer
-	if (playPos >= audioBufferSize)
-	{
-		// If so, wrap it around to beginning again and reset write wrapped flag
-		playPos -= audioBufferSize;
-		writeWrapped = false;
-	}
+	// Hand played region back to OutputAudio
+	readIndex.store(readPos + numSamples, std::memory_order_release);
 
 	// If buffer is not full then call audio callback
+	bool bufferFull = available - numSamples + 2 * SAMPLES_PER_FRAME > maxFill;
 	if (callback && !bufferFull)
 		callback(callbackData);
 }
 
+/*
+ * Resamples one channel by linear interpolation, starting at the given 16.16
+ * position and advancing by step each sample. Position 0 is the previous
+ * frame's last sample, position 1.0 is src[0]. With a step of exactly 1.0, the
+ * samples are passed through unchanged.
+ */
+static unsigned ResampleChannel(INT16 *dest, const INT16 *src, unsigned numSamples, INT16 last, UINT32 pos, UINT32 step)
+{
+	unsigned n = 0;
+	for (; pos < (numSamples << 16); pos += step)
+	{
+		unsigned i = pos >> 16;
+		INT32 s0 = i ? src[i - 1] : last;
+		INT32 s1 = src[i];
+		dest[n++] = (INT16)(s0 + (INT32)(((INT64)(s1 - s0) * (pos & 0xFFFF)) >> 16));
+	}
+	return n;
+}
+
 static void MixChannels(unsigned numSamples, INT16 *leftBuffer, INT16 *rightBuffer, void *dest, bool flipStereo)
 {
 	INT16 *p = (INT16*)dest;
@@ -254,22 +251,33 @@ bool OpenAudio()
 	// Check what buffer sample size was actually obtained, and use that
 	playSamples = obtained.samples;
 
-	// Create audio buffer
-	audioBufferSize = SAMPLE_RATE * BYTES_PER_SAMPLE * latency / MAX_LATENCY;
-	int minBufferSize = 3 * BYTES_PER_FRAME;
-	audioBufferSize = std::max<int>(minBufferSize, audioBufferSize);
-	audioBuffer = new(std::nothrow) INT8[audioBufferSize];
+	// Work out buffer limits from latency, and aim to keep it half full
+	maxFill = SAMPLE_RATE * latency / MAX_LATENCY;
+	maxFill = std::max<UINT32>(3 * SAMPLES_PER_FRAME, maxFill);
+	maxFill = std::max<UINT32>(playSamples + 2 * SAMPLES_PER_FRAME, maxFill);
+	targetFill = std::min<UINT32>(maxFill - SAMPLES_PER_FRAME, (SAMPLES_PER_FRAME + maxFill) / 2);
+
+	// Create audio buffer (rounded up to a power of two)
+	UINT32 bufferSize = 1;
+	while (bufferSize < maxFill)
+		bufferSize <<= 1;
+	audioBuffer = new(std::nothrow) INT16[bufferSize * NUM_CHANNELS];
 	if (audioBuffer == NULL)
 	{
-		float audioBufMB = (float)audioBufferSize / (float)0x100000;
+		float audioBufMB = (float)(bufferSize * BYTES_PER_SAMPLE) / (float)0x100000;
 		return ErrorLog("Insufficient memory for audio latency buffer (need %1.1f MB).", audioBufMB);	
 	}
-	memset(audioBuffer, 0, sizeof(INT8) * audioBufferSize);
-	
-	// Set initial play position to be beginning of buffer and initial write position to be half-way into buffer
-	playPos = 0;
-	writePos = std::min<int>(audioBufferSize - BYTES_PER_FRAME, (BYTES_PER_FRAME + audioBufferSize) / 2);
-	writeWrapped = false;
+	memset(audioBuffer, 0, bufferSize * BYTES_PER_SAMPLE);
+	bufferMask = bufferSize - 1;
+
+	// Start with an empty buffer, which will be played once it reaches the target
+	readIndex.store(0, std::memory_order_relaxed);
+	writeIndex.store(0, std::memory_order_relaxed);
+	priming = true;
+	resamplePos = 0;
+	lastLeft = 0;
+	lastRight = 0;
+	averageFill = targetFill;
 
 	// Reset counters
 	underRuns = 0;
@@ -282,150 +290,51 @@ bool OpenAudio()
 
 bool OutputAudio(unsigned numSamples, INT16 *leftBuffer, INT16 *rightBuffer, bool flipStereo)
 {
-	//printf("OutputAudio(%u) [writePos = %u, writeWrapped = %s, playPos = %u, audioBufferSize = %u]\n",
-	//	numSamples, writePos, (writeWrapped ? "true" : "false"), playPos, audioBufferSize);
-
-	UINT32 bytesRemaining;
-	UINT32 bytesToCopy;
-	INT16 *src;
-
 	// Number of samples should never be more than max number of samples per frame
 	if (numSamples > SAMPLES_PER_FRAME)
 		numSamples = SAMPLES_PER_FRAME;
-
-	// Mix together left and right channels into single chunk of data
-	INT16 mixBuffer[NUM_CHANNELS * SAMPLES_PER_FRAME];
-	MixChannels(numSamples, leftBuffer, rightBuffer, mixBuffer, flipStereo);
-	
-	// Lock SDL audio callback so that it doesn't interfere with following code
-	SDL_LockAudio();
-	
-	// Calculate number of bytes for current sound chunk
-	UINT32 numBytes = numSamples * BYTES_PER_SAMPLE;
-	
-	// Get end of current play region (writing must occur past this point)
-	UINT32 playEndPos = playPos + BYTES_PER_FRAME;
-	
-	// Undo any wrap-around of the write position that may have occured to create following ordering: playPos < playEndPos < writePos
-	if (playEndPos > writePos && writeWrapped)
-		writePos += audioBufferSize;
-
-	// Check if play region has caught up with write position and now overlaps it (ie buffer under-run)
-	if (playEndPos > writePos)
+	if (numSamples == 0)
+		return false;
+
+	// Space freed by PlayCallback is visible once its read index is
+	UINT32 writePos = writeIndex.load(std::memory_order_relaxed);
+	UINT32 fill = writePos - readIndex.load(std::memory_order_acquire);
+
+	// Steer fill level towards target: consume input faster when above it (fewer samples out), slower when below.
+	// The level jumps by a whole callback's worth each time PlayCallback runs, so follow a running average of it.
+	averageFill += (fill - averageFill) * 0.05;
+	INT32 adjust = (INT32)(RESAMPLE_MAX_ADJUST * (averageFill - targetFill) / targetFill);
+	adjust = std::max<INT32>(-RESAMPLE_MAX_ADJUST, std::min<INT32>(RESAMPLE_MAX_ADJUST, adjust));
+	UINT32 step = RESAMPLE_ONE + adjust;
+
+	// Resample channels
+	INT16 resampledL[MAX_RESAMPLED_PER_FRAME];
+	INT16 resampledR[MAX_RESAMPLED_PER_FRAME];
+	unsigned numOut = ResampleChannel(resampledL, leftBuffer, numSamples, lastLeft, resamplePos, step);
+	ResampleChannel(resampledR, rightBuffer, numSamples, lastRight, resamplePos, step);
+	resamplePos = resamplePos + numOut * step - (numSamples << 16);
+	lastLeft = leftBuffer[numSamples - 1];
+	lastRight = rightBuffer[numSamples - 1];
+
+	// Check if there is room for all of it in buffer, otherwise drop what does not fit (ie buffer over-run)
+	UINT32 space = fill < maxFill ? maxFill - fill : 0;
+	if (numOut > space)
 	{
-		underRuns++;
-
-		//printf("Audio buffer under-run #%u in OutputAudio(%u) [writePos = %u, writeWrapped = %s, playPos = %u, audioBufferSize = %u, numBytes = %u]\n",
-		//	underRuns, numSamples, writePos, (writeWrapped ? "true" : "false"), playPos, audioBufferSize, numBytes);
-		
-		// See what action to take on under-run
-		if (underRunLoop)
-		{
-			// If loop, then move play position back to beginning of data in buffer
-			playPos = writePos + numBytes + BYTES_PER_FRAME;
-			
-			// Check if play position has moved past end of buffer
-			if (playPos >= audioBufferSize)
-				// If so, wrap it around to beginning again (but keep write wrapped flag as before)
-				playPos -= audioBufferSize;
-			else 
-			{
-				// Otherwise, set write wrapped flag as will now appear as if write has wrapped but play position has not
-				writeWrapped = true;
-				writePos += audioBufferSize;
-			}
-		}
-		else
-		{
-			// Otherwise, bump write position forward in chunks until it is past end of play region
-			do
-			{
-				writePos += numBytes;
-			}
-			while (playEndPos > writePos);
-		}
+		overRuns.fetch_add(1, std::memory_order_relaxed);
+		numOut = space;
 	}
 
-	// Check if write position has caught up with play region and now overlaps it (ie buffer over-run)
-	bool overRun = writePos + numBytes > playPos + audioBufferSize;
-	
-	bool bufferFull = writePos + 2 * BYTES_PER_FRAME > playPos + audioBufferSize;
-
-	// Move write position back to within buffer
-	if (writePos >= audioBufferSize)
-		writePos -= audioBufferSize;
-
-	// Handle buffer over-run
-	if (overRun)
-	{
-		overRuns++;
-
-		//printf("Audio buffer over-run #%u in OutputAudio(%u) [writePos = %u, writeWrapped = %s, playPos = %u, audioBufferSize = %u, numBytes = %u]\n",
-		//	overRuns, numSamples, writePos, (writeWrapped ? "true" : "false"), playPos, audioBufferSize, numBytes);
-		
-		bufferFull = true;
+	// Mix together left and right channels, directly into buffer (in two parts if write region wraps)
+	UINT32 start = writePos & bufferMask;
+	UINT32 len1 = std::min<UINT32>(numOut, bufferMask + 1 - start);
+	MixChannels(len1, resampledL, resampledR, audioBuffer + start * NUM_CHANNELS, flipStereo);
+	MixChannels(numOut - len1, resampledL + len1, resampledR + len1, audioBuffer, flipStereo);
 
-		// Discard current chunk of data
-		goto Finish;
-	}
-
-	src = mixBuffer;
-	INT8 *dst1;
-	INT8 *dst2;
-	UINT32 len1;
-	UINT32 len2;
-
-	// Check if write region extends past end of buffer
-	if (writePos + numBytes > audioBufferSize)
-	{
-		// If so, split write region into two
-		dst1 = audioBuffer + writePos;
-		dst2 = audioBuffer;
-		len1 = audioBufferSize - writePos;
-		len2 = numBytes - len1;
-	}
-	else
-	{
-		// Otherwise, just copy whole region
-		dst1 = audioBuffer + writePos;
-		dst2 = 0;
-		len1 = numBytes;
-		len2 = 0;
-	}
-
-	// Copy chunk to write position in buffer
-	bytesRemaining = numBytes;
-	bytesToCopy = (bytesRemaining > len1 ? len1 : bytesRemaining);
-	memcpy(dst1, src, bytesToCopy);
-
-	// Adjust for number of bytes copied
-	bytesRemaining -= bytesToCopy;
-	src = (INT16*)((UINT8*)src + bytesToCopy);
-
-	if (bytesRemaining)
-	{
-		// If write region was split into two, copy second half of chunk into buffer as well
-		bytesToCopy = (bytesRemaining > len2 ? len2 : bytesRemaining);
-		memcpy(dst2, src, bytesToCopy);
-	}
-
-	// Move write position forward for next time
-	writePos += numBytes;
-
-	// Check if write position has moved past end of buffer
-	if (writePos >= audioBufferSize)
-	{
-		// If so, wrap it around to beginning again and set write wrapped flag
-		writePos -= audioBufferSize;
-		writeWrapped = true;
-	}
-
-Finish:
-	// Unlock SDL audio callback
-	SDL_UnlockAudio();
+	// Publish new samples to PlayCallback
+	writeIndex.store(writePos + numOut, std::memory_order_release);
 
-	// Return whether buffer is half full
-	return bufferFull;
+	// Return whether buffer is full
+	return fill + numOut + 2 * SAMPLES_PER_FRAME > maxFill;
 }
 
 void CloseAudio()
@@ -828,9 +828,15 @@ static Util::Config::Node DefaultConfig()
   // CModel3
   config.Set("MultiThreaded", true);
   config.Set("GPUMultiThreaded", true);
+  config.Set("GPUWriteFaults", false);
+  config.Set("SCSPMultiThreaded", false);
   config.Set("PowerPCFrequency", "50");
+  config.Set("PowerPCEngine", "interpreter");
+  config.Set("PowerPCIdleSkip", true);
   // 2D and 3D graphics engines
   config.Set("MultiTexture", false);
+  config.Set("TextureAtlas", false);
+  config.Set("ModelCache", false);
   config.Set("VertexShader", "");
   config.Set("FragmentShader", "");
   config.Set("VertexShaderFog", "");
@@ -903,9 +909,16 @@ static void Help(void)
   puts("");
   puts("Core Options:");
   printf("  -ppc-frequency=<freq>   PowerPC frequency in MHz [Default: %d]\n", defaultConfig["PowerPCFrequency"].ValueAs<unsigned>());
+  puts("  -ppc-engine=<engine>    PowerPC execution engine: interpreter [Default],");
+  puts("                          threaded or recompiler (x86-64 only)");
+  puts("  -no-idle-skip           Do not skip PowerPC idle loops");
   puts("  -no-threads             Disable multi-threading entirely");
   puts("  -gpu-multi-threaded     Run graphics rendering in separate thread [Default]");
   puts("  -no-gpu-thread          Run graphics rendering in main thread");
+  puts("  -gpu-write-faults       Track Real3D memory writes with page faults (Linux");
+  puts("                          only, requires graphics thread)");
+  puts("  -scsp-multi-threaded    Run the slave SCSP in a separate thread");
+  puts("  -no-scsp-thread         Run both SCSPs in the sound thread [Default]");
   puts("  -load-state=<file>      Load save state after starting");
   puts("");
   puts("Video Options:");
@@ -924,6 +937,10 @@ static void Help(void)
   puts("  -legacy3d               Legacy 3D engine (faster but less accurate)");
   puts("  -multi-texture          Use 8 texture maps for decoding (legacy engine)");
   puts("  -no-multi-texture       Decode to single texture (legacy engine) [Default]");
+  puts("  -texture-atlas          Sample textures from whole texture sheet (new engine)");
+  puts("  -no-texture-atlas       Use separate texture per texture (new engine) [Default]");
+  puts("  -model-cache            Keep decoded VROM models between sessions (new engine)");
+  puts("  -no-model-cache         Decode VROM models every session (new engine) [Default]");
   puts("  -vert-shader=<file>     Load Real3D vertex shader for 3D rendering");
   puts("  -frag-shader=<file>     Load Real3D fragment shader for 3D rendering");
   puts("  -vert-shader-fog=<file> Load Real3D scroll fog vertex shader (new engine)");
@@ -981,6 +998,7 @@ static ParsedCommandLine ParseCommandLine(int argc, char **argv)
     { "-game-xml-file",         "GameXMLFile"             },
     { "-load-state",            "InitStateFile"           },
     { "-ppc-frequency",         "PowerPCFrequency"        },
+    { "-ppc-engine",            "PowerPCEngine"           },
     { "-crosshairs",            "Crosshairs"              },
     { "-vert-shader",           "VertexShader"            },
     { "-frag-shader",           "FragmentShader"          },
@@ -1000,6 +1018,12 @@ static ParsedCommandLine ParseCommandLine(int argc, char **argv)
     { "-no-threads",          { "MultiThreaded",    false } },
     { "-gpu-multi-threaded",  { "GPUMultiThreaded", true } },
     { "-no-gpu-thread",       { "GPUMultiThreaded", false } },
+    { "-gpu-write-faults",    { "GPUWriteFaults",   true } },
+    { "-no-gpu-write-faults", { "GPUWriteFaults",   false } },
+    { "-scsp-multi-threaded", { "SCSPMultiThreaded", true } },
+    { "-no-scsp-thread",      { "SCSPMultiThreaded", false } },
+    { "-idle-skip",           { "PowerPCIdleSkip",  true } },
+    { "-no-idle-skip",        { "PowerPCIdleSkip",  false } },
     { "-window",              { "FullScreen",       false } },
     { "-fullscreen",          { "FullScreen",       true } },
     { "-no-wide-screen",      { "WideScreen",       false } },
@@ -1008,6 +1032,10 @@ static ParsedCommandLine ParseCommandLine(int argc, char **argv)
     { "-no-stretch",          { "Stretch",          false } },
     { "-no-multi-texture",    { "MultiTexture",     false } },
     { "-multi-texture",       { "MultiTexture",     true } },
+    { "-no-texture-atlas",    { "TextureAtlas",     false } },
+    { "-texture-atlas",       { "TextureAtlas",     true } },
+    { "-no-model-cache",      { "ModelCache",       false } },
+    { "-model-cache",         { "ModelCache",       true } },
     { "-throttle",            { "Throttle",         true } },
     { "-no-throttle",         { "Throttle",         false } },
     { "-vsync",               { "VSync",            true } },
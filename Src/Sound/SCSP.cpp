@@ -37,6 +37,11 @@
  * out, or there may be a UART with a large FIFO buffer. This can be simulated
  * by increasing the MIDI buffer (MIDI_STACK_SIZE).
  *
+ * The two SCSPs only meet in the final mix, so with SCSPMultiThreaded the
+ * slave's slots and DSP are run on a thread of their own, in step with the
+ * master one sample at a time (the 68K runs between samples and may write to
+ * either chip).
+ *
  * To-Do List
  * ----------
  * - Wrap up into an object. Remove any unused #ifdef pathways.
@@ -55,11 +60,17 @@
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <atomic>
+#include <thread>
 #include "Sound/SCSPDSP.h"
+#include "Sound/SCSPMix.h"
 
 static const Util::Config::Node *s_config = 0;
 static bool s_multiThreaded = false;
 
+static bool SCSP_StartSlaveThread();
+static void SCSP_StopSlaveThread();
+
 //#define NEWSCSP
 //#define RB_VOLUME
 
@@ -757,6 +768,13 @@ bool SCSP_Init(const Util::Config::Node &config, int n)
 		free(buffertmpr);
 		return ErrorLog("Unable to create MIDI mutex!");
 	}
+
+	// Slave SCSP thread
+	if(HasSlaveSCSP && s_multiThreaded && config["SCSPMultiThreaded"].ValueAs<bool>() && std::thread::hardware_concurrency()>1)
+	{
+		if(!SCSP_StartSlaveThread())
+			ErrorLog("Unable to create slave SCSP thread: %s. Running both SCSPs on one thread.", CThread::GetLastError());
+	}
 	
 	return OKAY;
 }
@@ -1619,7 +1637,7 @@ void SCSP_DoMasterSamples(int nsamples)
 
 #else
 
-signed int inline SCSP_UpdateSlot(_SLOT *slot)
+signed int inline SCSP_UpdateSlot(_SCSP *chip,_SLOT *slot)
 {
 	signed int sample;
 	int step=slot->step;
@@ -1641,9 +1659,9 @@ signed int inline SCSP_UpdateSlot(_SLOT *slot)
 
 	if(MDL(slot)!=0 || MDXSL(slot)!=0 || MDYSL(slot)!=0)
 	{
-//TODO: is this correct? SCSP is not necessarily set to the slave SCSP. ElSemi may not have noticed this.
+		// Modulation comes from the slot's own SCSP (SCSP points at whichever one the 68K last accessed)
 		unsigned char v;
-		signed int smp=(SCSP->RINGBUF[(SCSP->BUFPTR+MDXSL(slot))&63]+SCSP->RINGBUF[(SCSP->BUFPTR+MDYSL(slot))&63])/2;
+		signed int smp=(chip->RINGBUF[(chip->BUFPTR+MDXSL(slot))&63]+chip->RINGBUF[(chip->BUFPTR+MDYSL(slot))&63])/2;
 		
 		smp>>=11;
 		// Check for underflow before adding to addr
@@ -1751,7 +1769,7 @@ signed int inline SCSP_UpdateSlot(_SLOT *slot)
 	}
 
 	if(!STWINH(slot))
-		*RBUFDST=sample;
+		chip->RINGBUF[chip->BUFPTR]=sample;
 	else 
 		int a=1;
 
@@ -1760,6 +1778,151 @@ signed int inline SCSP_UpdateSlot(_SLOT *slot)
 	return sample;
 }
 
+/*
+ * Steps all the slots and the DSP of one SCSP by a sample and adds its
+ * output, scaled by balance, to left and right. Touches nothing but the chip
+ * itself, so the master and slave can be run at the same time.
+ */
+static void SCSP_DoChipSample(_SCSP *chip,float balance,signed int *left,signed int *right)
+{
+	/*
+	 * Step the slots in order (they modulate each other through the ring
+	 * buffer), collecting their outputs, then mix them all at once.
+	 */
+	SCSPMixSlots	mix;
+	_SLOT			*mixSlots[32];
+
+	mix.count=0;
+	for(int sl=0;sl<32;++sl)
+	{
+		_SLOT *slot=chip->Slots+sl;
+		if(slot->active)
+		{
+			unsigned short Enc=((TL(slot))<<0x8)|((DIPAN(slot))<<0x0)|((DISDL(slot))<<0x5);
+			int n=mix.count++;
+			mix.sample[n]=SCSP_UpdateSlot(chip,slot);
+			mix.lpan[n]=LPANTABLE[Enc];
+			mix.rpan[n]=RPANTABLE[Enc];
+			if(chip->Master)
+				// Spindizzi's fix for the VF3 cave stage
+				//mix.dpan[n]=LPANTABLE[(Enc|0xE0)&0xFFE0];
+				mix.dpan[n]=LPANTABLE[(Enc|0xE0)];
+			else
+				mix.dpan[n]=LPANTABLE[(Enc|0xE0)&0xFFE0];
+			mixSlots[n]=slot;
+		}
+		++chip->BUFPTR;
+		chip->BUFPTR&=63;
+	}
+
+	SCSP_MixSlots(&mix,balance,left,right);
+
+#ifdef USEDSP
+	for(int i=0;i<mix.count;++i)
+		SCSPDSP_SetSample(&chip->DSP,mix.dsp[i],ISEL(mixSlots[i]),IMXL(mixSlots[i]));
+	SCSPDSP_Step(&chip->DSP);
+
+	for(int i=0;i<16;++i)
+	{
+		_SLOT *slot=chip->Slots+i;
+		if(EFSDL(slot))
+		{
+			unsigned short Enc=0|((EFPAN(slot))<<0x0)|((EFSDL(slot))<<0x5);
+			*left+=(int) (balance*(float)((chip->DSP.EFREG[i]*LPANTABLE[Enc])>>SHIFT));
+			*right+=(int) (balance*(float)((chip->DSP.EFREG[i]*RPANTABLE[Enc])>>SHIFT));
+		}
+	}
+#endif
+}
+
+/*
+ * Slave SCSP thread. For each frame, SCSP_DoMasterSamples() posts
+ * s_slaveFrame and then requests samples one at a time by bumping
+ * s_slaveRequested; the thread answers each by bumping s_slaveCompleted. A
+ * last request with s_slaveFrameOver set sends it back to waiting for the
+ * next frame. The wait for each sample is far too short to sleep through, so
+ * both sides spin.
+ */
+static CThread		*s_slaveThread = NULL;
+static CSemaphore	*s_slaveFrame = NULL;
+alignas(64) static std::atomic<unsigned>	s_slaveRequested;	// on their own cache lines
+alignas(64) static std::atomic<unsigned>	s_slaveCompleted;
+static bool			s_slaveFrameOver = false;
+static bool			s_slaveQuit = false;
+static float		s_slaveBalance;
+static signed int	s_slaveLeft, s_slaveRight;
+
+template <class Ready>
+static inline void SCSP_SpinUntil(Ready ready)
+{
+	for(int spins=0;!ready();++spins)
+	{
+		if(spins>=1000)
+			std::this_thread::yield();
+	}
+}
+
+static inline unsigned SCSP_RequestSlave()
+{
+	unsigned requested=s_slaveRequested.load(std::memory_order_relaxed)+1;
+	s_slaveRequested.store(requested,std::memory_order_release);
+	return requested;
+}
+
+static int SCSP_SlaveThread(void *)
+{
+	while(s_slaveFrame->Wait() && !s_slaveQuit)
+	{
+		for(;;)
+		{
+			unsigned completed=s_slaveCompleted.load(std::memory_order_relaxed);
+			SCSP_SpinUntil([&]() { return s_slaveRequested.load(std::memory_order_acquire)!=completed; });
+			bool frameOver=s_slaveFrameOver;
+			if(!frameOver)
+			{
+				s_slaveLeft=0;
+				s_slaveRight=0;
+				SCSP_DoChipSample(&SCSPs[1],s_slaveBalance,&s_slaveLeft,&s_slaveRight);
+			}
+			s_slaveCompleted.store(completed+1,std::memory_order_release);
+			if(frameOver)
+				break;
+		}
+	}
+	return 0;
+}
+
+static bool SCSP_StartSlaveThread()
+{
+	s_slaveRequested=0;
+	s_slaveCompleted=0;
+	s_slaveQuit=false;
+	s_slaveFrame=CThread::CreateSemaphore(0);
+	if(NULL==s_slaveFrame)
+		return false;
+	s_slaveThread=CThread::CreateThread(SCSP_SlaveThread,NULL);
+	if(NULL==s_slaveThread)
+	{
+		delete s_slaveFrame;
+		s_slaveFrame=NULL;
+		return false;
+	}
+	return true;
+}
+
+static void SCSP_StopSlaveThread()
+{
+	if(NULL==s_slaveThread)
+		return;
+	s_slaveQuit=true;
+	s_slaveFrame->Post();
+	s_slaveThread->Wait();
+	delete s_slaveThread;
+	delete s_slaveFrame;
+	s_slaveThread=NULL;
+	s_slaveFrame=NULL;
+}
+
 void SCSP_CpuRunScanline()
 {
 
@@ -1788,110 +1951,35 @@ void SCSP_DoMasterSamples(int nsamples)
 	/*
 	 * Generate samples
 	 */
+	bool slaveThreaded=HasSlaveSCSP && NULL!=s_slaveThread;
+	if(slaveThreaded)
+	{
+		s_slaveBalance=slaveBalance;
+		s_slaveFrameOver=false;
+		s_slaveFrame->Post();
+	}
+	
 	for(int s=0;s<nsamples;++s)
 	{
 		signed int smpl=0;
 		signed int smpr=0;
 
-		for(int sl=0;sl<32;++sl)
+		if(slaveThreaded)
 		{
-			if(SCSPs[0].Slots[sl].active)
-			{
-				_SLOT *slot=SCSPs[0].Slots+sl;
-				unsigned short Enc=((TL(slot))<<0x8)|((DIPAN(slot))<<0x0)|((DISDL(slot))<<0x5);
-				RBUFDST=SCSPs[0].RINGBUF+SCSPs[0].BUFPTR;
-				signed int sample;
-				//signed int sample=(int) (masterBalance*(float)SCSP_UpdateSlot(slot));
-				//if(SA(slot)!=0x2ccf4)
-				/*if(SA(slot)!=0x1c77e)
-					sample=0;
-				else*/
-					sample= (int) (masterBalance*(float)SCSP_UpdateSlot(slot));
-
-				
-				/*unsigned char ef=EFSDL(slot);
-				ef+=DISDL(slot);
-				if(ef>0xf) ef=0xf;
-				unsigned short Enc=((TL(slot))<<0x0)|((DIPAN(slot))<<0x8)|((ef)<<0xd);
-				*/
-#ifdef USEDSP
-				// Spindizzi's fix for the VF3 cave stage
-				//SCSPDSP_SetSample(&SCSPs[0].DSP,/*sample>>5*/(sample*LPANTABLE[(Enc|0xE0)&0xFFE0])>>(SHIFT+3)/*>>SHIFT*/,ISEL(slot),IMXL(slot));
-				SCSPDSP_SetSample(&SCSPs[0].DSP,/*sample>>5*/(sample*LPANTABLE[(Enc|0xE0)/*&0xFFE0*/])>>(SHIFT+3)/*>>SHIFT*/,ISEL(slot),IMXL(slot));
-#endif
-
-#ifdef RB_VOLUME
-				smpl += (sample * volume[TL(slot)+pan_left [DIPAN(slot)]])>>17;
-				smpr += (sample * volume[TL(slot)+pan_right[DIPAN(slot)]])>>17;
-#else				
-
-				//if(sl==cnts)
-				{
-					smpl+=(sample*LPANTABLE[Enc])>>SHIFT;
-					smpr+=(sample*RPANTABLE[Enc])>>SHIFT;
-				}
-#endif
-			}
-			++SCSPs[0].BUFPTR;
-			SCSPs[0].BUFPTR&=63;
-			if(HasSlaveSCSP)
-			{
-				if(SCSPs[1].Slots[sl].active)
-				{
-					_SLOT *slot=SCSPs[1].Slots+sl;
-					unsigned short Enc=((TL(slot))<<0x8)|((DIPAN(slot))<<0x0)|((DISDL(slot))<<0x5);
-					RBUFDST=SCSPs[1].RINGBUF+SCSPs[1].BUFPTR;
-					signed int sample=(int) (slaveBalance*(float)SCSP_UpdateSlot(slot));
-#ifdef USEDSP
-					SCSPDSP_SetSample(&SCSPs[1].DSP,(sample*LPANTABLE[(Enc|0xE0)&0xFFE0])>>(SHIFT+3),ISEL(slot),IMXL(slot));
-#endif
-#ifdef RB_VOLUME
-					smpl += (sample * volume[TL(slot)+pan_left [DIPAN(slot)]])>>17;
-					smpr += (sample * volume[TL(slot)+pan_right[DIPAN(slot)]])>>17;
-#else				
-					smpl+=(sample*LPANTABLE[Enc])>>SHIFT;
-					smpr+=(sample*RPANTABLE[Enc])>>SHIFT;
-#endif
-				}
-				++SCSPs[1].BUFPTR;
-				SCSPs[1].BUFPTR&=63;
-			}
+			unsigned requested=SCSP_RequestSlave();
+			SCSP_DoChipSample(&SCSPs[0],masterBalance,&smpl,&smpr);
+			SCSP_SpinUntil([&]() { return s_slaveCompleted.load(std::memory_order_acquire)==requested; });
+			smpl+=s_slaveLeft;
+			smpr+=s_slaveRight;
 		}
-#define ICLIP16(x) (x<-32768)?-32768:((x>32767)?32767:x)
-#ifdef USEDSP
-		SCSPDSP_Step(&SCSPs[0].DSP);
-		if(HasSlaveSCSP)
-			SCSPDSP_Step(&SCSPs[1].DSP);
-
-//		smpl=0;
-//		smpr=0;
-		for(int i=0;i<16;++i)
+		else
 		{
-			_SLOT *slot=SCSPs[0].Slots+i;
-			int ef=EFSDL(slot);
-			if(ef)
-			{
-				unsigned short Enc=0|((EFPAN(slot))<<0x0)|((EFSDL(slot))<<0x5);
-				signed int leftSample  = (int) (masterBalance*(float)((SCSPs[0].DSP.EFREG[i]*LPANTABLE[Enc])>>SHIFT));
-				signed int rightSample = (int) (masterBalance*(float)((SCSPs[0].DSP.EFREG[i]*RPANTABLE[Enc])>>SHIFT));
-				smpl+=leftSample;
-				smpr+=rightSample;
-			}
+			SCSP_DoChipSample(&SCSPs[0],masterBalance,&smpl,&smpr);
 			if(HasSlaveSCSP)
-			{
-				_SLOT *slot=SCSPs[1].Slots+i;
-				ef=EFSDL(slot);
-				if(ef)
-				{
-					unsigned short Enc=0|((EFPAN(slot))<<0x0)|((EFSDL(slot))<<0x5);
-					signed int leftSample  = (int) (slaveBalance*(float)((SCSPs[1].DSP.EFREG[i]*LPANTABLE[Enc])>>SHIFT));
-					signed int rightSample = (int) (slaveBalance*(float)((SCSPs[1].DSP.EFREG[i]*RPANTABLE[Enc])>>SHIFT));
-					smpl+=leftSample;
-					smpr+=rightSample;
-				}
-			}
+				SCSP_DoChipSample(&SCSPs[1],slaveBalance,&smpl,&smpr);
 		}
-#endif
+
+#define ICLIP16(x) (x<-32768)?-32768:((x>32767)?32767:x)
 #ifdef REVERB
 		smpl+=bufferrevl[RevR];
 		smpr+=bufferrevr[RevR];
@@ -1929,6 +2017,13 @@ void SCSP_DoMasterSamples(int nsamples)
 
 		lastdiff=Run68kCB(slice-lastdiff);
 	}
+
+	if(slaveThreaded)
+	{
+		s_slaveFrameOver=true;
+		unsigned requested=SCSP_RequestSlave();
+		SCSP_SpinUntil([&]() { return s_slaveCompleted.load(std::memory_order_acquire)==requested; });
+	}
 }
 #endif
 
@@ -2342,8 +2437,11 @@ void SCSP_SetBuffers(INT16 *leftBufferPtr, INT16 *rightBufferPtr, int bufferLeng
 
 void SCSP_Deinit(void)
 {
+	SCSP_StopSlaveThread();
 #ifdef USEDSP
 	free(SCSP->MIXBuf);
+	for(int i=0;i<MAX_SCSP;++i)
+		SCSPDSP_Deinit(&SCSPs[i].DSP);
 #endif
 	free(buffertmpl);
 	free(buffertmpr);
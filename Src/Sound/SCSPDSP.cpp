@@ -43,14 +43,6 @@
 //this doesn't work at all
 //#define USEFLOATPACK
 
-//the PACK func in asm plus mov [esi],ax
-unsigned char PackFunc[]={0x8B,0xD8,0xA9,0x00,0x00,0x80,0x00,0x75,0x02,0xF7,0xD3,0xF7,0xD3,0x0F,0xBD,0xCB,
-						  0xF7,0xD9,0xC1,0xE0,0x08,0x83,0xC1,0x16,0xD3,0xE0,0xC1,0xF8,0x13,0xC1,0xE1,0x0B,
-						  0x25,0xFF,0x87,0x00,0x00,0x0B,0xC1,0x66,0x89,0x06};
-unsigned char UnpackFunc[]={0x8B,0xD8,0x8B,0xC8,0x81,0xE3,0x00,0x80,0x00,0x00,0x25,0xFF,0x07,
-							0x00,0x00,0xC1,0xE9,0x0B,0xC1,0xE0,0x0B,0xC1,0xE3,0x08,0x83,0xE1,0x0F,0x0B,0xC3,
-							0xD1,0xEB,0x81,0xF3,0x00,0x00,0x40,0x00,0x0B,0xC3,0x83,0xC1,0x08,0xC1,0xE0,0x08,
-							0xD3,0xF8};
 #if 0
 unsigned short inline PACK(signed int val)
 {
@@ -202,8 +194,7 @@ void SCSPDSP_Init(_SCSPDSP *DSP)
 	DSP->RBL=0x8000;
 	DSP->Stopped=true;
 }
-#ifndef DYNDSP
-void SCSPDSP_Step(_SCSPDSP *DSP)
+void SCSPDSP_StepInterpreted(_SCSPDSP *DSP)
 {
 	if(DSP->Stopped)
 		return;
@@ -469,103 +460,6 @@ void SCSPDSP_Step(_SCSPDSP *DSP)
 	if(f)
 		fclose(f);
 }
-#else
-
-FILE *f=NULL;
-
-void SCSPDSP_Step(_SCSPDSP *DSP)
-{
-	if(DSP->Stopped)
-		return;
-
-	memset(DSP->EFREG,0,2*16);
-	
-	assert(DSP->DoSteps!=NULL);
-
-	int dump=0;
-	if(dump)
-		f=fopen("dsp2.txt","wt");
-
-	DSP->DoSteps();
-
-	if(f)
-	{
-		fclose(f);
-		f=NULL;
-	}
-
-	--DSP->DEC;
-	memset(DSP->MIXS,0,4*16);
-
-}
-
-void __fastcall dumpreg(_SCSPDSP *DSP)
-{
-	static int n=0;
-	//f=fopen("dsp2.txt","a+t");
-		if(f)
-		{
-#define DUMP(v)	fprintf(f," " #v ": %04X",DSP->v);
-			
-			fprintf(f,"%d: ",n++);
-			DUMP(ACC);
-			DUMP(SHIFTED);
-			DUMP(X);
-			DUMP(Y);
-			DUMP(B);
-			DUMP(INPUTS);
-			DUMP(MEMVAL);
-			DUMP(FRC_REG);
-			DUMP(Y_REG);
-			DUMP(ADDR);
-			DUMP(ADRS_REG);
-			fprintf(f,"\n");
-		}
-}
-
-#define EMIT8(x) *PtrInsts=x; ++PtrInsts;
-#define EMIT16(x) *((unsigned short *) PtrInsts)=x; PtrInsts+=2;
-#define EMIT32(x) *((unsigned int *) PtrInsts)=x; PtrInsts+=4;
-
-#define MOV_EAXTOMEM(addr)	EMIT8(0xA3); EMIT32((unsigned int) addr);
-#define MOV_MEMTOEAX(addr)	EMIT8(0xA1); EMIT32((unsigned int) addr);
-#define MOV_MEMTOAX(addr)	EMIT8(0x66); EMIT8(0xA1); EMIT32((unsigned int) addr);
-#define MOV_MEMTOEBX(addr)	EMIT8(0x8B); EMIT8(0x1D); EMIT32((unsigned int) addr);
-#define ADD_MEMTOEAX(addr)	EMIT8(0x03); EMIT8(0x05); EMIT32((unsigned int) addr);
-#define ADD_EAXTOMEM(addr)	EMIT8(0x01); EMIT8(0x05); EMIT32((unsigned int) addr);
-#define ADD_AXTOMEM(addr)	EMIT8(0x66); EMIT8(0x01); EMIT8(0x05); EMIT32((unsigned int) addr);
-#define MOV_IMMTOEAX(imm)	EMIT8(0xB8); EMIT32((unsigned int) imm);
-#define MOV_IMMTOECX(imm)	EMIT8(0xB9); EMIT32((unsigned int) imm);
-#define ADD_IMMTOEAX(imm)	EMIT8(0x05); EMIT32((unsigned int) imm);
-#define ADD_EBXTOEAX()		EMIT8(0x03); EMIT8(0xC3);
-#define CMP_IMMTOEAX(imm)	EMIT8(0x3D); EMIT32((unsigned int) imm);
-#define MOV_0TOEAX()		EMIT8(0x33); EMIT8(0xC0);
-#define MOV_EAXTOEBX()		EMIT8(0x8B); EMIT8(0xD8);
-#define MOV_EAXTOECX()		EMIT8(0x8B); EMIT8(0xC8);
-#define NEG_EAX()			EMIT8(0xF7); EMIT8(0xD8);
-#define INC_EAX()			EMIT8(0x40);
-#define MOV_MEMEAXTOEAX()	EMIT8(0x8b); EMIT8(0x00);
-#define MOV_MEMEAXTOAX()	EMIT8(0x66); EMIT8(0x8b); EMIT8(0x00);
-#define MOV_EBXTOMEMEAX()	EMIT8(0x89); EMIT8(0x18);
-#define MOV_EAXTOMEMEBX()	EMIT8(0x89); EMIT8(0x03);
-#define MOV_AXTOMEMEBX()	EMIT8(0x66); EMIT8(0x89); EMIT8(0x03);
-#define SHL_EAX(count)		EMIT8(0xC1); EMIT8(0xE0); EMIT8(count);
-#define SHL_EBX(count)		EMIT8(0xC1); EMIT8(0xE3); EMIT8(count);
-#define SHL_EDX(count)		EMIT8(0xC1); EMIT8(0xE2); EMIT8(count);
-#define SHRD_EAX_EDX(count)	EMIT8(0x0F); EMIT8(0xAC); EMIT8(0xD0); EMIT8(count);
-#define SAR_EAX(count)		EMIT8(0xC1); EMIT8(0xF8); EMIT8(count);
-#define SHR_EAX(count)		EMIT8(0xC1); EMIT8(0xE8); EMIT8(count);
-#define AND_EAX(mask)		EMIT8(0x25); EMIT32(mask);
-#define AND_EBX(mask)		EMIT8(0x81); EMIT8(0xE3); EMIT32(mask);
-#define AND_EAX_EBX()		EMIT8(0x23); EMIT8(0xC3);
-#define DEC_EBX()			EMIT8(0x4B);
-#define OR_EAX_EDX()		EMIT8(0x0B); EMIT8(0xC2);
-#define ADD_EAX_ECX()		EMIT8(0x03); EMIT8(0xC1);
-#define IMUL_EAX_EBX()		EMIT8(0xF7); EMIT8(0xEB);
-//#define IMUL_EAX_EBX()		EMIT8(0xF7); EMIT8(0xE3);
-#define RET()				EMIT8(0xC3);
-#define PUSHA()				EMIT8(0x51); EMIT8(0x52); EMIT8(0x53); EMIT8(0x56); //ecx edx ebx esi
-#define POPA()				EMIT8(0x5E); EMIT8(0x5B); EMIT8(0x5A); EMIT8(0x59);	//esi ebx edx ecx
 
 struct _INST
 {
@@ -633,451 +527,516 @@ void DecodeInst(unsigned short *IPtr,_INST *i)
 	i->NXADR=(IPtr[3]>>0)&0x1;
 }
 
-#define USES_SHIFTED(inst)	(inst.TWT || inst.FRCL || inst.MWT || inst.ADRL || inst.EWT)
 
-void SCSPDSP_Recompile(_SCSPDSP *DSP)
+/******************************************************************************
+ x86-64 Recompiler
+
+ The microprogram is translated to straight-line code the first time it runs
+ after MPRO (or LastStep) changes. Everything that the interpreter decides per
+ step from the instruction word is decided here once; COEF, MADRS, RBP, RBL
+ and DEC are still read at run time, since the 68K may change them without
+ touching MPRO. The generated code gives exactly the same results as
+ SCSPDSP_StepInterpreted().
+
+ Register use:
+
+	rbx		DSP
+	ebp		ACC
+	r12d	MEMVAL
+	r13d	FRC_REG
+	r14d	Y_REG
+	r15d	ADRS_REG
+	esi		DEC
+	rdi		SCSPRAM
+	r8d		SHIFTED
+	r9d		INPUTS
+	eax, ecx, edx, r10d, r11d are scratch
+******************************************************************************/
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include <cstddef>
+
+#define DYNBUF_MAX_STEP	512		// upper bound on code emitted per step (and for the prologue/epilogue)
+
+enum { RAX=0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Instruction forms
+#define OP_W	0x08	// REX.W (64-bit operand)
+#define OP_16	0x100	// 0x66 prefix (16-bit operand)
+
+// Group opcode extensions
+#define ALU_ADD	0
+#define ALU_OR	1
+#define ALU_AND	4
+#define ALU_SUB	5
+#define ALU_XOR	6
+#define ALU_CMP	7
+#define SH_SHL	4
+#define SH_SHR	5
+#define SH_SAR	7
+
+#define DSP_OFS(field)	((INT32) offsetof(_SCSPDSP, field))
+
+static thread_local UINT8 *PtrInsts;	// the DSPs may be compiled on different threads
+
+static inline void emit8(UINT8 b)
 {
-	if(DSP->DoSteps)
-		free(DSP->DoSteps);
-	DSP->DoSteps=(void (*)()) malloc(DYNBUF);
-	unsigned char *PtrInsts=(unsigned char *)DSP->DoSteps;
+	*PtrInsts++ = b;
+}
 
-	PUSHA();
+static inline void emit32(UINT32 d)
+{
+	memcpy(PtrInsts, &d, 4);
+	PtrInsts += 4;
+}
 
-	for(int step=0;step</*128*/DSP->LastStep;++step)
+// Prefixes and opcode (up to 3 bytes, most significant first)
+static void emit_op(int flags, UINT32 op, int reg, int index, int base)
+{
+	if (flags & OP_16)
+		emit8(0x66);
+	UINT8 rex = 0x40 | (flags & OP_W) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+	if (rex != 0x40)
+		emit8(rex);
+	if (op > 0xFFFF)
+		emit8(op >> 16);
+	if (op > 0xFF)
+		emit8(op >> 8);
+	emit8(op);
+}
+
+// op reg,rm (register operands)
+static void emit_rr(int flags, UINT32 op, int reg, int rm)
+{
+	emit_op(flags, op, reg, 0, rm);
+	emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op reg,[base+index*(1<<scale)+disp] (index < 0 for none)
+static void emit_rm(int flags, UINT32 op, int reg, int base, INT32 disp, int index = -1, int scale = 0)
+{
+	emit_op(flags, op, reg, index < 0 ? 0 : index, base);
+	if (index < 0 && (base & 7) != RSP)
+		emit8(0x80 | ((reg & 7) << 3) | (base & 7));
+	else
 	{
-		unsigned short *IPtr=&(DSP->MPRO[step*4]);
-		_INST ThisInst,NextInst;
-		DecodeInst(IPtr,&ThisInst);
-		DecodeInst(IPtr+4,&NextInst);
-		
+		emit8(0x84 | ((reg & 7) << 3));
+		emit8((scale << 6) | (((index < 0) ? RSP : index) & 7) << 3 | (base & 7));
+	}
+	emit32(disp);
+}
 
+static void emit_mov_rr(int dst, int src)		{ emit_rr(0, 0x89, src, dst); }
+static void emit_alu_imm(int n, int reg, UINT32 imm)	{ emit_rr(0, 0x81, n, reg); emit32(imm); }
+static void emit_shift(int n, int reg, UINT8 count)	{ emit_rr(0, 0xC1, n, reg); emit8(count); }
 
-		EMIT8(0x90);
+static void emit_mov_imm(int reg, UINT32 imm)
+{
+	emit_op(0, 0xB8 + (reg & 7), 0, 0, reg);
+	emit32(imm);
+}
 
-		MOV_IMMTOECX(DSP);
-		MOV_IMMTOEAX(dumpreg);
-		EMIT8(0xFF); EMIT8(0xD0);
+static void emit_push(int reg)
+{
+	emit_op(0, 0x50 + (reg & 7), 0, 0, reg);
+}
 
-		//INPUTS RW
-		assert(ThisInst.IRA<0x32);
-		if((ThisInst.XSEL || ThisInst.YRL || ThisInst.ADRL) || !DYNOPT)
-		{
-			if(ThisInst.IRA<=0x1f)
-			{
-				//INPUTS=DSP->MEMS[IRA];	
-				MOV_MEMTOEAX(&(DSP->MEMS[ThisInst.IRA]));
-				SHL_EAX(8);
-			}
-			else if(ThisInst.IRA<=0x2F)
-			{
-				//INPUTS=DSP->MIXS[IRA-0x20]<<8;	//MIXS is 16 bit
-				MOV_MEMTOEAX(&(DSP->MIXS[ThisInst.IRA-0x20]));
-				SHL_EAX(8);
-			}
-			else if(ThisInst.IRA<=0x31)
-			{
-				MOV_MEMTOEAX(&(DSP->EXTS[ThisInst.IRA-0x30]));
-				SHL_EAX(8);				
-			}
-			else
-			{
-				MOV_0TOEAX();
-			}
-			SAR_EAX(8);
-			
-			MOV_EAXTOMEM(&(DSP->INPUTS));
-		}
+static void emit_pop(int reg)
+{
+	emit_op(0, 0x58 + (reg & 7), 0, 0, reg);
+}
 
-		if(ThisInst.IWT)
-		{
-			MOV_MEMTOEAX(&DSP->MEMVAL);
-			MOV_EAXTOMEM(&DSP->MEMS[ThisInst.IWA]);
-			//DSP->MEMS[IWA]=MEMVAL;	//MEMVAL was selected in previous MRD
-			if(ThisInst.IRA==ThisInst.IWA)
-			{
-				//INPUTS=MEMVAL;
-				MOV_EAXTOMEM(&DSP->INPUTS);
-			}
-		}
-		
-		if((USES_SHIFTED(NextInst) || NextInst.BSEL) || !DYNOPT)
-		{
-			//Operand sel
-			//B
-			if(!ThisInst.ZERO)
-			{
-				if(ThisInst.BSEL)
-				{
-					//B=ACC;
-					MOV_MEMTOEAX(&DSP->ACC);
-	//				MOV_EAXTOMEM(&DSP->B);	//
-				}
-				else
-				{
-					MOV_IMMTOEAX(ThisInst.TRA);
-					ADD_MEMTOEAX(&(DSP->DEC));
-					AND_EAX(0x7F);
-					SHL_EAX(2);
-					ADD_IMMTOEAX(&(DSP->TEMP));
-					MOV_MEMEAXTOEAX();
-					SHL_EAX(8);
-					SAR_EAX(8);
-	//				MOV_EAXTOMEM(&DSP->B);	//
-
-
-					//B=DSP->TEMP[(TRA+DSP->DEC)&0x7F];
-					//B<<=8;
-					//B>>=8;
-					//if(B&0x00800000)
-					//	B|=0xFF000000;	//Sign extend
-				}
-				if(ThisInst.NEGB)
-				{
-					//B=0-B;
-					NEG_EAX();
-				}
-			}
-			else
-			{
-				MOV_0TOEAX();
-			}
-			//MOV_EAXTOMEM(&DSP->B);
-			MOV_EAXTOECX();
+// reg=sign extended low 24 bits of reg
+static void emit_sext24(int reg)
+{
+	emit_shift(SH_SHL, reg, 8);
+	emit_shift(SH_SAR, reg, 8);
+}
 
-			//X
-			if(ThisInst.XSEL)
-			{
-				//X=INPUTS;
-				MOV_MEMTOEAX(&DSP->INPUTS);
-	//			MOV_EAXTOMEM(&DSP->X);	//
-			}
-			else
-			{
-				//X=DSP->TEMP[(TRA+DSP->DEC)&0x7F];
-				//X<<=8;
-				//X>>=8;
-				MOV_IMMTOEAX(ThisInst.TRA);
-				ADD_MEMTOEAX(&(DSP->DEC));
-				AND_EAX(0x7F);
-				SHL_EAX(2);
-				ADD_IMMTOEAX(&(DSP->TEMP));
-				MOV_MEMEAXTOEAX();
-				SHL_EAX(8);
-				SAR_EAX(8);
-				//if(X&0x00800000)
-				//	X|=0xFF000000;
-	//			MOV_EAXTOMEM(&DSP->X);	//
-			}
-			MOV_EAXTOEBX();
-		}
+// reg=TEMP[(ofs+DEC)&0x7F], sign extended from 24 bits
+static void emit_load_temp(int reg, unsigned ofs)
+{
+	emit_rm(0, 0x8D, RAX, RSI, ofs);						// lea eax,[rsi+ofs]
+	emit_alu_imm(ALU_AND, RAX, 0x7F);
+	emit_rm(0, 0x8B, reg, RBX, DSP_OFS(TEMP), RAX, 2);		// mov reg,[rbx+rax*4+TEMP]
+	emit_sext24(reg);
+}
 
+// r10w=PACK(SHIFTED)
+static void emit_pack(void)
+{
+	emit_mov_rr(RDX, R8);									// edx=val
+	emit_mov_rr(R10, R8);
+	emit_rr(0, 0x01, R10, R10);								// add r10d,r10d
+	emit_rr(0, 0x31, RDX, R10);								// xor r10d,edx
+	emit_alu_imm(ALU_AND, R10, 0xFFFFFF);
+	emit_alu_imm(ALU_OR, R10, 0x800);						// caps the exponent at 12
+	emit_rr(0, 0x0FBD, RCX, R10);							// bsr ecx,r10d
+	emit_rr(0, 0xF7, 3, RCX);								// neg ecx
+	emit_alu_imm(ALU_ADD, RCX, 23);							// ecx=exponent
+	emit_mov_rr(R10, RDX);
+	emit_rr(0, 0xD3, SH_SHL, R10);							// shl r10d,cl
+	emit_alu_imm(ALU_AND, R10, 0x3FFFFF);
+	emit_shift(SH_SHR, R10, 11);
+	emit_rr(0, 0x0FB7, R11, RDX);							// movzx r11d,dx (val<<11>>11 when exponent is 12)
+	emit_alu_imm(ALU_CMP, RCX, 12);
+	emit_rr(0, 0x0F44, R10, R11);							// cmove r10d,r11d
+	emit_shift(SH_SHR, RDX, 23);
+	emit_alu_imm(ALU_AND, RDX, 1);
+	emit_shift(SH_SHL, RDX, 15);
+	emit_rr(0, 0x09, RDX, R10);								// or r10d,edx (sign)
+	emit_shift(SH_SHL, RCX, 11);
+	emit_rr(0, 0x09, RCX, R10);								// or r10d,ecx (exponent)
+}
 
-		//if(TWT || /*MRD ||*/ MWT || EWT || ADRL || FRCL)
-		if(USES_SHIFTED(ThisInst) || !DYNOPT)
-		{
-			if(ThisInst.SHIFT==0)
-			{
-				MOV_MEMTOEAX(&DSP->ACC);
-				CMP_IMMTOEAX(0x007FFFFF);
-				EMIT8(0x7E); EMIT8(0x05);	//JLE
-				MOV_IMMTOEAX(0x007FFFFF);
-				CMP_IMMTOEAX(0xFF800000);
-				EMIT8(0x7D); EMIT8(0x05);	//JGE
-				MOV_IMMTOEAX(0xFF800000);
-
-
-				//SHIFTED=ACC;
-				//if(SHIFTED>0x007FFFFF)
-				//	SHIFTED=0x007FFFFF;
-				//if(SHIFTED<(-0x00800000))
-				//	SHIFTED=-0x00800000;
-			}
-			else if(ThisInst.SHIFT==1)
-			{
-				//SHIFTED=ACC*2;
-				MOV_MEMTOEAX(&DSP->ACC);
-				SHL_EAX(1);
-				CMP_IMMTOEAX(0x007FFFFF);
-				EMIT8(0x7E); EMIT8(0x05);	//JLE
-				MOV_IMMTOEAX(0x007FFFFF);
-				CMP_IMMTOEAX(0xFF800000);
-				EMIT8(0x7D); EMIT8(0x05);	//JGE
-				MOV_IMMTOEAX(0xFF800000);
-				//if(SHIFTED>0x007FFFFF)
-				//	SHIFTED=0x007FFFFF;
-				//if(SHIFTED<(-0x00800000))
-				//	SHIFTED=-0x00800000;
-			}
-			else if(ThisInst.SHIFT==2)
-			{
-				//SHIFTED=ACC*2;
-				//SHIFTED<<=8;
-				//SHIFTED>>=8;
-				MOV_MEMTOEAX(&DSP->ACC);
-				SHL_EAX(9);
-				SAR_EAX(8);
-				//SHIFTED&=0x00FFFFFF;
-				//if(SHIFTED&0x00800000)
-				//	SHIFTED|=0xFF000000;
-			}
-			else if(ThisInst.SHIFT==3)
-			{
-				//SHIFTED=ACC;
-				//SHIFTED<<=8;
-				//SHIFTED>>=8;
-				MOV_MEMTOEAX(&DSP->ACC);
-				SHL_EAX(8);
-				SAR_EAX(8);
-				//SHIFTED&=0x00FFFFFF;
-				//if(SHIFTED&0x00800000)
-				//	SHIFTED|=0xFF000000;
-			}
-			MOV_EAXTOMEM(&DSP->SHIFTED);
-		}
+// r12d=UNPACK(SCSPRAM[rax]), destroys rax
+static void emit_unpack(void)
+{
+	emit_rm(0, 0x0FB7, RDX, RDI, 0, RAX, 1);				// movzx edx,word [rdi+rax*2]
+	emit_mov_rr(RCX, RDX);
+	emit_shift(SH_SHR, RCX, 11);
+	emit_alu_imm(ALU_AND, RCX, 0xF);						// ecx=exponent
+	emit_mov_rr(R12, RDX);
+	emit_alu_imm(ALU_AND, R12, 0x7FF);
+	emit_shift(SH_SHL, R12, 11);							// r12d=mantissa<<11
+	emit_mov_rr(R10, RDX);
+	emit_shift(SH_SHR, R10, 15);							// r10d=sign
+	emit_mov_rr(R11, R10);
+	emit_alu_imm(ALU_XOR, R11, 1);
+	emit_shift(SH_SHL, R11, 22);							// r11d=(sign^1)<<22
+	emit_rr(0, 0x31, RAX, RAX);								// xor eax,eax
+	emit_alu_imm(ALU_CMP, RCX, 11);
+	emit_rr(0, 0x0F47, R11, RAX);							// cmova r11d,eax
+	emit_mov_imm(RAX, 11);
+	emit_rr(0, 0x0F47, RCX, RAX);							// cmova ecx,eax
+	emit_rr(0, 0x09, R11, R12);								// or r12d,r11d
+	emit_shift(SH_SHL, R10, 23);
+	emit_rr(0, 0x09, R10, R12);								// or r12d,r10d
+	emit_sext24(R12);
+	emit_rr(0, 0xD3, SH_SAR, R12);							// sar r12d,cl
+}
 
-		if((USES_SHIFTED(NextInst) || NextInst.BSEL) || !DYNOPT)
-		{
-			//Y
-			if(ThisInst.YSEL==0)
-			{
-				//Y=FRC_REG;
-				MOV_MEMTOEAX(&DSP->FRC_REG);
-			}
-			else if(ThisInst.YSEL==1)
-			{
-				//MOV_0TOEAX();
-				MOV_MEMTOAX(&DSP->COEF[ThisInst.COEF]);
-				SAR_EAX(3);
-				//Y=DSP->COEF[COEF]>>3;	//COEF is 16 bits
-			}
-			else if(ThisInst.YSEL==2)
-			{
-				//Y=(Y_REG>>11)&0x1FFF;
-				MOV_MEMTOEAX(&DSP->Y_REG);
-				SAR_EAX(11);
-				AND_EAX(0x1FFF);
-			}
-			else if(ThisInst.YSEL==3)
-			{
-				//Y=(Y_REG>>4)&0x0FFF;
-				MOV_MEMTOEAX(&DSP->Y_REG);
-				SAR_EAX(4);
-				AND_EAX(0x0FFF);
-			}
+// dst=src clamped to 24 bits
+static void emit_clamp24(int reg)
+{
+	emit_mov_imm(RAX, 0x007FFFFF);
+	emit_rr(0, 0x39, RAX, reg);								// cmp reg,eax
+	emit_rr(0, 0x0F4F, reg, RAX);							// cmovg reg,eax
+	emit_mov_imm(RAX, (UINT32) -0x00800000);
+	emit_rr(0, 0x39, RAX, reg);
+	emit_rr(0, 0x0F4C, reg, RAX);							// cmovl reg,eax
+}
 
-			SHL_EAX(19);
-			SAR_EAX(19);
-	//		MOV_EAXTOMEM(&DSP->Y);	//
+static void EmitStep(const _INST &i, int step)
+{
+	bool memAccess = (i.MRD || i.MWT) && (step & 1);	// memory only allowed on odd steps
+	bool usesShifted = i.TWT || i.FRCL || (i.MWT && memAccess) || (i.ADRL && i.SHIFT == 3) || i.EWT;
 
+	//INPUTS
+	if (i.IRA <= 0x1F)
+	{
+		emit_rm(0, 0x8B, R9, RBX, DSP_OFS(MEMS) + i.IRA * 4);
+		emit_sext24(R9);
+	}
+	else if (i.IRA <= 0x2F)
+	{
+		emit_rm(0, 0x8B, R9, RBX, DSP_OFS(MIXS) + (i.IRA - 0x20) * 4);
+		emit_sext24(R9);
+	}
+	else if (i.IRA <= 0x31)
+		emit_rm(0, 0x0FBF, R9, RBX, DSP_OFS(EXTS) + (i.IRA - 0x30) * 2);	// movsx r9d,word
+	else
+		emit_rr(0, 0x31, R9, R9);							// xor r9d,r9d
 
+	if (i.IWT)
+	{
+		emit_rm(0, 0x89, R12, RBX, DSP_OFS(MEMS) + i.IWA * 4);
+		if (i.IRA == i.IWA)
+			emit_mov_rr(R9, R12);
+	}
 
-			//X:EBX
-			//B:ECX
-			//Y:EAX
-			IMUL_EAX_EBX();
-	//		SHR_EAX(12);
-	//		SHL_EDX((32-12));
-			SHRD_EAX_EDX(12);
-			ADD_EAX_ECX();
+	//Operand sel: TEMP (r10d), B (edx), X (r10d), Y (ecx)
+	bool bFromTemp = !i.ZERO && !i.BSEL;
+	if (bFromTemp || !i.XSEL)
+		emit_load_temp(R10, i.TRA);
 
-			MOV_EAXTOMEM(&DSP->ACC);
-		}
+	if (!i.ZERO)
+	{
+		emit_mov_rr(RDX, i.BSEL ? RBP : R10);
+		if (i.NEGB)
+			emit_rr(0, 0xF7, 3, RDX);						// neg edx
+	}
+
+	if (i.XSEL)
+		emit_mov_rr(R10, R9);
+
+	switch (i.YSEL)
+	{
+	case 0:
+		emit_mov_rr(RCX, R13);
+		emit_shift(SH_SHL, RCX, 19);						// sign extend from 13 bits
+		emit_shift(SH_SAR, RCX, 19);
+		break;
+	case 1:
+		emit_rm(0, 0x0FBF, RCX, RBX, DSP_OFS(COEF) + i.COEF * 2);	// movsx ecx,word
+		emit_shift(SH_SAR, RCX, 3);
+		break;
+	case 2:
+		emit_mov_rr(RCX, R14);
+		emit_shift(SH_SHR, RCX, 11);
+		emit_shift(SH_SHL, RCX, 19);						// bits 11-23 of Y_REG, sign extended from 13 bits
+		emit_shift(SH_SAR, RCX, 19);
+		break;
+	case 3:
+		emit_mov_rr(RCX, R14);
+		emit_shift(SH_SHR, RCX, 4);
+		emit_alu_imm(ALU_AND, RCX, 0x0FFF);
+		break;
+	}
+
+	if (i.YRL)
+		emit_mov_rr(R14, R9);
+
+	//Shifter
+	if (usesShifted)
+	{
+		emit_mov_rr(R8, RBP);
+		if (i.SHIFT == 1 || i.SHIFT == 2)
+			emit_rr(0, 0x01, R8, R8);						// add r8d,r8d
+		if (i.SHIFT <= 1)
+			emit_clamp24(R8);
+		else
+			emit_sext24(R8);
+	}
 
-		if(ThisInst.YRL)
+	//ACCUM
+	emit_rr(OP_W, 0x63, R10, R10);							// movsxd r10,r10d
+	emit_rr(OP_W, 0x63, RCX, RCX);							// movsxd rcx,ecx
+	emit_rr(OP_W, 0x0FAF, R10, RCX);						// imul r10,rcx
+	emit_rr(OP_W, 0xC1, SH_SAR, R10); emit8(12);			// sar r10,12
+	if (!i.ZERO)
+		emit_rr(0, 0x01, RDX, R10);							// add r10d,edx
+	emit_mov_rr(RBP, R10);
+
+	if (i.TWT)
+	{
+		emit_rm(0, 0x8D, RAX, RSI, i.TWA);					// lea eax,[rsi+TWA]
+		emit_alu_imm(ALU_AND, RAX, 0x7F);
+		emit_rm(0, 0x89, R8, RBX, DSP_OFS(TEMP), RAX, 2);	// mov [rbx+rax*4+TEMP],r8d
+	}
+
+	if (i.FRCL)
+	{
+		emit_mov_rr(R13, R8);
+		if (i.SHIFT == 3)
+			emit_alu_imm(ALU_AND, R13, 0x0FFF);
+		else
 		{
-			MOV_MEMTOEAX(&DSP->INPUTS);
-			MOV_EAXTOMEM(&DSP->Y_REG);
-			//Y_REG=INPUTS;
+			emit_shift(SH_SAR, R13, 11);
+			emit_alu_imm(ALU_AND, R13, 0x1FFF);
 		}
+	}
 
-		if(ThisInst.TWT)
+	if (memAccess)
+	{
+		//ADDR (eax)
+		emit_rm(0, 0x0FB7, RAX, RBX, DSP_OFS(MADRS) + i.MASA * 2);	// movzx eax,word
+		if (!i.TABLE)
+			emit_rr(0, 0x01, RSI, RAX);						// add eax,esi
+		if (i.ADREB)
+		{
+			emit_mov_rr(RCX, R15);
+			emit_alu_imm(ALU_AND, RCX, 0x0FFF);
+			emit_rr(0, 0x01, RCX, RAX);						// add eax,ecx
+		}
+		if (i.NXADR)
+			emit_alu_imm(ALU_ADD, RAX, 1);
+		if (!i.TABLE)
 		{
-			MOV_MEMTOEAX(&DSP->SHIFTED);
-			MOV_EAXTOEBX();
-			//DSP->TEMP[(TWA+DSP->DEC)&0x7F]=SHIFTED;
-			MOV_IMMTOEAX(ThisInst.TWA);
-			ADD_MEMTOEAX(&(DSP->DEC));
-			AND_EAX(0x7F);
-			SHL_EAX(2);
-			ADD_IMMTOEAX(&(DSP->TEMP));
-			MOV_EBXTOMEMEAX();
+			emit_rm(0, 0x8B, RCX, RBX, DSP_OFS(RBL));
+			emit_alu_imm(ALU_SUB, RCX, 1);
+			emit_rr(0, 0x21, RCX, RAX);						// and eax,ecx
 		}
+		else
+			emit_alu_imm(ALU_AND, RAX, 0xFFFF);
+		emit_rm(0, 0x8B, RCX, RBX, DSP_OFS(RBP));
+		emit_shift(SH_SHL, RCX, 12);
+		emit_rr(0, 0x01, RCX, RAX);							// add eax,ecx
 
-		if(ThisInst.FRCL)
+		if (i.MWT)
 		{
-			if(ThisInst.SHIFT==3)
+			if (i.NOFL)
 			{
-				//FRC_REG=SHIFTED&0x0FFF;
-				MOV_MEMTOEAX(&DSP->SHIFTED);
-				AND_EAX(0x0FFF);
-				MOV_EAXTOMEM(&DSP->FRC_REG);
+				emit_mov_rr(R10, R8);
+				emit_shift(SH_SAR, R10, 8);
 			}
 			else
-			{
-				//FRC_REG=(SHIFTED>>11)&0x1FFF;
-				MOV_MEMTOEAX(&DSP->SHIFTED);
-				SHR_EAX(11);
-				AND_EAX(0x1FFF);
-				MOV_EAXTOMEM(&DSP->FRC_REG);
-			}
+				emit_pack();
+			emit_rm(OP_16, 0x89, R10, RDI, 0, RAX, 1);		// mov [rdi+rax*2],r10w
 		}
 
-		//MEM
-		if(ThisInst.MRD || ThisInst.MWT)
-		//if(0)
+		if (i.MRD)
 		{
-			MOV_0TOEAX();
-			MOV_MEMTOAX(&DSP->MADRS[ThisInst.MASA]);
-			//ADDR=DSP->MADRS[MASA];
-			if(!ThisInst.TABLE)
-			{
-				//ADDR+=DSP->DEC;
-				//ADD_MEMTOEAX(&DSP->DEC);
-				MOV_MEMTOEBX(&DSP->DEC);
-				ADD_EBXTOEAX();
-			}
-			if(ThisInst.ADREB)
-			{
-				MOV_MEMTOEBX(&(DSP->ADRS_REG));
-				AND_EBX(0x0FFF);
-				ADD_EBXTOEAX();
-				//ADDR+=ADRS_REG&0x0FFF;
-			}
-			if(ThisInst.NXADR)
+			if (i.NOFL)
 			{
-				//ADDR++;
-				INC_EAX();
-			}
-			if(!ThisInst.TABLE)
-			{
-				MOV_MEMTOEBX(&(DSP->RBL));
-				DEC_EBX();
-				//ADDR&=DSP->RBL-1;
-				AND_EAX_EBX();
-
-				//AND_EAX((DSP->RBL-1));
+				emit_rm(0, 0x0FB7, R12, RDI, 0, RAX, 1);	// movzx r12d,word [rdi+rax*2]
+				emit_shift(SH_SHL, R12, 8);
 			}
 			else
-			{
-				//ADDR&=0xFFFF;
-				AND_EAX(0xFFFF);
-			}
+				emit_unpack();
+		}
+	}
 
-			//ADDR+=DSP->RBP<<12;
-			MOV_MEMTOEBX(&(DSP->RBP));
-			SHL_EBX(12);
-			ADD_EBXTOEAX();
+	if (i.ADRL)
+	{
+		if (i.SHIFT == 3)
+		{
+			emit_mov_rr(R15, R8);
+			emit_shift(SH_SAR, R15, 12);
+			emit_alu_imm(ALU_AND, R15, 0x0FFF);
+		}
+		else
+		{
+			emit_mov_rr(R15, R9);
+			emit_shift(SH_SAR, R15, 16);
+		}
+	}
 
-			assert(!(ThisInst.MRD && ThisInst.MWT));	//this shouldn't happen, read & write in the same cycle
+	if (i.EWT)
+	{
+		emit_mov_rr(RCX, R8);
+		emit_shift(SH_SAR, RCX, 8);
+		emit_rm(OP_16, 0x01, RCX, RBX, DSP_OFS(EFREG) + i.EWA * 2);	// add [rbx+EFREG],cx
+	}
+}
 
-			if(ThisInst.MWT && (step&1))
-			{
-				if(ThisInst.NOFL)
-				{
-					SHL_EAX(1);
-					ADD_IMMTOEAX(DSP->SCSPRAM);
-					MOV_EAXTOEBX();
-					MOV_MEMTOEAX(&DSP->SHIFTED);
-					SHR_EAX(8);
-					MOV_AXTOMEMEBX();
-					//DSP->SCSPRAM[ADDR]=SHIFTED>>8;
-				}
-				else
-				{
-#ifdef USEFLOATPACK
-					SHL_EAX(1);
-					ADD_IMMTOEAX(DSP->SCSPRAM);
-					EMIT8(0x8B); EMIT8(0xF0);	//mov esi,eax
-					MOV_MEMTOEAX(&DSP->SHIFTED);
-					SHR_EAX(8);
-					memcpy(PtrInsts,PackFunc,sizeof(PackFunc));
-					PtrInsts+=sizeof(PackFunc);
-#else
-					SHL_EAX(1);
-					ADD_IMMTOEAX(DSP->SCSPRAM);
-					MOV_EAXTOEBX();
-					MOV_MEMTOEAX(&DSP->SHIFTED);
-					SHR_EAX(8);
-					MOV_AXTOMEMEBX();
+static const int SavedRegs[] =
+{
+	RBX, RBP, R12, R13, R14, R15,
+#ifdef _WIN32
+	RSI, RDI,
 #endif
-					//DSP->SCSPRAM[ADDR]=PACK(SHIFTED);
-				}
-			}
+};
 
-			if(ThisInst.MRD && (step&1))	//memory only allowed on odd? DoA inserts NOPs on even
-			{
-				if(ThisInst.NOFL)
-				{
-					//MEMVAL=DSP->SCSPRAM[ADDR]<<8;
-					SHL_EAX(1);
-					ADD_IMMTOEAX(DSP->SCSPRAM);
-					MOV_MEMEAXTOAX();
-					SHL_EAX(8);
-					//MOV_EAXTOMEM(&DSP->MEMVAL);
-				}
-				else
-				{
-					//MEMVAL=UNPACK(DSP->SCSPRAM[ADDR]);
-					SHL_EAX(1);
-					ADD_IMMTOEAX(DSP->SCSPRAM);
-					MOV_MEMEAXTOAX();
-#ifdef USEFLOATPACK
-					memcpy(PtrInsts,UnpackFunc,sizeof(UnpackFunc));
-					PtrInsts+=sizeof(UnpackFunc);
+static const int NumSavedRegs = sizeof(SavedRegs) / sizeof(SavedRegs[0]);
+
+// Compiles MPRO[0..LastStep-1]. Returns false if there is no executable memory.
+static bool SCSPDSP_Recompile(_SCSPDSP *DSP)
+{
+	static bool unavailable = false;
+
+	if (DSP->Code == NULL)
+	{
+		if (unavailable)
+			return false;
+#ifdef _WIN32
+		DSP->Code = (UINT8 *) VirtualAlloc(NULL, DYNBUF, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
 #else
-					SHL_EAX(16);
-					SAR_EAX(8);
+		DSP->Code = (UINT8 *) mmap(NULL, DYNBUF, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (DSP->Code == MAP_FAILED)
+			DSP->Code = NULL;
 #endif
-					MOV_EAXTOMEM(&DSP->MEMVAL);
-				}
-			}
-			
-			
-			
-		}
-
-		if(ThisInst.ADRL)
+		if (DSP->Code == NULL)
 		{
-			if(ThisInst.SHIFT==3)
-			{
-				MOV_MEMTOEAX(&DSP->SHIFTED);
-				SAR_EAX(12);
-				AND_EAX(0xFFF);
-				MOV_EAXTOMEM(&DSP->ADRS_REG);
-				//ADRS_REG=(SHIFTED>>12)&0xFFF;
-			}
-			else
-			{
-				MOV_MEMTOEAX(&DSP->INPUTS);
-				SAR_EAX(16);
-				MOV_EAXTOMEM(&DSP->ADRS_REG);
-				//ADRS_REG=(INPUTS>>16);
-			}
+			unavailable = true;
+			ErrorLog("Unable to allocate executable memory for SCSP DSP recompiler. Using interpreter instead.");
+			return false;
 		}
+	}
+
+	DSP->CodeSteps = 0;	// invalid until finished
+	PtrInsts = DSP->Code;
+
+	for (int n = 0; n < NumSavedRegs; n++)
+		emit_push(SavedRegs[n]);
+#ifdef _WIN32
+	emit_rr(OP_W, 0x89, RCX, RBX);							// mov rbx,rcx
+#else
+	emit_rr(OP_W, 0x89, RDI, RBX);							// mov rbx,rdi
+#endif
+	emit_rm(0, 0x8B, RSI, RBX, DSP_OFS(DEC));
+	emit_rm(OP_W, 0x8B, RDI, RBX, DSP_OFS(SCSPRAM));
+	emit_rr(0, 0x31, RBP, RBP);								// ACC=0
+	emit_rr(0, 0x31, R12, R12);								// MEMVAL=0
+	emit_rr(0, 0x31, R13, R13);								// FRC_REG=0
+	emit_rr(0, 0x31, R14, R14);								// Y_REG=0
+	emit_rr(0, 0x31, R15, R15);								// ADRS_REG=0
+
+	for (int step = 0; step < DSP->LastStep; ++step)
+	{
+		if (PtrInsts + DYNBUF_MAX_STEP > DSP->Code + DYNBUF)
+			return false;
+		_INST i;
+		DecodeInst(&DSP->MPRO[step * 4], &i);
+		EmitStep(i, step);
+	}
+
+	for (int n = NumSavedRegs - 1; n >= 0; n--)
+		emit_pop(SavedRegs[n]);
+	emit8(0xC3);	// ret
+
+	memcpy(DSP->CodeMPRO, DSP->MPRO, sizeof(DSP->CodeMPRO));
+	DSP->CodeSteps = DSP->LastStep;
+	return true;
+}
+
+static void SCSPDSP_FreeCode(_SCSPDSP *DSP)
+{
+	if (DSP->Code == NULL)
+		return;
+#ifdef _WIN32
+	VirtualFree(DSP->Code, 0, MEM_RELEASE);
+#else
+	munmap(DSP->Code, DYNBUF);
+#endif
+	DSP->Code = NULL;
+}
+
+void SCSPDSP_Step(_SCSPDSP *DSP)
+{
+	if(DSP->Stopped)
+		return;
 
-		if(ThisInst.EWT)
+	// Recompile whenever the program has been changed
+	if(DSP->CodeSteps!=DSP->LastStep || DSP->Code==NULL || memcmp(DSP->CodeMPRO,DSP->MPRO,DSP->LastStep*4*sizeof(UINT16)))
+	{
+		if(!SCSPDSP_Recompile(DSP))
 		{
-			MOV_MEMTOEAX(&DSP->SHIFTED);
-			SAR_EAX(8);
-			ADD_AXTOMEM(&DSP->EFREG[ThisInst.EWA]);
-			//DSP->EFREG[EWA]+=SHIFTED>>8;
+			SCSPDSP_StepInterpreted(DSP);
+			return;
 		}
-//		EMIT8(0x90);
-//		EMIT8(0xCC);
-		
 	}
 
-	POPA();
+	memset(DSP->EFREG,0,2*16);
+	((void (*)(_SCSPDSP *)) DSP->Code)(DSP);
+	--DSP->DEC;
+	memset(DSP->MIXS,0,4*16);
+}
 
-	RET();
+#else	// !x86-64
 
-	FILE *f=fopen("dsp.rec","wb");
-	fwrite(DSP->DoSteps,1,PtrInsts-(unsigned char *)DSP->DoSteps,f);
-	fclose(f);
+static void SCSPDSP_FreeCode(_SCSPDSP *DSP)
+{
+}
+
+void SCSPDSP_Step(_SCSPDSP *DSP)
+{
+	SCSPDSP_StepInterpreted(DSP);
+}
+
+#endif	// x86-64
+
+void SCSPDSP_Deinit(_SCSPDSP *DSP)
+{
+	SCSPDSP_FreeCode(DSP);
 }
 
-#endif
 void SCSPDSP_SetSample(_SCSPDSP *DSP,signed int sample,int SEL,int MXL)
 {
 //	if(MXL!=6)
@@ -1129,7 +1088,4 @@ void SCSPDSP_Start(_SCSPDSP *DSP)
 			int a=1;
 	}
 
-#ifdef DYNDSP
-	SCSPDSP_Recompile(DSP);
-#endif
 }
\ No newline at end of file
@@ -29,10 +29,6 @@
 #ifndef INCLUDED_SCSPDSP_H
 #define INCLUDED_SCSPDSP_H
 
-//#define DYNDSP
-#define DYNOPT	1		//set to 1 to enable optimization of recompiler
-
-
 //the DSP Context
 struct _SCSPDSP
 {
@@ -59,26 +55,18 @@ struct _SCSPDSP
 	
 	bool Stopped;
 	int LastStep;
-#ifdef DYNDSP
-	INT32 ACC;	//26 bit
-	INT32 SHIFTED;	//24 bit
-	INT32 X;	//24 bit
-	INT32 Y;	//13 bit
-	INT32 B;	//26 bit
-	INT32 INPUTS;	//24 bit
-	INT32 MEMVAL;
-	INT32 FRC_REG;	//13 bit
-	INT32 Y_REG;		//24 bit
-	UINT32 ADDR;
-	UINT32 ADRS_REG;	//13 bit
 
-	void (*DoSteps)();
-#endif
+//recompiled program (x86-64 only, not saved)
+	UINT8 *Code;
+	UINT16 CodeMPRO[128*4];	//MPRO it was compiled from
+	int CodeSteps;		//LastStep it was compiled for
 };
 
 void SCSPDSP_Init(_SCSPDSP *DSP);
+void SCSPDSP_Deinit(_SCSPDSP *DSP);
 void SCSPDSP_SetSample(_SCSPDSP *DSP,INT32 sample,int SEL,int MXL);
-void SCSPDSP_Step(_SCSPDSP *DSP);
+void SCSPDSP_Step(_SCSPDSP *DSP);	//recompiles the program first if MPRO has changed
+void SCSPDSP_StepInterpreted(_SCSPDSP *DSP);
 void SCSPDSP_Start(_SCSPDSP *DSP);
 
 
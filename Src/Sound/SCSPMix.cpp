@@ -0,0 +1,129 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * SCSPMix.cpp
+ *
+ * Mixing of SCSP slot outputs.
+ *
+ * Slots have to be stepped one at a time and one sample at a time (the 68K
+ * runs between samples, and slots modulate each other through the ring
+ * buffer), but once a sample has been generated for every slot, scaling and
+ * panning them is independent per slot. This is done several slots at a time
+ * with the same operations as the scalar code: float multiply and truncation
+ * for the balance, 32-bit multiplies and arithmetic shifts for the pan, so the
+ * output is bit-exact. Pan table entries are at most 4.0 in 4.12 fixed point
+ * and samples at most 17 bits, so no product overflows.
+ */
+
+#include "SCSPMix.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCSPMIX_USE_SSE2
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCSPMIX_USE_AVX2
+#endif
+#endif
+
+
+#ifdef SCSPMIX_USE_SSE2
+// Low 32 bits of a 32x32-bit multiply in each lane
+static inline __m128i MulLo32(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+	return _mm_mullo_epi32(a, b);
+#else
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+#endif
+}
+
+static inline INT32 HorizontalSum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtsi128_si32(v);
+}
+#endif
+
+void SCSP_MixSlots(SCSPMixSlots *slots, float balance, INT32 *left, INT32 *right)
+{
+	int		i = 0;
+	int		n = slots->count;
+	INT32	l = 0, r = 0;
+
+#if defined(SCSPMIX_USE_AVX2)
+	{
+		const __m256 scale = _mm256_set1_ps(balance);
+		__m256i suml = _mm256_setzero_si256();
+		__m256i sumr = _mm256_setzero_si256();
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i s = _mm256_cvttps_epi32(_mm256_mul_ps(scale, _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *) &slots->sample[i]))));
+			__m256i d = _mm256_srai_epi32(_mm256_mullo_epi32(s, _mm256_loadu_si256((const __m256i *) &slots->dpan[i])), 15);
+			_mm256_storeu_si256((__m256i *) &slots->dsp[i], d);
+			suml = _mm256_add_epi32(suml, _mm256_srai_epi32(_mm256_mullo_epi32(s, _mm256_loadu_si256((const __m256i *) &slots->lpan[i])), 12));
+			sumr = _mm256_add_epi32(sumr, _mm256_srai_epi32(_mm256_mullo_epi32(s, _mm256_loadu_si256((const __m256i *) &slots->rpan[i])), 12));
+		}
+
+		l += HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(suml), _mm256_extracti128_si256(suml, 1)));
+		r += HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(sumr), _mm256_extracti128_si256(sumr, 1)));
+	}
+#endif
+
+#if defined(SCSPMIX_USE_SSE2)
+	{
+		const __m128 scale = _mm_set1_ps(balance);
+		__m128i suml = _mm_setzero_si128();
+		__m128i sumr = _mm_setzero_si128();
+
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i s = _mm_cvttps_epi32(_mm_mul_ps(scale, _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &slots->sample[i]))));
+			__m128i d = _mm_srai_epi32(MulLo32(s, _mm_loadu_si128((const __m128i *) &slots->dpan[i])), 15);
+			_mm_storeu_si128((__m128i *) &slots->dsp[i], d);
+			suml = _mm_add_epi32(suml, _mm_srai_epi32(MulLo32(s, _mm_loadu_si128((const __m128i *) &slots->lpan[i])), 12));
+			sumr = _mm_add_epi32(sumr, _mm_srai_epi32(MulLo32(s, _mm_loadu_si128((const __m128i *) &slots->rpan[i])), 12));
+		}
+
+		l += HorizontalSum(suml);
+		r += HorizontalSum(sumr);
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		INT32 s = (INT32) (balance * (float) slots->sample[i]);
+		slots->dsp[i] = (s * slots->dpan[i]) >> 15;
+		l += (s * slots->lpan[i]) >> 12;
+		r += (s * slots->rpan[i]) >> 12;
+	}
+
+	*left += l;
+	*right += r;
+}
@@ -0,0 +1,72 @@
+/**
+ ** Supermodel
+ ** A Sega Model 3 Arcade Emulator.
+ ** Copyright 2011 Bart Trzynadlowski, Nik Henson
+ **
+ ** This file is part of Supermodel.
+ **
+ ** Supermodel is free software: you can redistribute it and/or modify it under
+ ** the terms of the GNU General Public License as published by the Free
+ ** Software Foundation, either version 3 of the License, or (at your option)
+ ** any later version.
+ **
+ ** Supermodel is distributed in the hope that it will be useful, but WITHOUT
+ ** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ ** FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ ** more details.
+ **
+ ** You should have received a copy of the GNU General Public License along
+ ** with Supermodel.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/*
+ * SCSPMix.h
+ *
+ * Mixing of SCSP slot outputs into the direct (stereo) and DSP sends.
+ */
+
+#ifndef INCLUDED_SCSPMIX_H
+#define INCLUDED_SCSPMIX_H
+
+#include "Types.h"
+
+/*
+ * SCSPMixSlots:
+ *
+ * Outputs of the active slots of one SCSP for one sample, filled in slot
+ * order by the SCSP and then mixed all at once by SCSP_MixSlots().
+ */
+struct SCSPMixSlots
+{
+	INT32	sample[32];	// slot output, after envelope
+	INT32	lpan[32];	// LPANTABLE entry for direct send (TL, DIPAN, DISDL)
+	INT32	rpan[32];	// RPANTABLE entry for direct send
+	INT32	dpan[32];	// LPANTABLE entry for DSP send
+	INT32	dsp[32];	// output: sample to pass to the DSP
+	int		count;		// number of slots filled in
+};
+
+/*
+ * SCSP_MixSlots(slots, balance, left, right):
+ *
+ * Scales each slot sample by the SCSP's balance and pans it into the left and
+ * right accumulators and into slots->dsp. The result is identical to doing
+ * this one slot at a time:
+ *
+ *		sample = (int) (balance * (float) slots->sample[i]);
+ *		slots->dsp[i] = (sample * slots->dpan[i]) >> 15;
+ *		*left += (sample * slots->lpan[i]) >> 12;
+ *		*right += (sample * slots->rpan[i]) >> 12;
+ *
+ * Uses SSE2 (or AVX2, if enabled at compile time) where available.
+ *
+ * Parameters:
+ *		slots	Slot outputs. dsp[] is written.
+ *		balance	Master/slave balance scale factor (0.0 to 2.0).
+ *		left	Left accumulator, added to.
+ *		right	Right accumulator, added to.
+ */
+extern void SCSP_MixSlots(SCSPMixSlots *slots, float balance, INT32 *left, INT32 *right);
+
+
+#endif	// INCLUDED_SCSPMIX_H
@@ -0,0 +1,110 @@
+#include "Supermodel.h"
+#include "Sound/SCSPDSP.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static const size_t RAM_WORDS = 0x90000;  // enough for any RBP and address
+
+static UINT32 Random32()
+{
+  return (UINT32) rand() ^ ((UINT32) rand() << 15) ^ ((UINT32) rand() << 30);
+}
+
+static void RandomDSP(_SCSPDSP *dsp, UINT16 *ram, int steps)
+{
+  SCSPDSP_Init(dsp);
+  dsp->SCSPRAM = ram;
+  dsp->RBP = rand() & 0x7F;
+  dsp->RBL = (8 * 1024) << (rand() & 3);
+  dsp->DEC = Random32();
+  for (auto &v: dsp->COEF) v = (INT16) Random32();
+  for (auto &v: dsp->MADRS) v = (UINT16) Random32();
+  for (auto &v: dsp->MPRO) v = (UINT16) Random32();
+  for (auto &v: dsp->TEMP) v = (INT32) Random32();
+  for (auto &v: dsp->MEMS) v = (INT32) Random32();
+  for (auto &v: dsp->EXTS) v = (INT16) Random32();
+  dsp->Stopped = false;
+  dsp->LastStep = steps;
+}
+
+static void RandomInputs(_SCSPDSP *dsp)
+{
+  for (auto &v: dsp->MIXS) v = (INT32) Random32() >> (rand() & 15);
+}
+
+static bool Same(const _SCSPDSP &a, const _SCSPDSP &b, const std::vector<UINT16> &ramA, const std::vector<UINT16> &ramB)
+{
+  return !memcmp(a.EFREG, b.EFREG, sizeof(a.EFREG))
+    && !memcmp(a.TEMP, b.TEMP, sizeof(a.TEMP))
+    && !memcmp(a.MEMS, b.MEMS, sizeof(a.MEMS))
+    && a.DEC == b.DEC
+    && ramA == ramB;
+}
+
+static double Microseconds(void (*step)(_SCSPDSP *), _SCSPDSP *dsp)
+{
+  const int passes = 44100;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < passes; i++)
+    step(dsp);
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / passes;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<UINT16> ramA(RAM_WORDS), ramB(RAM_WORDS);
+  static _SCSPDSP a, b;
+  int failures = 0;
+  srand(1);
+
+  // Test: random programs of every length, including one rewritten while running
+  for (int program = 0; program < 2000 && failures < 10; program++)
+  {
+    for (auto &v: ramA) v = (UINT16) rand();
+    ramB = ramA;
+    RandomDSP(&a, ramA.data(), 1 + program % 128);
+    b = a;
+    b.SCSPRAM = ramB.data();
+
+    for (int sample = 0; sample < 64; sample++)
+    {
+      if (sample == 32)
+      {
+        int word = rand() % (a.LastStep * 4);
+        a.MPRO[word] = b.MPRO[word] = (UINT16) rand();
+      }
+      RandomInputs(&a);
+      memcpy(b.MIXS, a.MIXS, sizeof(a.MIXS));
+      SCSPDSP_StepInterpreted(&a);
+      SCSPDSP_Step(&b);
+      if (!Same(a, b, ramA, ramB))
+      {
+        std::cout << "Program " << program << " (" << a.LastStep << " steps), sample " << sample << ": FAILED" << std::endl;
+        failures++;
+        break;
+      }
+    }
+    SCSPDSP_Deinit(&b);
+  }
+
+  // Benchmark: a full 128-step program
+  RandomDSP(&a, ramA.data(), 128);
+  b = a;
+  b.SCSPRAM = ramB.data();
+  double reference = Microseconds(SCSPDSP_StepInterpreted, &a);
+  double optimized = Microseconds(SCSPDSP_Step, &b);
+  std::cout << "128 steps: interpreter " << reference << " us, recompiler " << optimized << " us (" << reference / optimized << "x)" << std::endl;
+  SCSPDSP_Deinit(&b);
+
+  if (failures)
+  {
+    std::cout << failures << " tests failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include "Sound/SCSPMix.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// The slot mix as SCSP_DoMasterSamples() used to do it, one slot at a time
+static void ReferenceMix(SCSPMixSlots *slots, float balance, INT32 *left, INT32 *right)
+{
+  for (int i = 0; i < slots->count; i++)
+  {
+    signed int sample = (int) (balance * (float) slots->sample[i]);
+    slots->dsp[i] = (sample * slots->dpan[i]) >> (12 + 3);
+    *left += (sample * slots->lpan[i]) >> 12;
+    *right += (sample * slots->rpan[i]) >> 12;
+  }
+}
+
+static void RandomSlots(SCSPMixSlots *slots, int count)
+{
+  slots->count = count;
+  for (int i = 0; i < 32; i++)
+  {
+    slots->sample[i] = (rand() & 0xFFFF) - 0x8000;
+    slots->lpan[i] = rand() % 16385;
+    slots->rpan[i] = rand() % 16385;
+    slots->dpan[i] = rand() % 16385;
+    slots->dsp[i] = 0x12345678;
+  }
+  // Extremes
+  if (count > 0 && (rand() & 3) == 0)
+  {
+    slots->sample[0] = -32768;
+    slots->lpan[0] = slots->rpan[0] = slots->dpan[0] = 16384;
+  }
+}
+
+static double Microseconds(void (*mix)(SCSPMixSlots *, float, INT32 *, INT32 *), SCSPMixSlots *slots, float balance, INT32 *sum)
+{
+  const int passes = 1000000;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < passes; i++)
+  {
+    INT32 l = 0, r = 0;
+    mix(slots, balance, &l, &r);
+    *sum += l ^ r;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / passes;
+}
+
+int main(int argc, char **argv)
+{
+  const float balances[] = { 0.0f, 0.25f, 0.37f, 1.0f, 1.37f, 1.5f, 2.0f };
+  int failures = 0;
+  srand(1);
+
+  // Test: every slot count, several balances, many random inputs
+  for (int count = 0; count <= 32; count++)
+  {
+    for (float balance: balances)
+    {
+      for (int pass = 0; pass < 2000; pass++)
+      {
+        SCSPMixSlots expected, result;
+        RandomSlots(&expected, count);
+        memcpy(&result, &expected, sizeof(result));
+        INT32 l0 = rand() - RAND_MAX / 2, r0 = rand() - RAND_MAX / 2;
+        INT32 l1 = l0, r1 = r0;
+        ReferenceMix(&expected, balance, &l0, &r0);
+        SCSP_MixSlots(&result, balance, &l1, &r1);
+        if (l0 != l1 || r0 != r1 || memcmp(expected.dsp, result.dsp, sizeof(expected.dsp)) != 0)
+        {
+          std::cout << count << " slots, balance " << balance << ": FAILED" << std::endl;
+          failures++;
+          break;
+        }
+      }
+    }
+  }
+
+  // Benchmark: all 32 slots of an SCSP active
+  SCSPMixSlots slots;
+  RandomSlots(&slots, 32);
+  INT32 sum = 0;
+  double reference = Microseconds(ReferenceMix, &slots, 1.0f, &sum);
+  double optimized = Microseconds(SCSP_MixSlots, &slots, 1.0f, &sum);
+  std::cout << "32 slots: reference " << reference * 1000.0 << " ns, mixer " << optimized * 1000.0 << " ns (" << reference / optimized << "x) [" << sum << "]" << std::endl;
+
+  if (failures)
+  {
+    std::cout << failures << " tests failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All tests passed." << std::endl;
+  return 0;
+}